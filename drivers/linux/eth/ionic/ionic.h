@@ -29,6 +29,13 @@ struct ionic_lif;
 #define SHORT_TIMEOUT   1
 #define IONIC_ADMINQ_TIME_SLICE	msecs_to_jiffies(100)
 
+/* static unless the KUnit tests in ionic_kunit.c need to call it */
+#if IS_ENABLED(CONFIG_IONIC_KUNIT_TEST)
+#define IONIC_KUNIT_STATIC
+#else
+#define IONIC_KUNIT_STATIC	static
+#endif
+
 #define IONIC_PHC_UPDATE_NS	10000000000L	    /* 10s in nanoseconds */
 #define NORMAL_PPB		1000000000	    /* one billion parts per billion */
 #define SCALED_PPM		(1000000ull << 16)  /* 2^16 million parts per 2^16 million */
@@ -300,6 +300,8 @@ void ionic_debugfs_add_qcq(struct ionic_lif *lif, struct ionic_qcq *qcq)
 				   &txqstats[q->index].crc32_csum);
 		debugfs_create_u64("tso", 0400, stats_dentry,
 				   &txqstats[q->index].tso);
+		debugfs_create_u64("tso_encap", 0400, stats_dentry,
+				   &txqstats[q->index].tso_encap);
 		debugfs_create_u64("frags", 0400, stats_dentry,
 				   &txqstats[q->index].frags);
 	}
@@ -322,6 +324,14 @@ void ionic_debugfs_add_qcq(struct ionic_lif *lif, struct ionic_qcq *qcq)
 				   &rxqstats[q->index].csum_none);
 		debugfs_create_u64("csum_complete", 0400, stats_dentry,
 				   &rxqstats[q->index].csum_complete);
+		debugfs_create_u64("csum_unnecessary", 0400, stats_dentry,
+				   &rxqstats[q->index].csum_unnecessary);
+		debugfs_create_u64("csum_unnecessary_inner", 0400, stats_dentry,
+				   &rxqstats[q->index].csum_unnecessary_inner);
+		debugfs_create_u64("unwanted_ucast", 0400, stats_dentry,
+				   &rxqstats[q->index].unwanted_ucast);
+		debugfs_create_u64("unwanted_mcast", 0400, stats_dentry,
+				   &rxqstats[q->index].unwanted_mcast);
 		debugfs_create_u64("csum_error", 0400, stats_dentry,
 				   &rxqstats[q->index].csum_error);
 	}
@@ -475,7 +485,7 @@ static int lif_filters_show(struct seq_file *seq, void *v)
 
 	seq_puts(seq, "id      flow        state type  filter\n");
 	spin_lock_bh(&lif->rx_filters.lock);
-	for (i = 0; i < IONIC_RX_FILTER_HLISTS; i++) {
+	for (i = 0; i < IONIC_RX_FILTER_HLISTS(&lif->rx_filters); i++) {
 		head = &lif->rx_filters.by_id[i];
 		hlist_for_each_entry_safe(f, tmp, head, by_id) {
 			switch (le16_to_cpu(f->cmd.match)) {
@@ -509,6 +519,25 @@ static int lif_filters_show(struct seq_file *seq, void *v)
 }
 DEFINE_SHOW_ATTRIBUTE(lif_filters);
 
+static int lif_filter_overflow_show(struct seq_file *seq, void *v)
+{
+	struct ionic_lif *lif = seq->private;
+
+	seq_printf(seq, "nucast:     %u\n", lif->nucast);
+	seq_printf(seq, "nmcast:     %u\n", lif->nmcast);
+	seq_printf(seq, "nvlans:     %u\n", lif->nvlans);
+	seq_printf(seq, "max_vlans:  %u\n", lif->max_vlans);
+	seq_printf(seq, "ucast_ovfl: %d\n",
+		   test_bit(IONIC_LIF_F_UCAST_OVERFLOW, lif->state));
+	seq_printf(seq, "mcast_ovfl: %d\n",
+		   test_bit(IONIC_LIF_F_MCAST_OVERFLOW, lif->state));
+	seq_printf(seq, "vlan_ovfl:  %d\n",
+		   test_bit(IONIC_LIF_F_VLAN_OVERFLOW, lif->state));
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lif_filter_overflow);
+
 static int lif_n_txrx_alloc_show(struct seq_file *seq, void *v)
 {
 	struct ionic_lif *lif = seq->private;
@@ -536,6 +565,8 @@ void ionic_debugfs_add_lif(struct ionic_lif *lif)
 			    lif, &lif_state_fops);
 	debugfs_create_file("filters", 0400, lif->dentry,
 			    lif, &lif_filters_fops);
+	debugfs_create_file("filter_overflow", 0400, lif->dentry,
+			    lif, &lif_filter_overflow_fops);
 	debugfs_create_file("txrx_alloc", 0400, lif->dentry,
 			    lif, &lif_n_txrx_alloc_fops);
 }
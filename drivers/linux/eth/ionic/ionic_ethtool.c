@@ -31,8 +31,10 @@ static const char ionic_priv_flags_strings[][ETH_GSTRING_LEN] = {
 	"device-reset",
 #define IONIC_PRIV_F_CMB_RINGS		BIT(2)
 	"cmb-rings",
+#define IONIC_PRIV_F_RX_CSUM_UNNECESSARY	BIT(3)
+	"rx-csum-unnecessary",
 
-#define IONIC_PRIV_F_SW_DBG_STATS	BIT(3)
+#define IONIC_PRIV_F_SW_DBG_STATS	BIT(4)
 #ifdef IONIC_DEBUG_STATS
 	"sw-dbg-stats",
 #endif
@@ -1030,6 +1032,9 @@ static u32 ionic_get_priv_flags(struct net_device *netdev)
 	    test_bit(IONIC_LIF_F_CMB_RX_RINGS, lif->state))
 		priv_flags |= IONIC_PRIV_F_CMB_RINGS;
 
+	if (test_bit(IONIC_LIF_F_RX_CSUM_UNNECESSARY, lif->state))
+		priv_flags |= IONIC_PRIV_F_RX_CSUM_UNNECESSARY;
+
 	return priv_flags;
 }
 
@@ -1067,6 +1072,14 @@ static int ionic_set_priv_flags(struct net_device *netdev, u32 priv_flags)
 			return ret;
 	}
 
+	if (!!(priv_flags & IONIC_PRIV_F_RX_CSUM_UNNECESSARY) !=
+	    test_bit(IONIC_LIF_F_RX_CSUM_UNNECESSARY, lif->state)) {
+		ret = ionic_lif_set_rx_csum_unnecessary(lif,
+				!!(priv_flags & IONIC_PRIV_F_RX_CSUM_UNNECESSARY));
+		if (ret < 0)
+			return ret;
+	}
+
 	return 0;
 }
 
@@ -0,0 +1,471 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright(c) 2017 - 2022 Pensando Systems, Inc */
+
+/* KUnit tests for the parts of the driver that don't need a device.
+ * Built only with CONFIG_IONIC_KUNIT_TEST.
+ */
+
+#include <kunit/test.h>
+#include <linux/netdevice.h>
+#include <linux/etherdevice.h>
+#include <linux/rculist.h>
+#include <linux/kthread.h>
+
+#include "ionic.h"
+#include "ionic_lif.h"
+#include "ionic_rx_filter.h"
+#include "ionic_txrx.h"
+
+/* Simulated completions through ionic_rx_csum_type() */
+static void ionic_rx_csum_type_test(struct kunit *test)
+{
+	static const struct {
+		u8 csum_flags;
+		u8 pkt_type;
+		bool unnecessary;
+		bool encap_ok;
+		enum ionic_rx_csum want;
+	} t[] = {
+#define C(f)	IONIC_RXQ_COMP_CSUM_F_##f
+#define P(t)	IONIC_PKT_TYPE_##t
+		/* COMPLETE mode ignores the per-layer bits */
+		{ C(CALC) | C(TCP_OK) | C(IP_OK), P(IPV4_TCP), false, true, IONIC_RX_CSUM_COMPLETE },
+		{ C(TCP_OK) | C(IP_OK), P(IPV4_TCP), false, true, IONIC_RX_CSUM_NONE },
+		/* plain L4 */
+		{ C(CALC) | C(TCP_OK) | C(IP_OK), P(IPV4_TCP), true, false, IONIC_RX_CSUM_UNNECESSARY },
+		{ C(CALC) | C(TCP_OK), P(IPV6_TCP), true, false, IONIC_RX_CSUM_UNNECESSARY },
+		{ C(CALC) | C(UDP_OK) | C(IP_OK), P(IPV4_UDP), true, false, IONIC_RX_CSUM_UNNECESSARY },
+		{ C(UDP_OK), P(IPV6_UDP), true, false, IONIC_RX_CSUM_UNNECESSARY },
+		/* OK bit must match the packet's L4 */
+		{ C(CALC) | C(UDP_OK), P(IPV4_TCP), true, false, IONIC_RX_CSUM_COMPLETE },
+		{ C(CALC) | C(TCP_OK), P(IPV6_UDP), true, false, IONIC_RX_CSUM_COMPLETE },
+		/* no L4 to validate */
+		{ C(CALC) | C(IP_OK), P(IPV4), true, false, IONIC_RX_CSUM_COMPLETE },
+		{ C(CALC), P(NON_IP), true, false, IONIC_RX_CSUM_COMPLETE },
+		{ 0, P(IPV6), true, false, IONIC_RX_CSUM_NONE },
+		/* any BAD bit defers to the stack */
+		{ C(CALC) | C(TCP_OK) | C(IP_BAD), P(IPV4_TCP), true, false, IONIC_RX_CSUM_COMPLETE },
+		{ C(TCP_BAD), P(IPV4_TCP), true, false, IONIC_RX_CSUM_NONE },
+		{ C(CALC) | C(TCP_OK) | C(UDP_BAD), P(ENCAP_IPV4_TCP), true, true, IONIC_RX_CSUM_COMPLETE },
+		/* encapsulated, with and without tunnel-aware csum */
+		{ C(CALC) | C(TCP_OK) | C(IP_OK), P(ENCAP_IPV4_TCP), true, true, IONIC_RX_CSUM_UNNECESSARY_INNER },
+		{ C(CALC) | C(TCP_OK), P(ENCAP_IPV6_TCP), true, true, IONIC_RX_CSUM_UNNECESSARY_INNER },
+		{ C(CALC) | C(UDP_OK), P(ENCAP_IPV4_UDP), true, true, IONIC_RX_CSUM_UNNECESSARY_INNER },
+		{ C(UDP_OK), P(ENCAP_IPV6_UDP), true, true, IONIC_RX_CSUM_UNNECESSARY_INNER },
+		{ C(CALC) | C(TCP_OK), P(ENCAP_IPV4_TCP), true, false, IONIC_RX_CSUM_COMPLETE },
+		{ C(UDP_OK), P(ENCAP_IPV6_UDP), true, false, IONIC_RX_CSUM_NONE },
+		{ C(CALC) | C(IP_OK), P(ENCAP_IPV4), true, true, IONIC_RX_CSUM_COMPLETE },
+		{ C(CALC), P(ENCAP_NON_IP), true, true, IONIC_RX_CSUM_COMPLETE },
+#undef P
+#undef C
+	};
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(t); i++)
+		KUNIT_EXPECT_EQ_MSG(test, t[i].want,
+				    ionic_rx_csum_type(t[i].csum_flags,
+						       t[i].pkt_type,
+						       t[i].unnecessary,
+						       t[i].encap_ok),
+				    "case %d: flags 0x%02x type 0x%02x mode %d/%d",
+				    i, t[i].csum_flags, t[i].pkt_type,
+				    t[i].unnecessary, t[i].encap_ok);
+}
+
+/* 802.1Q/802.1ad offload choices through ionic_vlan_fix_features(),
+ * including the Q-in-Q setups where the S-tag offloads are on and the
+ * inner C-tag is left to the stack.
+ */
+static void ionic_vlan_fix_features_test(struct kunit *test)
+{
+	static const struct {
+		netdev_features_t cur;
+		netdev_features_t req;
+		netdev_features_t want;
+	} t[] = {
+#define CT	NETIF_F_HW_VLAN_CTAG_TX
+#define CR	NETIF_F_HW_VLAN_CTAG_RX
+#define CF	NETIF_F_HW_VLAN_CTAG_FILTER
+#define ST	NETIF_F_HW_VLAN_STAG_TX
+#define SR	NETIF_F_HW_VLAN_STAG_RX
+#define SF	NETIF_F_HW_VLAN_STAG_FILTER
+		/* single flavour requests pass through */
+		{ CT | CR | CF, CT | CR | CF, CT | CR | CF },
+		{ CT | CR | CF, ST | SR | SF, ST | SR | SF },
+		{ 0, CR, CR },
+		{ 0, SR, SR },
+		/* Q-in-Q: turning the S-tag offloads on drops the C-tag ones */
+		{ CT | CR | CF, CT | CR | CF | ST | SR | SF, ST | SR | SF },
+		{ CT | CR | CF, CT | CR | CF | SR, CT | SR | CF },
+		{ CT | CR | CF, CT | CR | CF | ST, ST | CR | CF },
+		/* and back to 802.1Q */
+		{ ST | SR | SF, CT | CR | CF | ST | SR | SF, CT | CR | CF },
+		{ ST | SR | CF, ST | SR | CR | CF, ST | CR | CF },
+		/* both asked for at once with neither on keeps 802.1Q */
+		{ 0, CT | CR | CF | ST | SR | SF, CT | CR | CF },
+		{ NETIF_F_SG, NETIF_F_SG | CR | SR, NETIF_F_SG | CR },
+		/* other features are left alone */
+		{ CR, NETIF_F_RXCSUM | CR | SR, NETIF_F_RXCSUM | SR },
+#undef SF
+#undef SR
+#undef ST
+#undef CF
+#undef CR
+#undef CT
+	};
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(t); i++)
+		KUNIT_EXPECT_EQ_MSG(test, (u64)t[i].want,
+				    (u64)ionic_vlan_fix_features(t[i].cur, t[i].req),
+				    "case %d: cur 0x%llx req 0x%llx",
+				    i, (u64)t[i].cur, (u64)t[i].req);
+}
+
+/* TPID reported for a stripped tag */
+static void ionic_rx_vlan_proto_test(struct kunit *test)
+{
+	static const struct {
+		netdev_features_t features;
+		u16 want;
+	} r[] = {
+		{ NETIF_F_HW_VLAN_CTAG_RX, ETH_P_8021Q },
+		{ NETIF_F_HW_VLAN_STAG_RX, ETH_P_8021AD },
+		/* Q-in-Q with S-tag strip: the outer tag is the S-tag */
+		{ NETIF_F_HW_VLAN_STAG_RX | NETIF_F_HW_VLAN_CTAG_TX, ETH_P_8021AD },
+	};
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(r); i++)
+		KUNIT_EXPECT_EQ_MSG(test, r[i].want,
+				    ntohs(ionic_rx_vlan_proto(r[i].features)),
+				    "case %d: features 0x%llx",
+				    i, (u64)r[i].features);
+}
+
+static struct kunit_case ionic_txrx_test_cases[] = {
+	KUNIT_CASE(ionic_rx_csum_type_test),
+	KUNIT_CASE(ionic_vlan_fix_features_test),
+	KUNIT_CASE(ionic_rx_vlan_proto_test),
+	{}
+};
+
+static struct kunit_suite ionic_txrx_test_suite = {
+	.name = "ionic_txrx",
+	.test_cases = ionic_txrx_test_cases,
+};
+
+/* A device-less lif with just enough in it for the filter table code,
+ * allocated the way ionic_lif_alloc() does so lif->netdev is real.
+ */
+static int ionic_rx_filter_test_init(struct kunit *test)
+{
+	union ionic_lif_identity *ident;
+	struct net_device *netdev;
+	struct ionic_lif *lif;
+
+	ident = kunit_kzalloc(test, sizeof(*ident), GFP_KERNEL);
+	if (!ident)
+		return -ENOMEM;
+	ident->eth.max_ucast_filters = cpu_to_le32(32);
+	ident->eth.max_mcast_filters = cpu_to_le32(32);
+
+	netdev = alloc_etherdev(sizeof(*lif));
+	if (!netdev)
+		return -ENOMEM;
+	lif = netdev_priv(netdev);
+	lif->netdev = netdev;
+	lif->identity = ident;
+	if (ionic_rx_filters_init(lif)) {
+		free_netdev(netdev);
+		return -ENOMEM;
+	}
+
+	test->priv = lif;
+
+	return 0;
+}
+
+static void ionic_rx_filter_test_exit(struct kunit *test)
+{
+	struct ionic_lif *lif = test->priv;
+
+	ionic_rx_filters_deinit(lif);
+	free_netdev(lif->netdev);
+}
+
+/* Stand in for the device's answer to an add of @f */
+static void ionic_rx_filter_test_add(struct ionic_lif *lif,
+				     struct ionic_rx_filter *f, int err)
+{
+	struct ionic_admin_ctx ctx = { 0 };
+
+	spin_lock_bh(&lif->rx_filters.lock);
+	if (err) {
+		/* ionic_lif_filter_add() holds it SYNCED while posting */
+		f->state = IONIC_FILTER_STATE_SYNCED;
+		ionic_rx_filter_add_failed(lif, f, err);
+	} else {
+		ctx.cmd.rx_filter_add = f->cmd;
+		ionic_rx_filter_save(lif, 0, IONIC_RXQ_INDEX_ANY, 0, &ctx,
+				     IONIC_FILTER_STATE_SYNCED);
+	}
+	spin_unlock_bh(&lif->rx_filters.lock);
+}
+
+#define IONIC_EXPECT_OVERFLOW(test, lif, ucast_of, mcast_of, vlan_of)	\
+	do {								\
+		unsigned int ucast, mcast, vlan;			\
+									\
+		ionic_rx_filter_count_pending(lif, &ucast, &mcast, &vlan); \
+		ionic_rx_filter_overflow_update(lif, ucast, mcast, vlan); \
+		KUNIT_EXPECT_EQ(test, (bool)(ucast_of),				\
+				(bool)test_bit(IONIC_LIF_F_UCAST_OVERFLOW, (lif)->state)); \
+		KUNIT_EXPECT_EQ(test, (bool)(mcast_of),				\
+				(bool)test_bit(IONIC_LIF_F_MCAST_OVERFLOW, (lif)->state)); \
+		KUNIT_EXPECT_EQ(test, (bool)(vlan_of),				\
+				(bool)test_bit(IONIC_LIF_F_VLAN_OVERFLOW, (lif)->state)); \
+	} while (0)
+
+/* Walk a filter table through add results that should and shouldn't
+ * put it in overflow, and back out again.
+ */
+static void ionic_rx_filter_overflow_test(struct kunit *test)
+{
+	static const u8 uc[][ETH_ALEN] = {
+		{ 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 },
+		{ 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 },
+		{ 0x02, 0x00, 0x00, 0x00, 0x00, 0x03 },
+	};
+	static const u8 mc[ETH_ALEN] = { 0x01, 0x00, 0x5e, 0x00, 0x00, 0x01 };
+	static const int transient[] = { -ETIMEDOUT, -EAGAIN, -EBUSY, -ENXIO };
+	struct ionic_admin_ctx ctx = {
+		.cmd.rx_filter_add = {
+			.match = cpu_to_le16(IONIC_RX_FILTER_MATCH_VLAN),
+			.vlan.vlan = cpu_to_le16(10),
+		},
+	};
+	struct ionic_rx_filter *fu0, *fu1, *fm, *fv;
+	struct ionic_lif *lif = test->priv;
+	int i;
+
+	ionic_lif_list_addr(lif, uc[0], ADD_ADDR);
+	ionic_lif_list_addr(lif, uc[1], ADD_ADDR);
+	ionic_lif_list_addr(lif, mc, ADD_ADDR);
+	spin_lock_bh(&lif->rx_filters.lock);
+	ionic_rx_filter_save(lif, 0, IONIC_RXQ_INDEX_ANY, 0, &ctx,
+			     IONIC_FILTER_STATE_NEW);
+	fu0 = ionic_rx_filter_by_addr(lif, uc[0]);
+	fu1 = ionic_rx_filter_by_addr(lif, uc[1]);
+	fm = ionic_rx_filter_by_addr(lif, mc);
+	fv = ionic_rx_filter_by_vlan(lif, 10);
+	spin_unlock_bh(&lif->rx_filters.lock);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, fu0);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, fu1);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, fm);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, fv);
+
+	/* unsynced filters */
+	IONIC_EXPECT_OVERFLOW(test, lif, false, false, false);
+
+	/* transient add errors leave filters NEW but aren't overflow */
+	for (i = 0; i < ARRAY_SIZE(transient); i++) {
+		ionic_rx_filter_test_add(lif, fu0, transient[i]);
+		ionic_rx_filter_test_add(lif, fm, transient[i]);
+		ionic_rx_filter_test_add(lif, fv, transient[i]);
+		IONIC_EXPECT_OVERFLOW(test, lif, false, false, false);
+	}
+
+	/* out of room, each class on its own */
+	ionic_rx_filter_test_add(lif, fu0, 0);
+	ionic_rx_filter_test_add(lif, fu1, -ENOSPC);
+	IONIC_EXPECT_OVERFLOW(test, lif, true, false, false);
+	ionic_rx_filter_test_add(lif, fm, -ENOSPC);
+	ionic_rx_filter_test_add(lif, fv, -ENOSPC);
+	IONIC_EXPECT_OVERFLOW(test, lif, true, true, true);
+
+	/* an add that comes in meanwhile doesn't change anything */
+	ionic_lif_list_addr(lif, uc[2], ADD_ADDR);
+	ionic_rx_filter_test_add(lif, fm, 0);
+	IONIC_EXPECT_OVERFLOW(test, lif, true, false, true);
+
+	/* a later transient error no longer says the table is full */
+	ionic_rx_filter_test_add(lif, fv, -ETIMEDOUT);
+	IONIC_EXPECT_OVERFLOW(test, lif, true, false, false);
+
+	/* room again: the retried adds go through and overflow clears */
+	ionic_rx_filter_test_add(lif, fu1, 0);
+	ionic_rx_filter_test_add(lif, fv, 0);
+	IONIC_EXPECT_OVERFLOW(test, lif, false, false, false);
+
+	/* deleting a filter that is out of room takes it with it */
+	ionic_rx_filter_test_add(lif, fu0, -ENOSPC);
+	IONIC_EXPECT_OVERFLOW(test, lif, true, false, false);
+	ionic_lif_list_addr(lif, uc[0], DEL_ADDR);
+	IONIC_EXPECT_OVERFLOW(test, lif, false, false, false);
+}
+
+#define IONIC_RX_FILTER_STRESS_ADDRS	256
+#define IONIC_RX_FILTER_STRESS_OPS	20000
+#define IONIC_RX_FILTER_STRESS_READERS	4
+
+struct ionic_rx_filter_stress {
+	struct ionic_lif *lif;
+	unsigned long lookups;
+	unsigned long bad;
+	u32 seed;
+};
+
+static u32 ionic_rx_filter_stress_rand(u32 *seed)
+{
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 17;
+	*seed ^= *seed << 5;
+	return *seed;
+}
+
+/* Spread the addresses over the buckets, the key is the first 4 bytes */
+static void ionic_rx_filter_stress_addr(u8 *addr, unsigned int i)
+{
+	addr[0] = 0x02;
+	addr[1] = i;
+	addr[2] = i >> 3;
+	addr[3] = 0;
+	addr[4] = 0;
+	addr[5] = i;
+}
+
+/* Lockless lookups the way the rx path does them, checking that
+ * whatever comes back is the filter that was asked for
+ */
+static int ionic_rx_filter_stress_reader(void *arg)
+{
+	struct ionic_rx_filter_stress *st = arg;
+	struct ionic_rx_filter *f;
+	u8 addr[ETH_ALEN];
+	unsigned int i;
+
+	while (!kthread_should_stop()) {
+		i = ionic_rx_filter_stress_rand(&st->seed) %
+		    IONIC_RX_FILTER_STRESS_ADDRS;
+		ionic_rx_filter_stress_addr(addr, i);
+
+		rcu_read_lock();
+		f = ionic_rx_filter_by_addr(st->lif, addr);
+		if (f && (le16_to_cpu(f->cmd.match) != IONIC_RX_FILTER_MATCH_MAC ||
+			  memcmp(f->cmd.mac.addr, addr, ETH_ALEN)))
+			st->bad++;
+		f = ionic_rx_filter_by_vlan(st->lif, i);
+		if (f && le16_to_cpu(f->cmd.vlan.vlan) != i)
+			st->bad++;
+		rcu_read_unlock();
+
+		st->lookups++;
+		if (!(st->lookups & 0x3ff))
+			cond_resched();
+	}
+
+	return 0;
+}
+
+/* Race lockless lookups against filters being added, refreshed by a
+ * sync, marked for delete and freed, as the rx path and the rx_mode
+ * work do against each other.
+ */
+static void ionic_rx_filter_rcu_test(struct kunit *test)
+{
+	struct ionic_rx_filter_stress st[IONIC_RX_FILTER_STRESS_READERS] = { };
+	struct task_struct *tsk[IONIC_RX_FILTER_STRESS_READERS] = { };
+	struct ionic_lif *lif = test->priv;
+	struct ionic_admin_ctx ctx = { 0 };
+	unsigned int i, op, nreaders;
+	struct ionic_rx_filter *f;
+	u8 addr[ETH_ALEN];
+	u32 seed = 1;
+
+	nreaders = clamp_t(unsigned int, num_online_cpus() - 1, 1,
+			   IONIC_RX_FILTER_STRESS_READERS);
+	for (i = 0; i < nreaders; i++) {
+		st[i].lif = lif;
+		st[i].seed = 0x9e3779b9 * (i + 1);
+		tsk[i] = kthread_run(ionic_rx_filter_stress_reader, &st[i],
+				     "ionic-rxf-test/%u", i);
+		if (IS_ERR(tsk[i])) {
+			tsk[i] = NULL;
+			break;
+		}
+	}
+
+	for (op = 0; op < IONIC_RX_FILTER_STRESS_OPS; op++) {
+		i = ionic_rx_filter_stress_rand(&seed) %
+		    IONIC_RX_FILTER_STRESS_ADDRS;
+		ionic_rx_filter_stress_addr(addr, i);
+
+		switch (ionic_rx_filter_stress_rand(&seed) % 4) {
+		case 0:
+			ionic_lif_list_addr(lif, addr, ADD_ADDR);
+			break;
+		case 1:
+			ionic_lif_list_addr(lif, addr, DEL_ADDR);
+			break;
+		case 2:
+			/* sync: adds go SYNCED, deletes get freed */
+			spin_lock_bh(&lif->rx_filters.lock);
+			f = ionic_rx_filter_by_addr(lif, addr);
+			if (f && f->state == IONIC_FILTER_STATE_OLD) {
+				ionic_rx_filter_free(lif, f);
+			} else if (f) {
+				ctx.cmd.rx_filter_add = f->cmd;
+				ctx.comp.rx_filter_add.filter_id = cpu_to_le32(op);
+				ionic_rx_filter_save(lif, 0, IONIC_RXQ_INDEX_ANY,
+						     0, &ctx,
+						     IONIC_FILTER_STATE_SYNCED);
+			}
+			spin_unlock_bh(&lif->rx_filters.lock);
+			break;
+		case 3:
+			memset(&ctx.cmd.rx_filter_add, 0,
+			       sizeof(ctx.cmd.rx_filter_add));
+			ctx.cmd.rx_filter_add.match =
+				cpu_to_le16(IONIC_RX_FILTER_MATCH_VLAN);
+			ctx.cmd.rx_filter_add.vlan.vlan = cpu_to_le16(i);
+			spin_lock_bh(&lif->rx_filters.lock);
+			f = ionic_rx_filter_by_vlan(lif, i);
+			if (f)
+				ionic_rx_filter_free(lif, f);
+			else
+				ionic_rx_filter_save(lif, 0, IONIC_RXQ_INDEX_ANY,
+						     0, &ctx,
+						     IONIC_FILTER_STATE_SYNCED);
+			spin_unlock_bh(&lif->rx_filters.lock);
+			break;
+		}
+
+		if (!(op & 0xff))
+			cond_resched();
+	}
+
+	for (i = 0; i < ARRAY_SIZE(tsk); i++) {
+		if (!tsk[i])
+			continue;
+		kthread_stop(tsk[i]);
+		KUNIT_EXPECT_EQ_MSG(test, 0UL, st[i].bad,
+				    "reader %u: %lu of %lu lookups found the wrong filter",
+				    i, st[i].bad, st[i].lookups);
+	}
+}
+
+static struct kunit_case ionic_rx_filter_test_cases[] = {
+	KUNIT_CASE(ionic_rx_filter_overflow_test),
+	KUNIT_CASE(ionic_rx_filter_rcu_test),
+	{}
+};
+
+static struct kunit_suite ionic_rx_filter_test_suite = {
+	.name = "ionic_rx_filter",
+	.init = ionic_rx_filter_test_init,
+	.exit = ionic_rx_filter_test_exit,
+	.test_cases = ionic_rx_filter_test_cases,
+};
+
+kunit_test_suites(&ionic_txrx_test_suite, &ionic_rx_filter_test_suite);
@@ -10,6 +10,10 @@
 #include <linux/crash_dump.h>
 #include <linux/vmalloc.h>
 #include <linux/platform_device.h>
+#include <linux/if_vlan.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/udp.h>
 
 #include "ionic.h"
 #include "ionic_bus.h"
@@ -35,6 +39,7 @@ static const u8 ionic_qtype_versions[IONIC_QTYPE_MAX] = {
 };
 
 static void ionic_link_status_check(struct ionic_lif *lif);
+static void ionic_lif_vlan_features(struct ionic_lif *lif);
 static void ionic_lif_handle_fw_down(struct ionic_lif *lif);
 static void ionic_lif_handle_fw_up(struct ionic_lif *lif);
 static void ionic_lif_set_netdev_info(struct ionic_lif *lif);
@@ -46,6 +51,8 @@ static int ionic_open(struct net_device *netdev);
 static void ionic_stop_queues(struct ionic_lif *lif);
 static int ionic_stop(struct net_device *netdev);
 static void ionic_lif_queue_identify(struct ionic_lif *lif);
+static int ionic_set_nic_features(struct ionic_lif *lif,
+				  netdev_features_t features);
 
 #ifdef HAVE_NET_XDP
 static int ionic_xdp_queues_config(struct ionic_lif *lif);
@@ -113,6 +120,9 @@ static void ionic_lif_deferred_work(struct work_struct *work)
 		case IONIC_DW_TYPE_LINK_STATUS:
 			ionic_link_status_check(lif);
 			break;
+		case IONIC_DW_TYPE_VLAN_FEATURES:
+			ionic_lif_vlan_features(lif);
+			break;
 		case IONIC_DW_TYPE_LIF_RESET:
 			if (w->fw_status) {
 				ionic_lif_handle_fw_up(lif);
@@ -1370,8 +1380,8 @@ static int ionic_addr_del(struct net_device *netdev, const u8 *addr)
 void ionic_lif_rx_mode(struct ionic_lif *lif)
 {
 	struct net_device *netdev = lif->netdev;
-	unsigned int nfilters;
 	unsigned int nd_flags;
+	bool vlan_overflow;
 	char buf[128];
 	u16 rx_mode;
 	int i;
@@ -1391,26 +1401,34 @@ void ionic_lif_rx_mode(struct ionic_lif *lif)
 	if (test_bit(IONIC_LIF_F_RDMA_SNIFFER, lif->state))
 		rx_mode |= IONIC_RX_MODE_F_RDMA_SNIFFER;
 
-	/* sync the filters */
+	/* sync the filters, which also updates the overflow state */
+	vlan_overflow = test_bit(IONIC_LIF_F_VLAN_OVERFLOW, lif->state);
 	ionic_rx_filter_sync(lif);
 
-	/* check for overflow state
-	 *    if so, we track that we overflowed and enable NIC PROMISC
-	 *    else if the overflow is set and not needed
-	 *       we remove our overflow flag and check the netdev flags
-	 *       to see if we can disable NIC PROMISC
+	/* Open up only the class of traffic whose filters overflowed:
+	 * unicast needs PROMISC, multicast gets by with ALLMULTI, and
+	 * vlan overflow turns off vlan filtering in the NIC instead
+	 * (see ionic_set_nic_features()).
 	 */
-	nfilters = le32_to_cpu(lif->identity->eth.max_ucast_filters);
-
-	if (((lif->nucast + lif->nmcast) >= nfilters) ||
-	    (lif->max_vlans && lif->nvlans >= lif->max_vlans)) {
+	if (test_bit(IONIC_LIF_F_UCAST_OVERFLOW, lif->state))
 		rx_mode |= IONIC_RX_MODE_F_PROMISC;
+	if (test_bit(IONIC_LIF_F_MCAST_OVERFLOW, lif->state))
 		rx_mode |= IONIC_RX_MODE_F_ALLMULTI;
-	} else {
-		if (!(nd_flags & IFF_PROMISC))
-			rx_mode &= ~IONIC_RX_MODE_F_PROMISC;
-		if (!(nd_flags & IFF_ALLMULTI))
-			rx_mode &= ~IONIC_RX_MODE_F_ALLMULTI;
+
+	if (vlan_overflow != test_bit(IONIC_LIF_F_VLAN_OVERFLOW, lif->state)) {
+		struct ionic_deferred_work *work;
+
+		/* we may be here without rtnl, so renegotiate from the
+		 * deferred work where it can be taken
+		 */
+		work = kzalloc(sizeof(*work), GFP_KERNEL);
+		if (work) {
+			work->type = IONIC_DW_TYPE_VLAN_FEATURES;
+			netdev_dbg(netdev, "deferred: vlan features\n");
+			ionic_lif_deferred_enqueue(lif, work);
+		} else {
+			netdev_warn(netdev, "vlan filter overflow update dropped\n");
+		}
 	}
 
 	i = scnprintf(buf, sizeof(buf), "rx_mode 0x%04x -> 0x%04x:",
@@ -1451,6 +1469,24 @@ void ionic_lif_rx_mode(struct ionic_lif *lif)
 	mutex_unlock(&lif->config_lock);
 }
 
+/* Renegotiate the lif features for the current vlan filter overflow
+ * state, see ionic_set_nic_features().  Runs from the deferred work so
+ * it can take rtnl like the ndo_set_features path that also gets here.
+ */
+static void ionic_lif_vlan_features(struct ionic_lif *lif)
+{
+	int err;
+
+	rtnl_lock();
+	if (!test_bit(IONIC_LIF_F_FW_RESET, lif->state)) {
+		err = ionic_set_nic_features(lif, lif->netdev->features);
+		if (err)
+			netdev_warn(lif->netdev, "vlan filter overflow update failed: %d\n",
+				    err);
+	}
+	rtnl_unlock();
+}
+
 static void ionic_ndo_set_rx_mode(struct net_device *netdev)
 {
 	struct ionic_lif *lif = netdev_priv(netdev);
@@ -1477,12 +1513,21 @@ static __le64 ionic_netdev_features_to_nic(netdev_features_t features)
 {
 	u64 wanted = 0;
 
+	/* never hand the NIC both TPIDs for one VLAN offload */
+	features = ionic_vlan_fix_features(0, features);
+
 	if (features & NETIF_F_HW_VLAN_CTAG_TX)
 		wanted |= IONIC_ETH_HW_VLAN_TX_TAG;
 	if (features & NETIF_F_HW_VLAN_CTAG_RX)
 		wanted |= IONIC_ETH_HW_VLAN_RX_STRIP;
 	if (features & NETIF_F_HW_VLAN_CTAG_FILTER)
 		wanted |= IONIC_ETH_HW_VLAN_RX_FILTER;
+	if (features & NETIF_F_HW_VLAN_STAG_TX)
+		wanted |= IONIC_ETH_HW_VLAN_STAG_TX_TAG;
+	if (features & NETIF_F_HW_VLAN_STAG_RX)
+		wanted |= IONIC_ETH_HW_VLAN_STAG_RX_STRIP;
+	if (features & NETIF_F_HW_VLAN_STAG_FILTER)
+		wanted |= IONIC_ETH_HW_VLAN_STAG_RX_FILTER;
 	if (features & NETIF_F_RXHASH)
 		wanted |= IONIC_ETH_HW_RX_HASH;
 	if (features & NETIF_F_RXCSUM)
@@ -1522,6 +1567,15 @@ static __le64 ionic_netdev_features_to_nic(netdev_features_t features)
 	if (features & NETIF_F_GSO_UDP_TUNNEL_CSUM)
 		wanted |= IONIC_ETH_HW_TSO_UDP_CSUM;
 
+	/* there are no netdev flags specific to GENEVE, it rides on the
+	 * generic UDP tunnel offloads and is checked per-skb in
+	 * ionic_features_check()
+	 */
+	if (features & NETIF_F_HW_CSUM)
+		wanted |= IONIC_ETH_HW_TX_CSUM_GENEVE;
+	if (features & NETIF_F_GSO_UDP_TUNNEL)
+		wanted |= IONIC_ETH_HW_TSO_GENEVE;
+
 	return cpu_to_le64(wanted);
 }
 
@@ -1548,6 +1602,19 @@ static int ionic_set_nic_features(struct ionic_lif *lif,
 	if (lif->phc)
 		ctx.cmd.lif_setattr.features |= cpu_to_le64(IONIC_ETH_HW_TIMESTAMP);
 
+	/* with the vlan filter table overflowed, let all vlans in rather
+	 * than drop traffic for the ones that didn't get a filter
+	 */
+	if (test_bit(IONIC_LIF_F_VLAN_OVERFLOW, lif->state))
+		ctx.cmd.lif_setattr.features &=
+			~cpu_to_le64(IONIC_ETH_HW_VLAN_RX_FILTER |
+				     IONIC_ETH_HW_VLAN_STAG_RX_FILTER);
+
+	/* tunnel-aware rx csum flags are only used for CHECKSUM_UNNECESSARY */
+	if ((features & NETIF_F_RXCSUM) &&
+	    test_bit(IONIC_LIF_F_RX_CSUM_UNNECESSARY, lif->state))
+		ctx.cmd.lif_setattr.features |= cpu_to_le64(IONIC_ETH_HW_RX_CSUM_GENEVE);
+
 	err = ionic_adminq_post_wait(lif, &ctx);
 	if (err)
 		return err;
@@ -1569,6 +1636,12 @@ static int ionic_set_nic_features(struct ionic_lif *lif,
 		dev_dbg(dev, "feature ETH_HW_VLAN_RX_STRIP\n");
 	if (lif->hw_features & IONIC_ETH_HW_VLAN_RX_FILTER)
 		dev_dbg(dev, "feature ETH_HW_VLAN_RX_FILTER\n");
+	if (lif->hw_features & IONIC_ETH_HW_VLAN_STAG_TX_TAG)
+		dev_dbg(dev, "feature ETH_HW_VLAN_STAG_TX_TAG\n");
+	if (lif->hw_features & IONIC_ETH_HW_VLAN_STAG_RX_STRIP)
+		dev_dbg(dev, "feature ETH_HW_VLAN_STAG_RX_STRIP\n");
+	if (lif->hw_features & IONIC_ETH_HW_VLAN_STAG_RX_FILTER)
+		dev_dbg(dev, "feature ETH_HW_VLAN_STAG_RX_FILTER\n");
 	if (lif->hw_features & IONIC_ETH_HW_RX_HASH)
 		dev_dbg(dev, "feature ETH_HW_RX_HASH\n");
 	if (lif->hw_features & IONIC_ETH_HW_TX_SG)
@@ -1595,6 +1668,12 @@ static int ionic_set_nic_features(struct ionic_lif *lif,
 		dev_dbg(dev, "feature ETH_HW_TSO_UDP\n");
 	if (lif->hw_features & IONIC_ETH_HW_TSO_UDP_CSUM)
 		dev_dbg(dev, "feature ETH_HW_TSO_UDP_CSUM\n");
+	if (lif->hw_features & IONIC_ETH_HW_RX_CSUM_GENEVE)
+		dev_dbg(dev, "feature ETH_HW_RX_CSUM_GENEVE\n");
+	if (lif->hw_features & IONIC_ETH_HW_TX_CSUM_GENEVE)
+		dev_dbg(dev, "feature ETH_HW_TX_CSUM_GENEVE\n");
+	if (lif->hw_features & IONIC_ETH_HW_TSO_GENEVE)
+		dev_dbg(dev, "feature ETH_HW_TSO_GENEVE\n");
 	if (lif->hw_features & IONIC_ETH_HW_TIMESTAMP)
 		dev_dbg(dev, "feature ETH_HW_TIMESTAMP\n");
 
@@ -1605,6 +1684,7 @@ static int ionic_init_nic_features(struct ionic_lif *lif)
 {
 	struct net_device *netdev = lif->netdev;
 	netdev_features_t features;
+	u64 fw_features;
 	int err;
 
 	/* set up what we expect to support by default */
@@ -1650,6 +1730,16 @@ static int ionic_init_nic_features(struct ionic_lif *lif)
 		netdev->hw_features |= NETIF_F_HW_VLAN_CTAG_RX;
 	if (lif->hw_features & IONIC_ETH_HW_VLAN_RX_FILTER)
 		netdev->hw_features |= NETIF_F_HW_VLAN_CTAG_FILTER;
+	/* the 802.1ad offloads are never requested here, only offered
+	 * when the firmware lists them in its lif identity
+	 */
+	fw_features = le64_to_cpu(lif->ionic->ident.lif.eth.config.features);
+	if (fw_features & IONIC_ETH_HW_VLAN_STAG_TX_TAG)
+		netdev->hw_features |= NETIF_F_HW_VLAN_STAG_TX;
+	if (fw_features & IONIC_ETH_HW_VLAN_STAG_RX_STRIP)
+		netdev->hw_features |= NETIF_F_HW_VLAN_STAG_RX;
+	if (fw_features & IONIC_ETH_HW_VLAN_STAG_RX_FILTER)
+		netdev->hw_features |= NETIF_F_HW_VLAN_STAG_FILTER;
 	if (lif->hw_features & IONIC_ETH_HW_RX_HASH)
 		netdev->hw_features |= NETIF_F_RXHASH;
 	if (lif->hw_features & IONIC_ETH_HW_TX_SG)
@@ -1687,14 +1777,15 @@ static int ionic_init_nic_features(struct ionic_lif *lif)
 		netdev->hw_enc_features |= NETIF_F_GSO_UDP_TUNNEL_CSUM;
 
 	netdev->hw_features |= netdev->hw_enc_features;
-	netdev->features |= netdev->hw_features;
+	netdev->features |= netdev->hw_features & ~IONIC_NETIF_F_VLAN_STAG;
 
 	/* some earlier kernels complain if the vlan device inherits
 	 * the NETIF_F_HW_VLAN... flags, so strip them out
 	 */
 	netdev->vlan_features |= netdev->features & ~(NETIF_F_HW_VLAN_CTAG_TX |
 						      NETIF_F_HW_VLAN_CTAG_RX |
-						   NETIF_F_HW_VLAN_CTAG_FILTER);
+						   NETIF_F_HW_VLAN_CTAG_FILTER |
+						   IONIC_NETIF_F_VLAN_STAG);
 
 	netdev->priv_flags |= IFF_UNICAST_FLT |
 			      IFF_LIVE_ADDR_CHANGE;
@@ -1710,6 +1801,34 @@ static int ionic_init_nic_features(struct ionic_lif *lif)
 	return 0;
 }
 
+/* Switch rx checksum reporting between CHECKSUM_COMPLETE and
+ * CHECKSUM_UNNECESSARY, renegotiating the tunnel-aware rx csum
+ * feature that the latter depends on for encapsulated packets.
+ */
+int ionic_lif_set_rx_csum_unnecessary(struct ionic_lif *lif, bool enable)
+{
+	int err;
+
+	if (enable)
+		set_bit(IONIC_LIF_F_RX_CSUM_UNNECESSARY, lif->state);
+	else
+		clear_bit(IONIC_LIF_F_RX_CSUM_UNNECESSARY, lif->state);
+
+	err = ionic_set_nic_features(lif, lif->netdev->features);
+	if (err) {
+		change_bit(IONIC_LIF_F_RX_CSUM_UNNECESSARY, lif->state);
+		netdev_err(lif->netdev, "Failed to set rx csum mode: %d\n", err);
+	}
+
+	return err;
+}
+
+static netdev_features_t ionic_fix_features(struct net_device *netdev,
+					    netdev_features_t features)
+{
+	return ionic_vlan_fix_features(netdev->features, features);
+}
+
 static int ionic_set_features(struct net_device *netdev,
 			      netdev_features_t features)
 {
@@ -1724,6 +1843,62 @@ static int ionic_set_features(struct net_device *netdev,
 	return err;
 }
 
+#ifdef HAVE_NDO_FEATURES_CHECK
+/* The NIC can't be told which UDP ports carry tunnels, so GENEVE is
+ * recognised by its IANA port.  Those frames keep the tunnel csum/TSO
+ * offloads only if the NIC took the GENEVE specific features.  Every
+ * other UDP tunnel keeps them regardless of port.
+ */
+#define IONIC_GENEVE_UDP_PORT	6081
+
+static netdev_features_t ionic_udp_tunnel_features_check(struct ionic_lif *lif,
+							 struct sk_buff *skb,
+							 netdev_features_t features)
+{
+	u8 l4_proto;
+
+	if ((lif->hw_features & IONIC_ETH_HW_TX_CSUM_GENEVE) &&
+	    (lif->hw_features & IONIC_ETH_HW_TSO_GENEVE))
+		return features;
+
+	switch (vlan_get_protocol(skb)) {
+	case htons(ETH_P_IP):
+		l4_proto = ip_hdr(skb)->protocol;
+		break;
+	case htons(ETH_P_IPV6):
+		l4_proto = ipv6_hdr(skb)->nexthdr;
+		break;
+	default:
+		return features;
+	}
+
+	if (l4_proto != IPPROTO_UDP ||
+	    udp_hdr(skb)->dest != htons(IONIC_GENEVE_UDP_PORT))
+		return features;
+
+	if (!(lif->hw_features & IONIC_ETH_HW_TX_CSUM_GENEVE))
+		features &= ~NETIF_F_CSUM_MASK;
+	if (!(lif->hw_features & IONIC_ETH_HW_TSO_GENEVE))
+		features &= ~NETIF_F_GSO_MASK;
+
+	return features;
+}
+
+static netdev_features_t ionic_features_check(struct sk_buff *skb,
+					      struct net_device *netdev,
+					      netdev_features_t features)
+{
+	struct ionic_lif *lif = netdev_priv(netdev);
+
+	features = vlan_features_check(skb, features);
+
+	if (skb->encapsulation)
+		features = ionic_udp_tunnel_features_check(lif, skb, features);
+
+	return features;
+}
+#endif /* HAVE_NDO_FEATURES_CHECK */
+
 static int ionic_set_attr_mac(struct ionic_lif *lif, u8 *mac)
 {
 	struct ionic_admin_ctx ctx = {
@@ -2968,7 +3143,11 @@ static const struct net_device_ops ionic_netdev_ops = {
 #endif
 	.ndo_get_stats64	= ionic_get_stats64,
 	.ndo_set_rx_mode	= ionic_ndo_set_rx_mode,
+	.ndo_fix_features	= ionic_fix_features,
 	.ndo_set_features	= ionic_set_features,
+#ifdef HAVE_NDO_FEATURES_CHECK
+	.ndo_features_check	= ionic_features_check,
+#endif
 	.ndo_set_mac_address	= ionic_set_mac_address,
 	.ndo_validate_addr	= eth_validate_addr,
 #ifdef HAVE_RHEL7_EXTENDED_MIN_MAX_MTU
@@ -3021,7 +3200,11 @@ static const struct net_device_ops ionic_mnic_netdev_ops = {
 #endif
 	.ndo_get_stats64	= ionic_get_stats64,
 	.ndo_set_rx_mode	= ionic_ndo_set_rx_mode,
+	.ndo_fix_features	= ionic_fix_features,
 	.ndo_set_features	= ionic_set_features,
+#ifdef HAVE_NDO_FEATURES_CHECK
+	.ndo_features_check	= ionic_features_check,
+#endif
 	.ndo_set_mac_address	= ionic_set_mac_address,
 	.ndo_validate_addr	= eth_validate_addr,
 	.ndo_tx_timeout         = ionic_tx_timeout,
@@ -3760,6 +3943,9 @@ void ionic_lif_free(struct ionic_lif *lif)
 	mutex_destroy(&lif->queue_lock);
 	mutex_destroy(&lif->dbid_inuse_lock);
 
+	/* filters are kept across a fw reset, so may still be here */
+	ionic_rx_filters_deinit(lif);
+
 	/* free netdev & lif */
 	ionic_debugfs_del_lif(lif);
 	free_netdev(lif->netdev);
@@ -39,6 +39,7 @@ struct ionic_tx_stats {
 	u64 csum;
 	u64 tso;
 	u64 tso_bytes;
+	u64 tso_encap;
 	u64 frags;
 	u64 vlan_inserted;
 	u64 clean;
@@ -60,6 +61,10 @@ struct ionic_rx_stats {
 	u64 bytes;
 	u64 csum_none;
 	u64 csum_complete;
+	u64 csum_unnecessary;
+	u64 csum_unnecessary_inner;
+	u64 unwanted_ucast;
+	u64 unwanted_mcast;
 #ifdef IONIC_DEBUG_STATS
 	u64 buffers_posted;
 #endif
@@ -141,6 +146,7 @@ enum ionic_deferred_work_type {
 	IONIC_DW_TYPE_RX_MODE,
 	IONIC_DW_TYPE_LINK_STATUS,
 	IONIC_DW_TYPE_LIF_RESET,
+	IONIC_DW_TYPE_VLAN_FEATURES,
 };
 
 struct ionic_deferred_work {
@@ -165,10 +171,15 @@ struct ionic_lif_sw_stats {
 	u64 rx_bytes;
 	u64 tx_tso;
 	u64 tx_tso_bytes;
+	u64 tx_tso_encap;
 	u64 tx_csum_none;
 	u64 tx_csum;
 	u64 rx_csum_none;
 	u64 rx_csum_complete;
+	u64 rx_csum_unnecessary;
+	u64 rx_csum_unnecessary_inner;
+	u64 rx_unwanted_ucast;
+	u64 rx_unwanted_mcast;
 	u64 rx_csum_error;
 	u64 tx_hwstamp_valid;
 	u64 tx_hwstamp_invalid;
@@ -205,11 +216,76 @@ enum ionic_lif_state_flags {
 	IONIC_LIF_F_CMB_TX_RINGS,
 	IONIC_LIF_F_CMB_RX_RINGS,
 	IONIC_LIF_F_IN_SHUTDOWN,
+	IONIC_LIF_F_RX_CSUM_UNNECESSARY,
+	IONIC_LIF_F_UCAST_OVERFLOW,
+	IONIC_LIF_F_MCAST_OVERFLOW,
+	IONIC_LIF_F_VLAN_OVERFLOW,
 
 	/* leave this as last */
 	IONIC_LIF_F_STATE_SIZE
 };
 
+/* 802.1ad variants of the VLAN offloads are not in the firmware
+ * interface.  Building with IONIC_VLAN_STAG assumes firmware that lists
+ * these lif features when it applies the VLAN tx flag, rx strip and
+ * VLAN rx filters to an S-tag instead; otherwise they are never
+ * requested or offered.
+ */
+#ifdef IONIC_VLAN_STAG
+#define IONIC_ETH_HW_VLAN_STAG_TX_TAG		BIT(21)
+#define IONIC_ETH_HW_VLAN_STAG_RX_STRIP		BIT(22)
+#define IONIC_ETH_HW_VLAN_STAG_RX_FILTER	BIT(23)
+#else
+#define IONIC_ETH_HW_VLAN_STAG_TX_TAG		0
+#define IONIC_ETH_HW_VLAN_STAG_RX_STRIP		0
+#define IONIC_ETH_HW_VLAN_STAG_RX_FILTER	0
+#endif
+
+#define IONIC_NETIF_F_VLAN_STAG		(NETIF_F_HW_VLAN_STAG_TX | \
+					 NETIF_F_HW_VLAN_STAG_RX | \
+					 NETIF_F_HW_VLAN_STAG_FILTER)
+
+/* The NIC applies each VLAN offload to one TPID at a time, so keep the
+ * 802.1Q and 802.1ad flavours of insert, strip and filter exclusive.
+ * Whichever one was just turned on wins; if neither was on before,
+ * 802.1Q is kept.
+ */
+static inline netdev_features_t ionic_vlan_fix_features(netdev_features_t cur,
+							netdev_features_t features)
+{
+	static const netdev_features_t vlan_pairs[][2] = {
+		{ NETIF_F_HW_VLAN_CTAG_TX, NETIF_F_HW_VLAN_STAG_TX },
+		{ NETIF_F_HW_VLAN_CTAG_RX, NETIF_F_HW_VLAN_STAG_RX },
+		{ NETIF_F_HW_VLAN_CTAG_FILTER, NETIF_F_HW_VLAN_STAG_FILTER },
+	};
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(vlan_pairs); i++) {
+		netdev_features_t ctag = vlan_pairs[i][0];
+		netdev_features_t stag = vlan_pairs[i][1];
+
+		if ((features & (ctag | stag)) != (ctag | stag))
+			continue;
+
+		if ((cur & (ctag | stag)) == ctag)
+			features &= ~ctag;
+		else
+			features &= ~stag;
+	}
+
+	return features;
+}
+
+/* TPID of the tag the NIC strips on rx, the outer one on a
+ * double-tagged frame; the inner tag stays in the packet
+ */
+static inline __be16 ionic_rx_vlan_proto(netdev_features_t features)
+{
+	if (features & NETIF_F_HW_VLAN_STAG_RX)
+		return htons(ETH_P_8021AD);
+	return htons(ETH_P_8021Q);
+}
+
 struct ionic_lif_cfg {
 	int index;
 	enum ionic_api_prsn prsn;
@@ -471,6 +547,7 @@ int ionic_lif_rss_config(struct ionic_lif *lif, u16 types,
 int ionic_intr_alloc(struct ionic *ionic, struct ionic_intr_info *intr);
 void ionic_intr_free(struct ionic *ionic, int index);
 void ionic_lif_rx_mode(struct ionic_lif *lif);
+int ionic_lif_set_rx_csum_unnecessary(struct ionic_lif *lif, bool enable);
 int ionic_reconfigure_queues(struct ionic_lif *lif,
 			     struct ionic_queue_params *qparam);
 int ionic_lif_alloc(struct ionic *ionic);
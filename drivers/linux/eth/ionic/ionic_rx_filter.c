@@ -5,6 +5,8 @@
 #include <linux/dynamic_debug.h>
 #include <linux/etherdevice.h>
 #include <linux/list.h>
+#include <linux/rculist.h>
+#include <linux/vmalloc.h>
 
 #include "ionic.h"
 #include "ionic_lif.h"
@@ -12,11 +14,9 @@
 
 void ionic_rx_filter_free(struct ionic_lif *lif, struct ionic_rx_filter *f)
 {
-	struct device *dev = lif->ionic->dev;
-
 	hlist_del(&f->by_id);
-	hlist_del(&f->by_hash);
-	devm_kfree(dev, f);
+	hlist_del_rcu(&f->by_hash);
+	kfree_rcu(f, rcu);
 }
 
 void ionic_rx_filter_replay(struct ionic_lif *lif)
@@ -34,7 +34,7 @@ void ionic_rx_filter_replay(struct ionic_lif *lif)
 	INIT_HLIST_HEAD(&new_id_list);
 	ac = &ctx.cmd.rx_filter_add;
 
-	for (i = 0; i < IONIC_RX_FILTER_HLISTS; i++) {
+	for (i = 0; i < IONIC_RX_FILTER_HLISTS(&lif->rx_filters); i++) {
 		head = &lif->rx_filters.by_id[i];
 		hlist_for_each_entry_safe(f, tmp, head, by_id) {
 			ctx.work = COMPLETION_INITIALIZER_ONSTACK(ctx.work);
@@ -81,7 +81,7 @@ void ionic_rx_filter_replay(struct ionic_lif *lif)
 	/* rebuild the by_id hash lists with the new filter ids */
 	spin_lock_bh(&lif->rx_filters.lock);
 	hlist_for_each_entry_safe(f, tmp, &new_id_list, by_id) {
-		key = f->filter_id & IONIC_RX_FILTER_HLISTS_MASK;
+		key = f->filter_id & IONIC_RX_FILTER_HLISTS_MASK(&lif->rx_filters);
 		head = &lif->rx_filters.by_id[key];
 		hlist_add_head(&f->by_id, head);
 	}
@@ -90,16 +90,32 @@ void ionic_rx_filter_replay(struct ionic_lif *lif)
 
 int ionic_rx_filters_init(struct ionic_lif *lif)
 {
+	struct ionic_rx_filters *rxf = &lif->rx_filters;
+	struct hlist_head *heads;
+	unsigned int nfilters;
+	unsigned int bits;
 	unsigned int i;
 
-	spin_lock_init(&lif->rx_filters.lock);
+	/* aim for about one filter per bucket at the device limits */
+	nfilters = le32_to_cpu(lif->identity->eth.max_ucast_filters) +
+		   le32_to_cpu(lif->identity->eth.max_mcast_filters);
+	bits = clamp_t(unsigned int, order_base_2(nfilters),
+		       IONIC_RX_FILTER_HASH_BITS_MIN,
+		       IONIC_RX_FILTER_HASH_BITS_MAX);
 
-	spin_lock_bh(&lif->rx_filters.lock);
-	for (i = 0; i < IONIC_RX_FILTER_HLISTS; i++) {
-		INIT_HLIST_HEAD(&lif->rx_filters.by_hash[i]);
-		INIT_HLIST_HEAD(&lif->rx_filters.by_id[i]);
-	}
-	spin_unlock_bh(&lif->rx_filters.lock);
+	heads = vzalloc(2 * sizeof(*heads) << bits);
+	if (!heads)
+		return -ENOMEM;
+
+	for (i = 0; i < (2U << bits); i++)
+		INIT_HLIST_HEAD(&heads[i]);
+
+	spin_lock_init(&rxf->lock);
+	rxf->hash_bits = bits;
+	rxf->by_hash = heads;
+	rxf->by_id = heads + BIT(bits);
+
+	netdev_dbg(lif->netdev, "rx_filter hash buckets %lu\n", BIT(bits));
 
 	return 0;
 }
@@ -111,22 +127,32 @@ void ionic_rx_filters_deinit(struct ionic_lif *lif)
 	struct hlist_node *tmp;
 	unsigned int i;
 
+	if (!lif->rx_filters.by_hash)
+		return;
+
 	spin_lock_bh(&lif->rx_filters.lock);
-	for (i = 0; i < IONIC_RX_FILTER_HLISTS; i++) {
+	for (i = 0; i < IONIC_RX_FILTER_HLISTS(&lif->rx_filters); i++) {
 		head = &lif->rx_filters.by_id[i];
 		hlist_for_each_entry_safe(f, tmp, head, by_id)
 			ionic_rx_filter_free(lif, f);
 	}
 	spin_unlock_bh(&lif->rx_filters.lock);
+
+	/* wait out any lockless readers still walking the buckets */
+	synchronize_rcu();
+
+	vfree(lif->rx_filters.by_hash);
+	lif->rx_filters.by_hash = NULL;
+	lif->rx_filters.by_id = NULL;
 }
 
 int ionic_rx_filter_save(struct ionic_lif *lif, u32 flow_id, u16 rxq_index,
 			 u32 hash, struct ionic_admin_ctx *ctx,
 			 enum ionic_filter_state state)
 {
-	struct device *dev = lif->ionic->dev;
 	struct ionic_rx_filter_add_cmd *ac;
 	struct ionic_rx_filter *f = NULL;
+	bool new_filter = false;
 	struct hlist_head *head;
 	unsigned int key;
 
@@ -151,47 +177,57 @@ int ionic_rx_filter_save(struct ionic_lif *lif, u32 flow_id, u16 rxq_index,
 		return -EINVAL;
 	}
 
+	/* An existing filter stays on its by_hash list for the lockless
+	 * readers, so on a refresh its match and key are left alone and
+	 * only the rest of the command and the by_id linking are redone.
+	 */
 	if (f) {
-		/* remove from current linking so we can refresh it */
 		hlist_del(&f->by_id);
-		hlist_del(&f->by_hash);
+		f->cmd.opcode = ac->opcode;
+		f->cmd.qtype = ac->qtype;
+		f->cmd.lif_index = ac->lif_index;
+		f->cmd.qid = ac->qid;
 	} else {
-		f = devm_kzalloc(dev, sizeof(*f), GFP_ATOMIC);
+		f = kzalloc(sizeof(*f), GFP_ATOMIC);
 		if (!f)
 			return -ENOMEM;
+		new_filter = true;
+		memcpy(&f->cmd, ac, sizeof(f->cmd));
 	}
 
 	f->flow_id = flow_id;
 	f->filter_id = le32_to_cpu(ctx->comp.rx_filter_add.filter_id);
 	f->state = state;
+	f->nospc = false;
 	f->rxq_index = rxq_index;
-	memcpy(&f->cmd, ac, sizeof(f->cmd));
-	netdev_dbg(lif->netdev, "rx_filter add filter_id %d\n", f->filter_id);
-
-	INIT_HLIST_NODE(&f->by_hash);
-	INIT_HLIST_NODE(&f->by_id);
 
-	key = hash_32(key, IONIC_RX_FILTER_HASH_BITS);
-	head = &lif->rx_filters.by_hash[key];
-	hlist_add_head(&f->by_hash, head);
+	if (new_filter) {
+		key = hash_32(key, lif->rx_filters.hash_bits);
+		head = &lif->rx_filters.by_hash[key];
+		hlist_add_head_rcu(&f->by_hash, head);
+	}
+	netdev_dbg(lif->netdev, "rx_filter add filter_id %d\n", f->filter_id);
 
-	key = f->filter_id & IONIC_RX_FILTER_HLISTS_MASK;
+	key = f->filter_id & IONIC_RX_FILTER_HLISTS_MASK(&lif->rx_filters);
 	head = &lif->rx_filters.by_id[key];
 	hlist_add_head(&f->by_id, head);
 
 	return 0;
 }
 
+/* The by_hash lookups may be called either with the filter lock held
+ * or from within an rcu_read_lock() section.
+ */
 struct ionic_rx_filter *ionic_rx_filter_by_vlan(struct ionic_lif *lif, u16 vid)
 {
 	struct ionic_rx_filter *f;
 	struct hlist_head *head;
 	unsigned int key;
 
-	key = hash_32(vid, IONIC_RX_FILTER_HASH_BITS);
+	key = hash_32(vid, lif->rx_filters.hash_bits);
 	head = &lif->rx_filters.by_hash[key];
 
-	hlist_for_each_entry(f, head, by_hash) {
+	hlist_for_each_entry_rcu(f, head, by_hash) {
 		if (le16_to_cpu(f->cmd.match) != IONIC_RX_FILTER_MATCH_VLAN)
 			continue;
 		if (le16_to_cpu(f->cmd.vlan.vlan) == vid)
@@ -208,10 +244,10 @@ struct ionic_rx_filter *ionic_rx_filter_by_addr(struct ionic_lif *lif,
 	struct hlist_head *head;
 	unsigned int key;
 
-	key = hash_32(*(u32 *)addr, IONIC_RX_FILTER_HASH_BITS);
+	key = hash_32(*(u32 *)addr, lif->rx_filters.hash_bits);
 	head = &lif->rx_filters.by_hash[key];
 
-	hlist_for_each_entry(f, head, by_hash) {
+	hlist_for_each_entry_rcu(f, head, by_hash) {
 		if (le16_to_cpu(f->cmd.match) != IONIC_RX_FILTER_MATCH_MAC)
 			continue;
 		if (memcmp(addr, f->cmd.mac.addr, ETH_ALEN) == 0)
@@ -227,10 +263,10 @@ struct ionic_rx_filter *ionic_rx_filter_rxsteer(struct ionic_lif *lif)
 	struct hlist_head *head;
 	unsigned int key;
 
-	key = hash_32(0, IONIC_RX_FILTER_HASH_BITS);
+	key = hash_32(0, lif->rx_filters.hash_bits);
 	head = &lif->rx_filters.by_hash[key];
 
-	hlist_for_each_entry(f, head, by_hash) {
+	hlist_for_each_entry_rcu(f, head, by_hash) {
 		if (le16_to_cpu(f->cmd.match) != IONIC_RX_FILTER_STEER_PKTCLASS)
 			continue;
 		return f;
@@ -301,6 +337,24 @@ int ionic_lif_list_addr(struct ionic_lif *lif, const u8 *addr, bool mode)
 	return 0;
 }
 
+/* Put a filter whose add failed back to NEW for the next sync.  Only
+ * -ENOSPC means the device is out of room and counts toward overflow;
+ * anything else, a timeout or a busy adminq, is just retried.
+ * Called with the filter lock held.
+ */
+IONIC_KUNIT_STATIC void ionic_rx_filter_add_failed(struct ionic_lif *lif,
+						   struct ionic_rx_filter *f, int err)
+{
+	f->state = IONIC_FILTER_STATE_NEW;
+	f->nospc = (err == -ENOSPC);
+
+	/* If -ENOSPC we won't waste time trying to sync again
+	 * until there is a delete that might make room
+	 */
+	if (err != -ENOSPC)
+		set_bit(IONIC_LIF_F_FILTER_SYNC_NEEDED, lif->state);
+}
+
 static int ionic_lif_filter_add(struct ionic_lif *lif,
 				struct ionic_rx_filter_add_cmd *ac)
 {
@@ -364,15 +418,8 @@ static int ionic_lif_filter_add(struct ionic_lif *lif,
 	if (err && err != -EEXIST) {
 		/* set the state back to NEW so we can try again later */
 		f = ionic_rx_filter_find(lif, &ctx.cmd.rx_filter_add);
-		if (f && f->state == IONIC_FILTER_STATE_SYNCED) {
-			f->state = IONIC_FILTER_STATE_NEW;
-
-			/* If -ENOSPC we won't waste time trying to sync again
-			 * until there is a delete that might make room
-			 */
-			if (err != -ENOSPC)
-				set_bit(IONIC_LIF_F_FILTER_SYNC_NEEDED, lif->state);
-		}
+		if (f && f->state == IONIC_FILTER_STATE_SYNCED)
+			ionic_rx_filter_add_failed(lif, f, err);
 
 		spin_unlock_bh(&lif->rx_filters.lock);
 
@@ -555,7 +602,7 @@ struct sync_item {
 	struct ionic_rx_filter f;
 };
 
-void ionic_rx_filter_sync(struct ionic_lif *lif)
+static void ionic_rx_filter_sync_lists(struct ionic_lif *lif)
 {
 	struct device *dev = lif->ionic->dev;
 	struct list_head sync_add_list;
@@ -576,7 +623,7 @@ void ionic_rx_filter_sync(struct ionic_lif *lif)
 	 * into a separate local list that needs no locking.
 	 */
 	spin_lock_bh(&lif->rx_filters.lock);
-	for (i = 0; i < IONIC_RX_FILTER_HLISTS; i++) {
+	for (i = 0; i < IONIC_RX_FILTER_HLISTS(&lif->rx_filters); i++) {
 		head = &lif->rx_filters.by_id[i];
 		hlist_for_each_entry_safe(f, tmp, head, by_id) {
 			if (f->state == IONIC_FILTER_STATE_NEW ||
@@ -588,10 +635,17 @@ void ionic_rx_filter_sync(struct ionic_lif *lif)
 
 				sync_item->f = *f;
 
-				if (f->state == IONIC_FILTER_STATE_NEW)
+				/* unicast addresses go to the front of the
+				 * add list so that they get first claim on
+				 * the exact-match slots
+				 */
+				if (f->state == IONIC_FILTER_STATE_OLD)
+					list_add(&sync_item->list, &sync_del_list);
+				else if (le16_to_cpu(f->cmd.match) == IONIC_RX_FILTER_MATCH_MAC &&
+					 !is_multicast_ether_addr(f->cmd.mac.addr))
 					list_add(&sync_item->list, &sync_add_list);
 				else
-					list_add(&sync_item->list, &sync_del_list);
+					list_add_tail(&sync_item->list, &sync_add_list);
 			}
 		}
 	}
@@ -617,3 +671,166 @@ loop_out:
 		devm_kfree(dev, sync_item);
 	}
 }
+
+/* Pull up to @n multicast filters back out of the device to make room
+ * for pending unicast ones.  The evicted filters go back to NEW so they
+ * are picked up again as soon as there is space.
+ */
+static unsigned int ionic_rx_filter_evict_mcast(struct ionic_lif *lif,
+						unsigned int n)
+{
+	struct device *dev = lif->ionic->dev;
+	struct sync_item *sync_item;
+	struct list_head evict_list;
+	struct ionic_rx_filter *f;
+	struct hlist_head *head;
+	struct sync_item *spos;
+	unsigned int nevicted;
+	unsigned int i;
+	int err;
+
+	INIT_LIST_HEAD(&evict_list);
+	nevicted = 0;
+
+	spin_lock_bh(&lif->rx_filters.lock);
+	for (i = 0; i < IONIC_RX_FILTER_HLISTS(&lif->rx_filters) && n; i++) {
+		head = &lif->rx_filters.by_id[i];
+		hlist_for_each_entry(f, head, by_id) {
+			if (f->state != IONIC_FILTER_STATE_SYNCED ||
+			    le16_to_cpu(f->cmd.match) != IONIC_RX_FILTER_MATCH_MAC ||
+			    !is_multicast_ether_addr(f->cmd.mac.addr))
+				continue;
+
+			sync_item = devm_kzalloc(dev, sizeof(*sync_item),
+						 GFP_ATOMIC);
+			if (!sync_item)
+				goto loop_out;
+
+			sync_item->f = *f;
+			list_add(&sync_item->list, &evict_list);
+			if (!--n)
+				break;
+		}
+	}
+loop_out:
+	spin_unlock_bh(&lif->rx_filters.lock);
+
+	list_for_each_entry_safe(sync_item, spos, &evict_list, list) {
+		struct ionic_admin_ctx ctx = {
+			.work = COMPLETION_INITIALIZER_ONSTACK(ctx.work),
+			.cmd.rx_filter_del = {
+				.opcode = IONIC_CMD_RX_FILTER_DEL,
+				.lif_index = cpu_to_le16(lif->index),
+				.filter_id = cpu_to_le32(sync_item->f.filter_id),
+			},
+		};
+
+		err = ionic_adminq_post_wait_nomsg(lif, &ctx);
+		if (!err) {
+			netdev_dbg(lif->netdev, "%s: evicted ADDR %pM id %d\n",
+				   __func__, sync_item->f.cmd.mac.addr,
+				   sync_item->f.filter_id);
+
+			spin_lock_bh(&lif->rx_filters.lock);
+			f = ionic_rx_filter_by_addr(lif, sync_item->f.cmd.mac.addr);
+			if (f && f->state == IONIC_FILTER_STATE_OLD)
+				ionic_rx_filter_free(lif, f);
+			else if (f)
+				f->state = IONIC_FILTER_STATE_NEW;
+			if (lif->nmcast)
+				lif->nmcast--;
+			spin_unlock_bh(&lif->rx_filters.lock);
+
+			nevicted++;
+		}
+
+		list_del(&sync_item->list);
+		devm_kfree(dev, sync_item);
+	}
+
+	return nevicted;
+}
+
+/* Filters the device turned away with -ENOSPC and that are still NEW
+ * after a sync; ones NEW for any other reason, a transient add error
+ * or an add that just came in, don't mean the table is full.
+ */
+IONIC_KUNIT_STATIC void ionic_rx_filter_count_pending(struct ionic_lif *lif,
+						      unsigned int *ucast,
+						      unsigned int *mcast,
+						      unsigned int *vlan)
+{
+	struct ionic_rx_filter *f;
+	struct hlist_head *head;
+	unsigned int i;
+
+	*ucast = 0;
+	*mcast = 0;
+	*vlan = 0;
+
+	spin_lock_bh(&lif->rx_filters.lock);
+	for (i = 0; i < IONIC_RX_FILTER_HLISTS(&lif->rx_filters); i++) {
+		head = &lif->rx_filters.by_id[i];
+		hlist_for_each_entry(f, head, by_id) {
+			if (f->state != IONIC_FILTER_STATE_NEW || !f->nospc)
+				continue;
+
+			switch (le16_to_cpu(f->cmd.match)) {
+			case IONIC_RX_FILTER_MATCH_VLAN:
+				(*vlan)++;
+				break;
+			case IONIC_RX_FILTER_MATCH_MAC:
+				if (is_multicast_ether_addr(f->cmd.mac.addr))
+					(*mcast)++;
+				else
+					(*ucast)++;
+				break;
+			}
+		}
+	}
+	spin_unlock_bh(&lif->rx_filters.lock);
+}
+
+static void ionic_rx_filter_overflow_set(struct ionic_lif *lif, int bit,
+					 unsigned int pending, const char *what)
+{
+	if (pending) {
+		if (!test_and_set_bit(bit, lif->state))
+			netdev_info(lif->netdev, "%s filter overflow, %u pending\n",
+				    what, pending);
+	} else if (test_and_clear_bit(bit, lif->state)) {
+		netdev_info(lif->netdev, "%s filter overflow cleared\n", what);
+	}
+}
+
+IONIC_KUNIT_STATIC void ionic_rx_filter_overflow_update(struct ionic_lif *lif,
+							unsigned int ucast,
+							unsigned int mcast,
+							unsigned int vlan)
+{
+	ionic_rx_filter_overflow_set(lif, IONIC_LIF_F_UCAST_OVERFLOW,
+				     ucast, "unicast");
+	ionic_rx_filter_overflow_set(lif, IONIC_LIF_F_MCAST_OVERFLOW,
+				     mcast, "multicast");
+	ionic_rx_filter_overflow_set(lif, IONIC_LIF_F_VLAN_OVERFLOW,
+				     vlan, "vlan");
+}
+
+void ionic_rx_filter_sync(struct ionic_lif *lif)
+{
+	unsigned int ucast, mcast, vlan;
+
+	ionic_rx_filter_sync_lists(lif);
+	ionic_rx_filter_count_pending(lif, &ucast, &mcast, &vlan);
+
+	/* Unicast overflow costs PROMISC where multicast overflow only
+	 * costs ALLMULTI, so let unicast take exact-match slots from
+	 * multicast and try again.
+	 */
+	if (ucast && lif->nmcast && ionic_rx_filter_evict_mcast(lif, ucast)) {
+		ionic_rx_filter_sync_lists(lif);
+		ionic_rx_filter_count_pending(lif, &ucast, &mcast, &vlan);
+	}
+
+	ionic_rx_filter_overflow_update(lif, ucast, mcast, vlan);
+}
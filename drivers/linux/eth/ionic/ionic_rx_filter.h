@@ -17,18 +17,29 @@ struct ionic_rx_filter {
 	u32 filter_id;
 	u16 rxq_index;
 	enum ionic_filter_state state;
+	bool nospc;			/* last add failed with -ENOSPC */
 	struct ionic_rx_filter_add_cmd cmd;
 	struct hlist_node by_hash;
 	struct hlist_node by_id;
+	struct rcu_head rcu;
 };
 
-#define IONIC_RX_FILTER_HASH_BITS	10
-#define IONIC_RX_FILTER_HLISTS		BIT(IONIC_RX_FILTER_HASH_BITS)
-#define IONIC_RX_FILTER_HLISTS_MASK	(IONIC_RX_FILTER_HLISTS - 1)
+/* The bucket count is fixed at lif init from the device's
+ * max_ucast_filters + max_mcast_filters and the tables are never
+ * resized; more filters than that just make for longer chains.
+ * by_hash may be walked under rcu_read_lock() with the filter match
+ * and key fields being stable once published; everything else,
+ * including by_id, needs the lock.
+ */
+#define IONIC_RX_FILTER_HASH_BITS_MIN	10
+#define IONIC_RX_FILTER_HASH_BITS_MAX	16
+#define IONIC_RX_FILTER_HLISTS(f)	BIT((f)->hash_bits)
+#define IONIC_RX_FILTER_HLISTS_MASK(f)	(IONIC_RX_FILTER_HLISTS(f) - 1)
 struct ionic_rx_filters {
-	spinlock_t lock;				    /* filter list lock */
-	struct hlist_head by_hash[IONIC_RX_FILTER_HLISTS];  /* by skb hash */
-	struct hlist_head by_id[IONIC_RX_FILTER_HLISTS];    /* by filter_id */
+	spinlock_t lock;		/* filter list lock */
+	unsigned int hash_bits;
+	struct hlist_head *by_hash;	/* by skb hash */
+	struct hlist_head *by_id;	/* by filter_id */
 };
 
 void ionic_rx_filter_free(struct ionic_lif *lif, struct ionic_rx_filter *f);
@@ -45,5 +56,13 @@ void ionic_rx_filter_sync(struct ionic_lif *lif);
 int ionic_lif_list_addr(struct ionic_lif *lif, const u8 *addr, bool mode);
 int ionic_lif_vlan_add(struct ionic_lif *lif, const u16 vid);
 int ionic_lif_vlan_del(struct ionic_lif *lif, const u16 vid);
+#if IS_ENABLED(CONFIG_IONIC_KUNIT_TEST)
+void ionic_rx_filter_add_failed(struct ionic_lif *lif,
+				struct ionic_rx_filter *f, int err);
+void ionic_rx_filter_count_pending(struct ionic_lif *lif, unsigned int *ucast,
+				   unsigned int *mcast, unsigned int *vlan);
+void ionic_rx_filter_overflow_update(struct ionic_lif *lif, unsigned int ucast,
+				     unsigned int mcast, unsigned int vlan);
+#endif
 
 #endif /* _IONIC_RX_FILTER_H_ */
@@ -14,10 +14,15 @@ static const struct ionic_stat_desc ionic_lif_stats_desc[] = {
 	IONIC_LIF_STAT_DESC(rx_bytes),
 	IONIC_LIF_STAT_DESC(tx_tso),
 	IONIC_LIF_STAT_DESC(tx_tso_bytes),
+	IONIC_LIF_STAT_DESC(tx_tso_encap),
 	IONIC_LIF_STAT_DESC(tx_csum_none),
 	IONIC_LIF_STAT_DESC(tx_csum),
 	IONIC_LIF_STAT_DESC(rx_csum_none),
 	IONIC_LIF_STAT_DESC(rx_csum_complete),
+	IONIC_LIF_STAT_DESC(rx_csum_unnecessary),
+	IONIC_LIF_STAT_DESC(rx_csum_unnecessary_inner),
+	IONIC_LIF_STAT_DESC(rx_unwanted_ucast),
+	IONIC_LIF_STAT_DESC(rx_unwanted_mcast),
 	IONIC_LIF_STAT_DESC(rx_csum_error),
 	IONIC_LIF_STAT_DESC(hw_tx_dropped),
 	IONIC_LIF_STAT_DESC(hw_rx_dropped),
@@ -169,6 +174,7 @@ static const struct ionic_stat_desc ionic_tx_stats_desc[] = {
 	IONIC_TX_STAT_DESC(linearize),
 	IONIC_TX_STAT_DESC(tso),
 	IONIC_TX_STAT_DESC(tso_bytes),
+	IONIC_TX_STAT_DESC(tso_encap),
 	IONIC_TX_STAT_DESC(hwstamp_valid),
 	IONIC_TX_STAT_DESC(hwstamp_invalid),
 #ifdef IONIC_DEBUG_STATS
@@ -191,7 +197,11 @@ static const struct ionic_stat_desc ionic_rx_stats_desc[] = {
 	IONIC_RX_STAT_DESC(vlan_stripped),
 	IONIC_RX_STAT_DESC(csum_none),
 	IONIC_RX_STAT_DESC(csum_complete),
+	IONIC_RX_STAT_DESC(csum_unnecessary),
+	IONIC_RX_STAT_DESC(csum_unnecessary_inner),
 #endif
+	IONIC_RX_STAT_DESC(unwanted_ucast),
+	IONIC_RX_STAT_DESC(unwanted_mcast),
 	IONIC_RX_STAT_DESC(csum_error),
 	IONIC_RX_STAT_DESC(hwstamp_valid),
 	IONIC_RX_STAT_DESC(hwstamp_invalid),
@@ -260,6 +270,7 @@ static void ionic_add_lif_txq_stats(struct ionic_lif *lif, int q_num,
 	stats->tx_bytes += txstats->bytes;
 	stats->tx_tso += txstats->tso;
 	stats->tx_tso_bytes += txstats->tso_bytes;
+	stats->tx_tso_encap += txstats->tso_encap;
 	stats->tx_csum_none += txstats->csum_none;
 	stats->tx_csum += txstats->csum;
 	stats->tx_hwstamp_valid += txstats->hwstamp_valid;
@@ -278,6 +289,10 @@ static void ionic_add_lif_rxq_stats(struct ionic_lif *lif, int q_num,
 	stats->rx_bytes += rxstats->bytes;
 	stats->rx_csum_none += rxstats->csum_none;
 	stats->rx_csum_complete += rxstats->csum_complete;
+	stats->rx_csum_unnecessary += rxstats->csum_unnecessary;
+	stats->rx_csum_unnecessary_inner += rxstats->csum_unnecessary_inner;
+	stats->rx_unwanted_ucast += rxstats->unwanted_ucast;
+	stats->rx_unwanted_mcast += rxstats->unwanted_mcast;
 	stats->rx_csum_error += rxstats->csum_error;
 	stats->rx_hwstamp_valid += rxstats->hwstamp_valid;
 	stats->rx_hwstamp_invalid += rxstats->hwstamp_invalid;
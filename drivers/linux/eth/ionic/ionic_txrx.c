@@ -757,6 +757,104 @@ out_xdp_abort:
 }
 #endif
 
+/* Decide how to report an rx completion's checksum.  With @unnecessary
+ * set, a good L4 result for the packet type is reported as
+ * CHECKSUM_UNNECESSARY; for encapsulated types that takes the
+ * tunnel-aware rx csum feature (@encap_ok), which has the device
+ * validate the tunnel UDP header as well.  Anything else falls back to
+ * CHECKSUM_COMPLETE when the device computed the L2 payload sum.
+ */
+IONIC_KUNIT_STATIC enum ionic_rx_csum ionic_rx_csum_type(u8 csum_flags, u8 pkt_type,
+							 bool unnecessary, bool encap_ok)
+{
+	u8 l4_ok;
+
+	if (unnecessary &&
+	    !(csum_flags & (IONIC_RXQ_COMP_CSUM_F_TCP_BAD |
+			    IONIC_RXQ_COMP_CSUM_F_UDP_BAD |
+			    IONIC_RXQ_COMP_CSUM_F_IP_BAD))) {
+		switch (pkt_type) {
+		case IONIC_PKT_TYPE_IPV4_TCP:
+		case IONIC_PKT_TYPE_IPV6_TCP:
+		case IONIC_PKT_TYPE_ENCAP_IPV4_TCP:
+		case IONIC_PKT_TYPE_ENCAP_IPV6_TCP:
+			l4_ok = csum_flags & IONIC_RXQ_COMP_CSUM_F_TCP_OK;
+			break;
+		case IONIC_PKT_TYPE_IPV4_UDP:
+		case IONIC_PKT_TYPE_IPV6_UDP:
+		case IONIC_PKT_TYPE_ENCAP_IPV4_UDP:
+		case IONIC_PKT_TYPE_ENCAP_IPV6_UDP:
+			l4_ok = csum_flags & IONIC_RXQ_COMP_CSUM_F_UDP_OK;
+			break;
+		default:
+			l4_ok = 0;
+			break;
+		}
+
+		if (l4_ok) {
+			if (!(pkt_type & IONIC_PKT_TYPE_ENCAP_NON_IP))
+				return IONIC_RX_CSUM_UNNECESSARY;
+			if (encap_ok)
+				return IONIC_RX_CSUM_UNNECESSARY_INNER;
+		}
+	}
+
+	if (csum_flags & IONIC_RXQ_COMP_CSUM_F_CALC)
+		return IONIC_RX_CSUM_COMPLETE;
+
+	return IONIC_RX_CSUM_NONE;
+}
+
+static inline bool ionic_rx_csum_encap_ok(struct ionic_lif *lif)
+{
+#ifdef HAVE_SKBUFF_CSUM_LEVEL
+	return lif->hw_features & IONIC_ETH_HW_RX_CSUM_GENEVE;
+#else
+	/* no csum_level to report the inner checksum with */
+	return false;
+#endif
+}
+
+/* While a filter table is overflowed the NIC is passing up more than
+ * the stack asked for; count the frames that no filter would have let
+ * in so the cost of the overflow can be seen.
+ */
+static void ionic_rx_overflow_stats(struct ionic_queue *q, struct sk_buff *skb,
+				    bool use_copybreak,
+				    struct ionic_rx_stats *stats)
+{
+	struct ionic_lif *lif = q->lif;
+	const struct ethhdr *eth;
+	bool mcast;
+
+	if (likely(!test_bit(IONIC_LIF_F_UCAST_OVERFLOW, lif->state) &&
+		   !test_bit(IONIC_LIF_F_MCAST_OVERFLOW, lif->state)))
+		return;
+
+	if (use_copybreak)
+		eth = eth_hdr(skb);
+	else
+		eth = skb_frag_address(&skb_shinfo(skb)->frags[0]);
+
+	if (is_broadcast_ether_addr(eth->h_dest))
+		return;
+
+	mcast = is_multicast_ether_addr(eth->h_dest);
+	if (mcast && !test_bit(IONIC_LIF_F_MCAST_OVERFLOW, lif->state))
+		return;
+	if (!mcast && !test_bit(IONIC_LIF_F_UCAST_OVERFLOW, lif->state))
+		return;
+
+	rcu_read_lock();
+	if (!ionic_rx_filter_by_addr(lif, eth->h_dest)) {
+		if (mcast)
+			stats->unwanted_mcast++;
+		else
+			stats->unwanted_ucast++;
+	}
+	rcu_read_unlock();
+}
+
 static void ionic_rx_clean(struct ionic_queue *q,
 			   struct ionic_rx_desc_info *desc_info,
 			   struct ionic_rxq_comp *comp)
@@ -767,6 +865,7 @@ static void ionic_rx_clean(struct ionic_queue *q,
 #ifdef HAVE_NET_XDP
 	struct bpf_prog *xdp_prog;
 #endif
+	enum ionic_rx_csum csum_type;
 	unsigned int headroom;
 	struct sk_buff *skb;
 	bool synced = false;
@@ -809,6 +908,8 @@ static void ionic_rx_clean(struct ionic_queue *q,
 		return;
 	}
 
+	ionic_rx_overflow_stats(q, skb, use_copybreak, stats);
+
 #ifdef CSUM_DEBUG
 	csum = ip_compute_csum(skb->data, skb->len);
 #endif
@@ -829,11 +930,41 @@ static void ionic_rx_clean(struct ionic_queue *q,
 			skb_set_hash(skb, le32_to_cpu(comp->rss_hash),
 				     PKT_HASH_TYPE_L4);
 			break;
+		/* only seen with tunnel-aware rx csum enabled */
+		case IONIC_PKT_TYPE_ENCAP_IPV4:
+		case IONIC_PKT_TYPE_ENCAP_IPV6:
+		case IONIC_PKT_TYPE_ENCAP_IPV4_TCP:
+		case IONIC_PKT_TYPE_ENCAP_IPV6_TCP:
+		case IONIC_PKT_TYPE_ENCAP_IPV4_UDP:
+		case IONIC_PKT_TYPE_ENCAP_IPV6_UDP:
+			skb_set_hash(skb, le32_to_cpu(comp->rss_hash),
+				     PKT_HASH_TYPE_L3);
+			break;
 		}
 	}
 
-	if (likely(netdev->features & NETIF_F_RXCSUM) &&
-	    (comp->csum_flags & IONIC_RXQ_COMP_CSUM_F_CALC)) {
+	if (likely(netdev->features & NETIF_F_RXCSUM))
+		csum_type = ionic_rx_csum_type(comp->csum_flags,
+					       comp->pkt_type_color & IONIC_RXQ_COMP_PKT_TYPE_MASK,
+					       test_bit(IONIC_LIF_F_RX_CSUM_UNNECESSARY, q->lif->state),
+					       ionic_rx_csum_encap_ok(q->lif));
+	else
+		csum_type = IONIC_RX_CSUM_NONE;
+
+	if (csum_type == IONIC_RX_CSUM_UNNECESSARY) {
+		skb->ip_summed = CHECKSUM_UNNECESSARY;
+#ifdef IONIC_DEBUG_STATS
+		stats->csum_unnecessary++;
+#endif
+#ifdef HAVE_SKBUFF_CSUM_LEVEL
+	} else if (csum_type == IONIC_RX_CSUM_UNNECESSARY_INNER) {
+		skb->ip_summed = CHECKSUM_UNNECESSARY;
+		skb->csum_level = 1;
+#ifdef IONIC_DEBUG_STATS
+		stats->csum_unnecessary_inner++;
+#endif
+#endif
+	} else if (csum_type == IONIC_RX_CSUM_COMPLETE) {
 		skb->ip_summed = CHECKSUM_COMPLETE;
 		skb->csum = (__force __wsum)le16_to_cpu(comp->csum);
 #ifdef IONIC_DEBUG_STATS
@@ -856,9 +987,11 @@ static void ionic_rx_clean(struct ionic_queue *q,
 		     (comp->csum_flags & IONIC_RXQ_COMP_CSUM_F_IP_BAD)))
 		stats->csum_error++;
 
-	if (likely(netdev->features & NETIF_F_HW_VLAN_CTAG_RX) &&
+	if (likely(netdev->features & (NETIF_F_HW_VLAN_CTAG_RX |
+				       NETIF_F_HW_VLAN_STAG_RX)) &&
 	    (comp->csum_flags & IONIC_RXQ_COMP_CSUM_F_VLAN)) {
-		__vlan_hwaccel_put_tag(skb, htons(ETH_P_8021Q),
+		/* only one of the strip offloads is on, see fix_features */
+		__vlan_hwaccel_put_tag(skb, ionic_rx_vlan_proto(netdev->features),
 				       le16_to_cpu(comp->vlan_tci));
 #ifdef IONIC_DEBUG_STATS
 		stats->vlan_stripped++;
@@ -1708,7 +1841,9 @@ static int ionic_tx_tso(struct net_device *netdev, struct ionic_queue *q,
 	stats->pkts += DIV_ROUND_UP(len - hdrlen, mss);
 	stats->bytes += len;
 	stats->tso++;
-	stats->tso_bytes = len;
+	stats->tso_bytes += len;
+	if (encap)
+		stats->tso_encap++;
 
 	return 0;
 }
@@ -15,6 +15,18 @@ int ionic_txrx_napi(struct napi_struct *napi, int budget);
 netdev_tx_t ionic_start_xmit(struct sk_buff *skb, struct net_device *netdev);
 
 bool ionic_rx_service(struct ionic_cq *cq);
+
+enum ionic_rx_csum {
+	IONIC_RX_CSUM_NONE,
+	IONIC_RX_CSUM_COMPLETE,
+	IONIC_RX_CSUM_UNNECESSARY,	/* outermost L4 checksum */
+	IONIC_RX_CSUM_UNNECESSARY_INNER,	/* tunnel UDP and inner L4 */
+};
+
+#if IS_ENABLED(CONFIG_IONIC_KUNIT_TEST)
+enum ionic_rx_csum ionic_rx_csum_type(u8 csum_flags, u8 pkt_type,
+				      bool unnecessary, bool encap_ok);
+#endif
 #ifdef HAVE_NET_XDP
 int ionic_xdp_xmit(struct net_device *netdev, int n, struct xdp_frame **xdp, u32 flags);
 #endif
@@ -24,6 +24,8 @@
 #include <linux/stringify.h>
 #include <linux/slab.h>
 #include <linux/mm.h>
+#include <linux/ktime.h>
+#include <linux/vmalloc.h>
 #include "mdev_drv.h"
 
 #define DEVINFO_SIZE            0x1000
@@ -58,16 +60,15 @@ static unsigned int mdev_major;
 static struct cdev mdev_cdev;
 struct mutex mdev_list_lock;	/* protect our list handling */
 
+static unsigned int test_mem_kb;
+module_param(test_mem_kb, uint, 0444);
+MODULE_PARM_DESC(test_mem_kb, "Benchmark ring access through each UIO memory type over this much RAM at load");
+
 struct mdev_uio_platdata {
 	struct uio_info *uioinfo;
-	spinlock_t lock;
-	unsigned long flags;
 	struct platform_device *pdev;
-};
-
-/* Bits in mdev_uio_platdata.flags */
-enum {
-	UIO_IRQ_DISABLED = 0,
+	struct mdev_uio_irq irq;
+	u8 memtype[MAX_UIO_MAPS];	/* MDEV_MEM_* */
 };
 
 static int mdev_uio_open(struct uio_info *info, struct inode *inode)
@@ -80,48 +81,55 @@ static int mdev_uio_release(struct uio_info *info, struct inode *inode)
 	return 0;
 }
 
-static irqreturn_t mdev_uio_handler(int irq, struct uio_info *dev_info)
+static int mdev_uio_irqcontrol(struct uio_info *dev_info, s32 irq_on)
 {
 	struct mdev_uio_platdata *priv = dev_info->priv;
 
-	/* Just disable the interrupt in the interrupt controller, and
-	 * remember the state so we can allow user space to enable it later.
-	 */
-
-	spin_lock(&priv->lock);
-	if (!__test_and_set_bit(UIO_IRQ_DISABLED, &priv->flags))
-		disable_irq_nosync(irq);
-	spin_unlock(&priv->lock);
+	return mdev_uio_irq_control(&priv->irq, irq_on);
+}
 
-	return IRQ_HANDLED;
+static pgprot_t mdev_uio_pgprot(unsigned int memtype, pgprot_t prot)
+{
+	switch (memtype) {
+	case MDEV_MEM_WC:
+		return pgprot_writecombine(prot);
+	case MDEV_MEM_CACHED:
+		return prot;
+	default:
+		return pgprot_noncached(prot);
+	}
 }
 
-static int mdev_uio_irqcontrol(struct uio_info *dev_info, s32 irq_on)
+/* Only used when some map is not plain uncached, otherwise the uio
+ * core's UIO_MEM_PHYS mmap does the same thing.
+ */
+static int mdev_uio_mmap(struct uio_info *info, struct vm_area_struct *vma)
 {
-	struct mdev_uio_platdata *priv = dev_info->priv;
-	unsigned long flags;
+	struct mdev_uio_platdata *priv = info->priv;
+	unsigned long mi = vma->vm_pgoff;	/* uio map index */
+	struct uio_mem *mem;
 
-	/* Allow user space to enable and disable the interrupt
-	 * in the interrupt controller, but keep track of the
-	 * state to prevent per-irq depth damage.
-	 *
-	 * Serialize this operation to support multiple tasks and concurrency
-	 * with irq handler on SMP systems.
-	 */
+	if (mi >= MAX_UIO_MAPS || !info->mem[mi].size)
+		return -EINVAL;
+	mem = &info->mem[mi];
 
-	spin_lock_irqsave(&priv->lock, flags);
-	if (irq_on) {
-		if (__test_and_clear_bit(UIO_IRQ_DISABLED, &priv->flags))
-			enable_irq(dev_info->irq);
-	} else {
-		if (!__test_and_set_bit(UIO_IRQ_DISABLED, &priv->flags))
-			disable_irq_nosync(dev_info->irq);
-	}
-	spin_unlock_irqrestore(&priv->lock, flags);
+	vma->vm_page_prot = mdev_uio_pgprot(priv->memtype[mi],
+					    vma->vm_page_prot);
 
-	return 0;
+	return remap_pfn_range(vma, vma->vm_start, mem->addr >> PAGE_SHIFT,
+			       vma->vm_end - vma->vm_start,
+			       vma->vm_page_prot);
 }
 
+static ssize_t irq_stats_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct mdev_uio_platdata *priv = dev_get_drvdata(dev);
+
+	return mdev_uio_irq_show(&priv->irq, buf);
+}
+static DEVICE_ATTR_RO(irq_stats);
+
 static int mdev_uio_probe(struct platform_device *pdev)
 {
 	struct uio_info *uioinfo = dev_get_platdata(&pdev->dev);
@@ -172,8 +180,6 @@ static int mdev_uio_probe(struct platform_device *pdev)
 	}
 
 	priv->uioinfo = uioinfo;
-	spin_lock_init(&priv->lock);
-	priv->flags = 0; /* interrupt is enabled to begin with */
 	priv->pdev = pdev;
 
 	if (!uioinfo->irq) {
@@ -195,8 +201,9 @@ static int mdev_uio_probe(struct platform_device *pdev)
 
 	for (i = 0; i < pdev->num_resources; ++i) {
 		struct resource *r = &pdev->resource[i];
+		unsigned int mi = uiomem - &uioinfo->mem[0];
 
-		if (r->flags != IORESOURCE_MEM)
+		if (resource_type(r) != IORESOURCE_MEM)
 			continue;
 
 		if (uiomem >= &uioinfo->mem[MAX_UIO_MAPS]) {
@@ -212,6 +219,14 @@ static int mdev_uio_probe(struct platform_device *pdev)
 		uiomem->size = PAGE_ALIGN(resource_size(r));
 		dev_info(&pdev->dev, "resource %d size %llu", i, uiomem->size);
 		uiomem->name = r->name;
+
+		/* see mdev_res_flags() */
+		if (r->flags & IORESOURCE_CACHEABLE)
+			priv->memtype[mi] = MDEV_MEM_CACHED;
+		else if (r->flags & IORESOURCE_PREFETCH)
+			priv->memtype[mi] = MDEV_MEM_WC;
+		if (priv->memtype[mi] != MDEV_MEM_UC)
+			uioinfo->mmap = mdev_uio_mmap;
 		++uiomem;
 	}
 
@@ -226,10 +241,14 @@ static int mdev_uio_probe(struct platform_device *pdev)
 	 * for performing hardware specific acknowledge and re-enabling of
 	 * the interrupt in the interrupt controller.
 	 *
+	 * The irq is requested here rather than by the uio core so that
+	 * the handler can coalesce wakeups (see mdev_uio_irq.h).
+	 *
 	 * Interrupt sharing is not supported.
 	 */
 
-	uioinfo->handler = mdev_uio_handler;
+	mdev_uio_irq_init(&priv->irq, uioinfo);
+
 	uioinfo->irqcontrol = mdev_uio_irqcontrol;
 	uioinfo->open = mdev_uio_open;
 	uioinfo->release = mdev_uio_release;
@@ -238,10 +257,24 @@ static int mdev_uio_probe(struct platform_device *pdev)
 	ret = uio_register_device(&pdev->dev, priv->uioinfo);
 	if (ret) {
 		dev_err(&pdev->dev, "unable to register uio device\n");
+		uioinfo->irq = priv->irq.irq;
 		return ret;
 	}
 
 	platform_set_drvdata(pdev, priv);
+
+	ret = mdev_uio_irq_request(&priv->irq);
+	if (ret) {
+		dev_err(&pdev->dev, "unable to request irq %d: %d\n",
+			priv->irq.irq, ret);
+		uio_unregister_device(priv->uioinfo);
+		uioinfo->irq = priv->irq.irq;
+		return ret;
+	}
+
+	if (device_create_file(&pdev->dev, &dev_attr_irq_stats))
+		dev_warn(&pdev->dev, "unable to create irq_stats\n");
+
 	return 0;
 }
 
@@ -249,9 +282,12 @@ static int mdev_uio_remove(struct platform_device *pdev)
 {
 	struct mdev_uio_platdata *priv = platform_get_drvdata(pdev);
 
+	device_remove_file(&pdev->dev, &dev_attr_irq_stats);
+
+	mdev_uio_irq_stop(&priv->irq);
 	uio_unregister_device(priv->uioinfo);
+	mdev_uio_irq_free(&priv->irq);
 
-	priv->uioinfo->handler = NULL;
 	priv->uioinfo->irqcontrol = NULL;
 
 	return 0;
@@ -267,6 +303,27 @@ static int mdev_close(struct inode *i, struct file *f)
 	return 0;
 }
 
+/* Carry the requested UIO memory type in the resource flags */
+static void mdev_res_flags(struct resource *res, int nres,
+			   struct mdev_create_req *req)
+{
+	int i;
+
+	if (!(req->is_uio_dev & MDEV_UIO_DEV))
+		return;
+
+	for (i = 0; i < nres; i++) {
+		switch (MDEV_MEMTYPE_GET(req->is_uio_dev, i)) {
+		case MDEV_MEM_WC:
+			res[i].flags |= IORESOURCE_PREFETCH;
+			break;
+		case MDEV_MEM_CACHED:
+			res[i].flags |= IORESOURCE_CACHEABLE;
+			break;
+		}
+	}
+}
+
 static int mdev_get_mnet_platform_rsrc(struct platform_device *pdev,
 				       struct mdev_create_req *req)
 {
@@ -294,6 +351,8 @@ static int mdev_get_mnet_platform_rsrc(struct platform_device *pdev,
 		}
 	};
 
+	mdev_res_flags(mnet_resource, ARRAY_SIZE(mnet_resource), req);
+
 	/* add resource info */
 	return platform_device_add_resources(pdev, mnet_resource,
 					     ARRAY_SIZE(mnet_resource));
@@ -322,6 +381,8 @@ static int mdev_get_mcrypt_platform_rsrc(struct platform_device *pdev,
 		}
 	};
 
+	mdev_res_flags(mcrypt_resource, ARRAY_SIZE(mcrypt_resource), req);
+
 	/* add resource info */
 	return platform_device_add_resources(pdev, mcrypt_resource,
 					     ARRAY_SIZE(mcrypt_resource));
@@ -335,7 +396,7 @@ static int mdev_attach_one(struct mdev_dev *mdev,
 	struct platform_device *pdev;
 	int err = 0;
 
-	if (req->is_uio_dev)
+	if (req->is_uio_dev & MDEV_UIO_DEV)
 		(void)strscpy(mdev_name, req->name, sizeof(mdev_name) - 1);
 	else
 		snprintf(mdev_name, sizeof(mdev_name) - 1,
@@ -360,7 +421,7 @@ static int mdev_attach_one(struct mdev_dev *mdev,
 
 	switch (cmd) {
 	case MDEV_CREATE_MNET:
-		if (req->is_uio_dev)
+		if (req->is_uio_dev & MDEV_UIO_DEV)
 			pdev->driver_override = kasprintf(GFP_KERNEL, "%s", UIO_DRIVER_NAME);
 		else
 			pdev->driver_override = kasprintf(GFP_KERNEL, "%s", MNET_DRIVER_NAME);
@@ -371,7 +432,7 @@ static int mdev_attach_one(struct mdev_dev *mdev,
 		break;
 
 	case MDEV_CREATE_MCRYPT:
-		if (req->is_uio_dev) {
+		if (req->is_uio_dev & MDEV_UIO_DEV) {
 			pdev->driver_override = kasprintf(GFP_KERNEL, "%s", UIO_DRIVER_NAME);
 			err = mdev_get_mcrypt_platform_rsrc(pdev, req);
 		} else {
@@ -414,13 +475,14 @@ err_out:
 
 static void mdev_detach_one(struct mdev_dev *mdev)
 {
-	const char *name = mdev->pdev->name;
+	char name[MDEV_NAME_LEN + 1] = {0};
 
-	dev_info(mdev_device, "Removing interface %s\n", mdev->pdev->name);
+	/* the pdev, and its name, are freed by the final put */
+	(void)strscpy(name, mdev->pdev->name, sizeof(name));
+	dev_info(mdev_device, "Removing interface %s\n", name);
 
 	/* This will trigger the driver remove() */
 	platform_device_unregister(mdev->pdev);
-	kfree(mdev->pdev);
 	mdev->pdev = NULL;
 
 	dev_info(mdev_device, "Successfully removed %s\n", name);
@@ -437,12 +499,160 @@ static inline bool mdev_ioctl_matches(struct mdev_dev *mdev, unsigned int cmd)
 	return false;
 }
 
+static bool mdev_name_exists(const char *name)
+{
+	struct mdev_dev *mdev;
+
+	list_for_each_entry(mdev, &mdev_list, node) {
+		if (mdev->pdev &&
+		    !strncmp(mdev->pdev->name, name, MDEV_NAME_LEN))
+			return true;
+	}
+
+	return false;
+}
+
+/* Find the first useful empty slot, starting the scan at 'from'
+ * (or the list head if NULL) since anything before it is in use.
+ */
+static struct mdev_dev *mdev_find_free(struct mdev_dev *from, unsigned int cmd)
+{
+	struct mdev_dev *mdev = from;
+
+	if (!mdev)
+		mdev = list_first_entry(&mdev_list, struct mdev_dev, node);
+
+	list_for_each_entry_from(mdev, &mdev_list, node) {
+		if (!mdev->pdev && mdev_ioctl_matches(mdev, cmd))
+			return mdev;
+	}
+
+	return NULL;
+}
+
+static int mdev_create_locked(struct mdev_create_req *req, unsigned int cmd,
+			      struct mdev_dev **cursor)
+{
+	struct mdev_dev *mdev;
+
+	/* if it already exists, quietly ignore this request */
+	if (mdev_name_exists(req->name))
+		return 0;
+
+	mdev = mdev_find_free(*cursor, cmd);
+	if (!mdev) {
+		dev_info(mdev_device, "No device found for %s\n", req->name);
+		return -ENODEV;
+	}
+	*cursor = mdev;
+
+	return mdev_attach_one(mdev, req, cmd);
+}
+
+static int mdev_destroy_locked(const char *name)
+{
+	struct mdev_dev *mdev;
+
+	list_for_each_entry(mdev, &mdev_list, node) {
+		if (!mdev->pdev ||
+		    strncmp(mdev->pdev->name, name, MDEV_NAME_LEN))
+			continue;
+
+		mdev_detach_one(mdev);
+		return 0;
+	}
+
+	dev_info(mdev_device, "Device %s not found\n", name);
+	return -ENODEV;
+}
+
+static const unsigned int mdev_batch_cmd[] = {
+	[MDEV_BATCH_TYPE_MNET] = MDEV_CREATE_MNET,
+	[MDEV_BATCH_TYPE_MCRYPT] = MDEV_CREATE_MCRYPT,
+};
+
+/* Run a whole batch under one hold of the list lock.  Free slots are
+ * handed out in list order, so each type's slot search carries on from
+ * where the previous entry of that type left off.
+ */
+static unsigned int mdev_batch_locked(struct mdev_batch_ent *ents,
+				      unsigned int nents, bool create)
+{
+	struct mdev_dev *cursor[ARRAY_SIZE(mdev_batch_cmd)] = { NULL };
+	struct mdev_batch_ent *ent;
+	unsigned int ndone = 0;
+	unsigned int i;
+
+	for (i = 0; i < nents; i++) {
+		ent = &ents[i];
+		ent->req.name[MDEV_NAME_LEN - 1] = '\0';
+		if (!create)
+			ent->status = mdev_destroy_locked(ent->req.name);
+		else if (ent->type >= ARRAY_SIZE(mdev_batch_cmd))
+			ent->status = -EINVAL;
+		else
+			ent->status = mdev_create_locked(&ent->req,
+							 mdev_batch_cmd[ent->type],
+							 &cursor[ent->type]);
+		if (!ent->status)
+			ndone++;
+	}
+
+	return ndone;
+}
+
+static long mdev_batch_ioctl(void __user *argp, bool create)
+{
+	struct mdev_batch_ent *ents;
+	struct mdev_batch_req breq;
+	void __user *uents;
+	size_t len;
+	long ret = 0;
+	u64 t0;
+
+	if (copy_from_user(&breq, argp, sizeof(breq))) {
+		dev_err(mdev_device, "copy_from_user failed\n");
+		return -EFAULT;
+	}
+
+	if (!breq.nents || breq.nents > MDEV_BATCH_MAX) {
+		dev_err(mdev_device, "Invalid batch size %u\n", breq.nents);
+		return -EINVAL;
+	}
+
+	uents = u64_to_user_ptr(breq.ents);
+	len = breq.nents * sizeof(*ents);
+	ents = memdup_user(uents, len);
+	if (IS_ERR(ents)) {
+		dev_err(mdev_device, "copy_from_user failed\n");
+		return PTR_ERR(ents);
+	}
+
+	t0 = ktime_get_ns();
+	mutex_lock(&mdev_list_lock);
+	breq.ndone = mdev_batch_locked(ents, breq.nents, create);
+	mutex_unlock(&mdev_list_lock);
+
+	dev_info(mdev_device, "%s batch: %u of %u done in %llu us\n",
+		 create ? "Create" : "Destroy", breq.ndone, breq.nents,
+		 (ktime_get_ns() - t0) / NSEC_PER_USEC);
+
+	if (copy_to_user(uents, ents, len) ||
+	    copy_to_user(argp, &breq, sizeof(breq))) {
+		dev_err(mdev_device, "copy_to_user failed\n");
+		ret = -EFAULT;
+	}
+
+	kfree(ents);
+	return ret;
+}
+
 static long mdev_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
 {
 	void __user *argp = (void __user *)arg;
 	char name[MDEV_NAME_LEN+1] = {0};
 	struct mdev_create_req req = {0};
-	struct mdev_dev *mdev;
+	struct mdev_dev *cursor = NULL;
 	int ret = -ENODEV;
 
 	switch (cmd) {
@@ -454,32 +664,11 @@ static long mdev_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
 			break;
 		}
 		dev_info(mdev_device, "Creating %s %s\n",
-			 req.name, req.is_uio_dev ? "(UIO)" : "");
+			 req.name, req.is_uio_dev & MDEV_UIO_DEV ? "(UIO)" : "");
 
 		mutex_lock(&mdev_list_lock);
-
-		/* scan the list to see if it already exists,
-		 * and if so, quietly ignore this request
-		 */
-		list_for_each_entry(mdev, &mdev_list, node) {
-			if (mdev->pdev &&
-			    !strncmp(mdev->pdev->name, req.name, MDEV_NAME_LEN)) {
-				mutex_unlock(&mdev_list_lock);
-				return 0;
-			}
-		}
-
-		/* find the first useful empty slot */
-		list_for_each_entry(mdev, &mdev_list, node) {
-			if (mdev->pdev || !mdev_ioctl_matches(mdev, cmd))
-				continue;
-
-			ret = mdev_attach_one(mdev, &req, cmd);
-			break;
-		}
+		ret = mdev_create_locked(&req, cmd, &cursor);
 		mutex_unlock(&mdev_list_lock);
-		if (ret == -ENODEV)
-			dev_info(mdev_device, "No device found for %s\n", req.name);
 		break;
 
 	case MDEV_DESTROY:
@@ -491,18 +680,16 @@ static long mdev_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
 		dev_info(mdev_device, "Removing %s\n", name);
 
 		mutex_lock(&mdev_list_lock);
-		list_for_each_entry(mdev, &mdev_list, node) {
-			if (!mdev->pdev ||
-			    strncmp(mdev->pdev->name, name, MDEV_NAME_LEN))
-				continue;
-
-			ret = 0;
-			mdev_detach_one(mdev);
-			break;
-		}
+		ret = mdev_destroy_locked(name);
 		mutex_unlock(&mdev_list_lock);
-		if (ret == -ENODEV)
-			dev_info(mdev_device, "Device %s not found\n", name);
+		break;
+
+	case MDEV_CREATE_BATCH:
+		ret = mdev_batch_ioctl(argp, true);
+		break;
+
+	case MDEV_DESTROY_BATCH:
+		ret = mdev_batch_ioctl(argp, false);
 		break;
 
 	default:
@@ -514,6 +701,79 @@ static long mdev_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
 	return ret;
 }
 
+#define MEM_BENCH_PASSES	16
+
+/* Stream 16-byte descriptor writes and reads over kb of RAM mapped with
+ * each MDEV_MEM_* attribute, the same pgprot mdev_uio_mmap() gives
+ * userspace, and report the throughput of each.
+ */
+static void mdev_mem_bench(unsigned int kb)
+{
+	static const char * const mode_name[] = {
+		[MDEV_MEM_UC] = "uc",
+		[MDEV_MEM_WC] = "wc",
+		[MDEV_MEM_CACHED] = "cached",
+	};
+	unsigned int npages = DIV_ROUND_UP(kb * 1024, PAGE_SIZE);
+	u64 t0, twr, trd, bytes, sum = 0;
+	unsigned int i, mode, pass;
+	struct page **pages;
+	size_t n;
+	u64 *p;
+
+	pages = kcalloc(npages, sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return;
+
+	for (i = 0; i < npages; i++) {
+		pages[i] = alloc_page(GFP_KERNEL | __GFP_ZERO);
+		if (!pages[i])
+			goto out_free;
+	}
+
+	n = (size_t)npages * PAGE_SIZE / sizeof(*p);
+	bytes = (u64)n * sizeof(*p) * MEM_BENCH_PASSES;
+
+	for (mode = 0; mode < ARRAY_SIZE(mode_name); mode++) {
+		p = vmap(pages, npages, VM_MAP,
+			 mdev_uio_pgprot(mode, PAGE_KERNEL));
+		if (!p) {
+			dev_err(mdev_device, "mem bench: vmap %s failed\n",
+				mode_name[mode]);
+			continue;
+		}
+
+		t0 = ktime_get_ns();
+		for (pass = 0; pass < MEM_BENCH_PASSES; pass++) {
+			for (i = 0; i < n; i += 2) {
+				WRITE_ONCE(p[i], i);
+				WRITE_ONCE(p[i + 1], pass);
+			}
+		}
+		twr = ktime_get_ns() - t0;
+
+		t0 = ktime_get_ns();
+		for (pass = 0; pass < MEM_BENCH_PASSES; pass++) {
+			for (i = 0; i < n; i += 2)
+				sum += READ_ONCE(p[i]) ^ READ_ONCE(p[i + 1]);
+		}
+		trd = ktime_get_ns() - t0;
+
+		vunmap(p);
+
+		dev_info(mdev_device,
+			 "mem bench %s: %u KB ring, write %llu MB/s, read %llu MB/s\n",
+			 mode_name[mode], kb,
+			 bytes * 1000 / max_t(u64, twr, 1),
+			 bytes * 1000 / max_t(u64, trd, 1));
+	}
+	dev_dbg(mdev_device, "mem bench checksum %llx\n", sum);
+
+out_free:
+	for (i = 0; i < npages && pages[i]; i++)
+		__free_page(pages[i]);
+	kfree(pages);
+}
 
 static struct platform_driver mdev_uio_driver = {
 	.probe = mdev_uio_probe,
@@ -639,6 +899,9 @@ static int __init mdev_init(void)
 	if (ret)
 		goto error_destroy_list;
 
+	if (test_mem_kb)
+		mdev_mem_bench(min_t(unsigned int, test_mem_kb, 16 * 1024));
+
 	return 0;
 
 error_destroy_list:
@@ -2,6 +2,7 @@
 #define _MDEV_DRV_H
 
 #include <linux/ioctl.h>
+#include "mdev_uio_irq.h"
 
 #define DRV_VERSION         "0.1"
 #define DRV_DESCRIPTION     "Pensando mdev Driver"
@@ -36,12 +37,55 @@ struct mdev_create_req {
 	uint64_t msixcfg_pa;
 	uint64_t doorbell_pa;
 	uint64_t tstamp_pa;
-	int is_uio_dev;
+	int is_uio_dev;		/* MDEV_UIO_DEV | MDEV_MEMTYPE()s */
 	char name[MDEV_NAME_LEN];
 };
 
+/* is_uio_dev: bit 0 makes a UIO device.  For UIO devices, 2 bits per
+ * resource (in mdev_create_req order) select how userspace maps it.
+ * The default UC is the plain uncached mapping; CACHED is only for
+ * memory that is coherent with the device.
+ */
+#define MDEV_UIO_DEV		0x1
+
+#define MDEV_RES_REGS		0
+#define MDEV_RES_DRVCFG		1
+#define MDEV_RES_MSIXCFG	2
+#define MDEV_RES_DOORBELL	3
+#define MDEV_RES_TSTAMP		4
+
+#define MDEV_MEM_UC		0
+#define MDEV_MEM_WC		1
+#define MDEV_MEM_CACHED		2
+
+#define MDEV_MEMTYPE(res, type)		((type) << (8 + 2 * (res)))
+#define MDEV_MEMTYPE_GET(v, res)	(((v) >> (8 + 2 * (res))) & 0x3)
+
 #define MDEV_CREATE_MNET 	_IOWR('Q', 11, struct mdev_create_req)
 #define MDEV_DESTROY		_IOW('Q',  12, const char*)
 #define MDEV_CREATE_MCRYPT 	_IOWR('Q', 13, struct mdev_create_req)
 
+/* Batch create/destroy: ents points to an array of nents entries.
+ * Create uses the whole req, destroy uses only req.name.  Each entry's
+ * status is filled in on return, ndone counts the entries that succeeded.
+ */
+#define MDEV_BATCH_TYPE_MNET	0
+#define MDEV_BATCH_TYPE_MCRYPT	1
+#define MDEV_BATCH_MAX		(MAX_MNET_DEVICES + MAX_MCRYPT_DEVICES)
+
+struct mdev_batch_ent {
+	struct mdev_create_req req;
+	uint32_t type;		/* MDEV_BATCH_TYPE_*, create only */
+	int32_t status;		/* out: 0 or -errno */
+};
+
+struct mdev_batch_req {
+	uint64_t ents;		/* user pointer to struct mdev_batch_ent[] */
+	uint32_t nents;
+	uint32_t ndone;		/* out */
+};
+
+#define MDEV_CREATE_BATCH	_IOWR('Q', 14, struct mdev_batch_req)
+#define MDEV_DESTROY_BATCH	_IOWR('Q', 15, struct mdev_batch_req)
+
 #endif /* _MDEV_DRV_H */
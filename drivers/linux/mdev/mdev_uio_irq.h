@@ -0,0 +1,272 @@
+#ifndef _MDEV_UIO_IRQ_H
+#define _MDEV_UIO_IRQ_H
+
+/* Values written to a UIO device of mdev or mnet_uio_pdrv_genirq
+ * (irqcontrol).  0 and 1 disable and enable the interrupt as usual.
+ * COALESCE re-arms with the line left enabled: the next wakeup comes
+ * after COUNT interrupts, or USECS after the first of them if sooner
+ * (USECS 0: no time limit).  POLL leaves the line enabled and only
+ * counts interrupts, without waking userspace, until the next COALESCE
+ * re-arm.  Neither touches the irqchip once in coalescing mode, so
+ * both are refused (-EINVAL) on level-triggered lines.  Counters are in
+ * the device's irq_stats sysfs attribute.
+ */
+#define MDEV_UIO_IRQ_COALESCE	0x40000000
+#define MDEV_UIO_IRQ_POLL	0x20000000
+#define MDEV_UIO_IRQ_COUNT(v)	((v) & 0xff)
+#define MDEV_UIO_IRQ_USECS(v)	(((v) >> 8) & 0x1fffff)
+#define MDEV_UIO_IRQ_REARM(count, usecs) \
+	(MDEV_UIO_IRQ_COALESCE | ((usecs) & 0x1fffff) << 8 | ((count) & 0xff))
+
+#ifdef __KERNEL__
+
+#include <linux/uio_driver.h>
+#include <linux/interrupt.h>
+#include <linux/spinlock.h>
+#include <linux/bitops.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/irq.h>
+
+/* Interrupt state of one UIO device, shared by the mdev and
+ * mnet_uio_pdrv_genirq drivers.  The irq is requested by the driver
+ * rather than the uio core (uioinfo->irq is UIO_IRQ_CUSTOM) so that the
+ * handler can decide when to wake userspace.
+ */
+struct mdev_uio_irq {
+	struct uio_info *uioinfo;
+	spinlock_t lock;
+	unsigned long flags;
+	int irq;		/* 0 if none */
+	struct hrtimer timer;
+	u32 count;		/* irqs per wakeup */
+	u32 usecs;		/* max delay of a wakeup, 0 = none */
+	u32 pending;		/* irqs since the last wakeup */
+	u64 nirqs;		/* irqs received */
+	u64 nwakeups;		/* wakeups delivered */
+	u64 nirqchip;		/* irqchip enable/disable calls */
+};
+
+/* Bits in mdev_uio_irq.flags */
+enum {
+	MDEV_UIO_IRQ_DISABLED = 0,
+	MDEV_UIO_IRQ_COALESCING = 1,	/* line left enabled, wakeups coalesced */
+	MDEV_UIO_IRQ_ARMED = 2,		/* a coalesced wakeup may be delivered */
+	MDEV_UIO_IRQ_STOPPED = 3,	/* being removed, no more wakeups */
+};
+
+/* called with ui->lock held */
+static inline void mdev_uio_irq_wakeup(struct mdev_uio_irq *ui)
+{
+	__clear_bit(MDEV_UIO_IRQ_ARMED, &ui->flags);
+	hrtimer_try_to_cancel(&ui->timer);
+	ui->pending = 0;
+	if (test_bit(MDEV_UIO_IRQ_STOPPED, &ui->flags))
+		return;
+	ui->nwakeups++;
+	uio_event_notify(ui->uioinfo);
+}
+
+/* called with ui->lock held */
+static inline void mdev_uio_irq_arm_timer(struct mdev_uio_irq *ui)
+{
+	hrtimer_start(&ui->timer, us_to_ktime(ui->usecs), HRTIMER_MODE_REL);
+}
+
+static inline enum hrtimer_restart mdev_uio_irq_timer(struct hrtimer *timer)
+{
+	struct mdev_uio_irq *ui = container_of(timer, struct mdev_uio_irq, timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&ui->lock, flags);
+	if (test_bit(MDEV_UIO_IRQ_ARMED, &ui->flags) && ui->pending)
+		mdev_uio_irq_wakeup(ui);
+	spin_unlock_irqrestore(&ui->lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
+static inline irqreturn_t mdev_uio_irq_handler(int irq, void *dev_id)
+{
+	struct mdev_uio_irq *ui = dev_id;
+
+	spin_lock(&ui->lock);
+	ui->nirqs++;
+
+	if (test_bit(MDEV_UIO_IRQ_COALESCING, &ui->flags)) {
+		/* Leave the line enabled and only count the interrupt,
+		 * waking user space once enough of them have arrived.
+		 */
+		ui->pending++;
+		if (test_bit(MDEV_UIO_IRQ_ARMED, &ui->flags)) {
+			if (ui->pending >= ui->count)
+				mdev_uio_irq_wakeup(ui);
+			else if (ui->pending == 1 && ui->usecs)
+				mdev_uio_irq_arm_timer(ui);
+		}
+		spin_unlock(&ui->lock);
+		return IRQ_HANDLED;
+	}
+
+	/* Just disable the interrupt in the interrupt controller, and
+	 * remember the state so we can allow user space to enable it later.
+	 */
+	if (!__test_and_set_bit(MDEV_UIO_IRQ_DISABLED, &ui->flags)) {
+		disable_irq_nosync(irq);
+		ui->nirqchip++;
+	}
+	if (!test_bit(MDEV_UIO_IRQ_STOPPED, &ui->flags)) {
+		ui->nwakeups++;
+		uio_event_notify(ui->uioinfo);
+	}
+	spin_unlock(&ui->lock);
+
+	return IRQ_HANDLED;
+}
+
+/* called with ui->lock held */
+static inline void mdev_uio_irq_line(struct mdev_uio_irq *ui, bool on)
+{
+	if (on) {
+		if (__test_and_clear_bit(MDEV_UIO_IRQ_DISABLED, &ui->flags)) {
+			enable_irq(ui->irq);
+			ui->nirqchip++;
+		}
+	} else {
+		if (!__test_and_set_bit(MDEV_UIO_IRQ_DISABLED, &ui->flags)) {
+			disable_irq_nosync(ui->irq);
+			ui->nirqchip++;
+		}
+	}
+}
+
+static inline int mdev_uio_irq_control(struct mdev_uio_irq *ui, s32 irq_on)
+{
+	unsigned long flags;
+	int err = 0;
+
+	/* Allow user space to enable and disable the interrupt
+	 * in the interrupt controller, but keep track of the
+	 * state to prevent per-irq depth damage.
+	 *
+	 * Serialize this operation to support multiple tasks and concurrency
+	 * with irq handler on SMP systems.
+	 */
+
+	if (irq_on & (MDEV_UIO_IRQ_COALESCE | MDEV_UIO_IRQ_POLL)) {
+		/* Nothing acks the device while the line is left enabled,
+		 * so a level-triggered line would just keep firing.
+		 */
+		if (irqd_is_level_type(irq_get_irq_data(ui->irq)))
+			return -EINVAL;
+	}
+
+	spin_lock_irqsave(&ui->lock, flags);
+	if (test_bit(MDEV_UIO_IRQ_STOPPED, &ui->flags)) {
+		err = -ENODEV;
+	} else if (irq_on & (MDEV_UIO_IRQ_COALESCE | MDEV_UIO_IRQ_POLL)) {
+		/* coalescing modes keep the line enabled throughout */
+		mdev_uio_irq_line(ui, true);
+		__set_bit(MDEV_UIO_IRQ_COALESCING, &ui->flags);
+
+		if (irq_on & MDEV_UIO_IRQ_POLL) {
+			__clear_bit(MDEV_UIO_IRQ_ARMED, &ui->flags);
+			hrtimer_try_to_cancel(&ui->timer);
+		} else {
+			ui->count = max_t(u32, MDEV_UIO_IRQ_COUNT(irq_on), 1);
+			ui->usecs = MDEV_UIO_IRQ_USECS(irq_on);
+			__set_bit(MDEV_UIO_IRQ_ARMED, &ui->flags);
+
+			/* deliver what arrived while we were disarmed */
+			if (ui->pending >= ui->count)
+				mdev_uio_irq_wakeup(ui);
+			else if (ui->pending && ui->usecs)
+				mdev_uio_irq_arm_timer(ui);
+		}
+	} else {
+		if (__test_and_clear_bit(MDEV_UIO_IRQ_COALESCING, &ui->flags)) {
+			__clear_bit(MDEV_UIO_IRQ_ARMED, &ui->flags);
+			hrtimer_try_to_cancel(&ui->timer);
+			ui->pending = 0;
+		}
+		mdev_uio_irq_line(ui, irq_on);
+	}
+	spin_unlock_irqrestore(&ui->lock, flags);
+
+	return err;
+}
+
+static inline ssize_t mdev_uio_irq_show(struct mdev_uio_irq *ui, char *buf)
+{
+	u64 nirqs, nwakeups, nirqchip;
+	unsigned long flags;
+	const char *mode;
+	u32 pending;
+
+	spin_lock_irqsave(&ui->lock, flags);
+	nirqs = ui->nirqs;
+	nwakeups = ui->nwakeups;
+	nirqchip = ui->nirqchip;
+	pending = ui->pending;
+	if (!test_bit(MDEV_UIO_IRQ_COALESCING, &ui->flags))
+		mode = "legacy";
+	else if (test_bit(MDEV_UIO_IRQ_ARMED, &ui->flags))
+		mode = "coalesce";
+	else
+		mode = "poll";
+	spin_unlock_irqrestore(&ui->lock, flags);
+
+	return sprintf(buf, "mode %s irqs %llu wakeups %llu irqchip_ops %llu pending %u\n",
+		       mode, nirqs, nwakeups, nirqchip, pending);
+}
+
+/* Take over uioinfo->irq before uio_register_device() */
+static inline void mdev_uio_irq_init(struct mdev_uio_irq *ui,
+				     struct uio_info *uioinfo)
+{
+	ui->uioinfo = uioinfo;
+	spin_lock_init(&ui->lock);
+	ui->flags = 0; /* interrupt is enabled to begin with */
+	if (uioinfo->irq != UIO_IRQ_NONE) {
+		ui->irq = uioinfo->irq;
+		uioinfo->irq = UIO_IRQ_CUSTOM;
+	}
+	hrtimer_init(&ui->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ui->timer.function = mdev_uio_irq_timer;
+}
+
+/* After uio_register_device() */
+static inline int mdev_uio_irq_request(struct mdev_uio_irq *ui)
+{
+	if (!ui->irq)
+		return 0;
+
+	return request_irq(ui->irq, mdev_uio_irq_handler,
+			   ui->uioinfo->irq_flags, ui->uioinfo->name, ui);
+}
+
+/* Stop wakeups before uio_unregister_device(), then free the irq and
+ * the timer once no irqcontrol write can come in to re-arm them.
+ */
+static inline void mdev_uio_irq_stop(struct mdev_uio_irq *ui)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ui->lock, flags);
+	__set_bit(MDEV_UIO_IRQ_STOPPED, &ui->flags);
+	spin_unlock_irqrestore(&ui->lock, flags);
+}
+
+static inline void mdev_uio_irq_free(struct mdev_uio_irq *ui)
+{
+	if (ui->irq)
+		free_irq(ui->irq, ui);
+	hrtimer_cancel(&ui->timer);
+
+	/* hand the irq back for the next probe with this platform data */
+	ui->uioinfo->irq = ui->irq;
+}
+
+#endif /* __KERNEL__ */
+
+#endif /* _MDEV_UIO_IRQ_H */
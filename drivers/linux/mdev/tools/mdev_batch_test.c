@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (C) 2017-2021 Pensando Systems, Inc */
+
+/*
+ * mdev_batch_test - time mdev device create/destroy from userspace
+ *
+ * Creates and destroys n UIO mnet devices through the mdev misc
+ * device, first one at a time with MDEV_CREATE_MNET/MDEV_DESTROY and
+ * then all at once with MDEV_CREATE_BATCH/MDEV_DESTROY_BATCH, and
+ * reports the per-device cost of each.  The devices take the free
+ * mnet devicetree slots, so none of them may be in use while this
+ * runs.  Device i gets the resources at base + i * stride, in
+ * mdev_create_req order 4KB apart; they must be real device memory
+ * as the UIO driver binds to each device.
+ *
+ * usage: mdev_batch_test -b base [-s stride] [-n ndevs] [-d dev]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+
+#include "mdev_drv.h"
+
+#define DEFAULT_DEV	"/dev/" DRV_NAME
+#define DEFAULT_STRIDE	0x10000
+#define DEFAULT_NDEVS	8
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s -b base [-s stride] [-n ndevs] [-d dev]\n"
+		"  -b base    physical address of device 0's regs\n"
+		"  -s stride  address step between devices (default 0x%x)\n"
+		"  -n ndevs   devices to create (default %d, max %d)\n"
+		"  -d dev     mdev misc device (default %s)\n",
+		prog, DEFAULT_STRIDE, DEFAULT_NDEVS, MAX_MNET_DEVICES,
+		DEFAULT_DEV);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t t0, single_create, single_destroy, batch_create, batch_destroy;
+	unsigned int i, n = DEFAULT_NDEVS, nsingle = 0, nbatch = 0;
+	uint64_t base = 0, stride = DEFAULT_STRIDE;
+	const char *dev = DEFAULT_DEV;
+	struct mdev_batch_req breq = { 0 };
+	struct mdev_batch_ent *ents;
+	int fd, opt, err = 0;
+
+	while ((opt = getopt(argc, argv, "b:s:n:d:")) != -1) {
+		switch (opt) {
+		case 'b':
+			base = strtoull(optarg, NULL, 0);
+			break;
+		case 's':
+			stride = strtoull(optarg, NULL, 0);
+			break;
+		case 'n':
+			n = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			dev = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!base || !n || n > MAX_MNET_DEVICES || stride < 0x5000)
+		usage(argv[0]);
+
+	fd = open(dev, O_RDWR);
+	if (fd < 0) {
+		fprintf(stderr, "%s: %s\n", dev, strerror(errno));
+		return 1;
+	}
+
+	ents = calloc(n, sizeof(*ents));
+	if (!ents) {
+		close(fd);
+		return 1;
+	}
+	for (i = 0; i < n; i++) {
+		struct mdev_create_req *req = &ents[i].req;
+		uint64_t pa = base + i * stride;
+
+		req->regs_pa = pa;
+		req->drvcfg_pa = pa + 0x1000;
+		req->msixcfg_pa = pa + 0x2000;
+		req->doorbell_pa = pa + 0x3000;
+		req->tstamp_pa = pa + 0x4000;
+		req->is_uio_dev = MDEV_UIO_DEV;
+		snprintf(req->name, sizeof(req->name), "mdevtest%u", i);
+		ents[i].type = MDEV_BATCH_TYPE_MNET;
+	}
+
+	t0 = now_ns();
+	for (i = 0; i < n; i++)
+		if (!ioctl(fd, MDEV_CREATE_MNET, &ents[i].req))
+			nsingle++;
+	single_create = now_ns() - t0;
+
+	/* MDEV_DESTROY reads a full MDEV_NAME_LEN name */
+	t0 = now_ns();
+	for (i = 0; i < n; i++)
+		ioctl(fd, MDEV_DESTROY, ents[i].req.name);
+	single_destroy = now_ns() - t0;
+
+	breq.ents = (uint64_t)(uintptr_t)ents;
+	breq.nents = n;
+	t0 = now_ns();
+	if (!ioctl(fd, MDEV_CREATE_BATCH, &breq))
+		nbatch = breq.ndone;
+	batch_create = now_ns() - t0;
+
+	for (i = 0; i < n; i++)
+		if (ents[i].status)
+			fprintf(stderr, "%s: batch create: %s\n",
+				ents[i].req.name, strerror(-ents[i].status));
+
+	breq.ndone = 0;
+	t0 = now_ns();
+	if (ioctl(fd, MDEV_DESTROY_BATCH, &breq) || breq.ndone != nbatch) {
+		fprintf(stderr, "batch destroy: %u of %u destroyed\n",
+			breq.ndone, nbatch);
+		err = 1;
+	}
+	batch_destroy = now_ns() - t0;
+
+	printf("%u devs (%u/%u created), ns/dev single create %llu destroy %llu, "
+	       "batch create %llu destroy %llu\n",
+	       n, nsingle, nbatch,
+	       (unsigned long long)(single_create / n),
+	       (unsigned long long)(single_destroy / n),
+	       (unsigned long long)(batch_create / n),
+	       (unsigned long long)(batch_destroy / n));
+	if (nsingle != n || nbatch != n)
+		err = 1;
+
+	free(ents);
+	close(fd);
+	return err;
+}
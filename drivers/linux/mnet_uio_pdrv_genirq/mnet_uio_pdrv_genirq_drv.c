@@ -29,18 +29,14 @@
 #include <linux/of_platform.h>
 #include <linux/of_address.h>
 
+#include "mdev_uio_irq.h"
+
 #define DRIVER_NAME "uio_pdrv_genirq"
 
 struct uio_pdrv_genirq_platdata {
 	struct uio_info *uioinfo;
-	spinlock_t lock;
-	unsigned long flags;
 	struct platform_device *pdev;
-};
-
-/* Bits in uio_pdrv_genirq_platdata.flags */
-enum {
-	UIO_IRQ_DISABLED = 0,
+	struct mdev_uio_irq irq;
 };
 
 static int uio_pdrv_genirq_open(struct uio_info *info, struct inode *inode)
@@ -61,47 +57,21 @@ static int uio_pdrv_genirq_release(struct uio_info *info, struct inode *inode)
 	return 0;
 }
 
-static irqreturn_t uio_pdrv_genirq_handler(int irq, struct uio_info *dev_info)
+static int uio_pdrv_genirq_irqcontrol(struct uio_info *dev_info, s32 irq_on)
 {
 	struct uio_pdrv_genirq_platdata *priv = dev_info->priv;
 
-	/* Just disable the interrupt in the interrupt controller, and
-	 * remember the state so we can allow user space to enable it later.
-	 */
-
-	spin_lock(&priv->lock);
-	if (!__test_and_set_bit(UIO_IRQ_DISABLED, &priv->flags))
-		disable_irq_nosync(irq);
-	spin_unlock(&priv->lock);
-
-	return IRQ_HANDLED;
+	return mdev_uio_irq_control(&priv->irq, irq_on);
 }
 
-static int uio_pdrv_genirq_irqcontrol(struct uio_info *dev_info, s32 irq_on)
+static ssize_t irq_stats_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
 {
-	struct uio_pdrv_genirq_platdata *priv = dev_info->priv;
-	unsigned long flags;
-
-	/* Allow user space to enable and disable the interrupt
-	 * in the interrupt controller, but keep track of the
-	 * state to prevent per-irq depth damage.
-	 *
-	 * Serialize this operation to support multiple tasks and concurrency
-	 * with irq handler on SMP systems.
-	 */
+	struct uio_pdrv_genirq_platdata *priv = dev_get_drvdata(dev);
 
-	spin_lock_irqsave(&priv->lock, flags);
-	if (irq_on) {
-		if (__test_and_clear_bit(UIO_IRQ_DISABLED, &priv->flags))
-			enable_irq(dev_info->irq);
-	} else {
-		if (!__test_and_set_bit(UIO_IRQ_DISABLED, &priv->flags))
-			disable_irq_nosync(dev_info->irq);
-	}
-	spin_unlock_irqrestore(&priv->lock, flags);
-
-	return 0;
+	return mdev_uio_irq_show(&priv->irq, buf);
 }
+static DEVICE_ATTR_RO(irq_stats);
 
 int mnet_uio_pdrv_genirq_probe(struct platform_device *pdev)
 {
@@ -142,8 +112,6 @@ int mnet_uio_pdrv_genirq_probe(struct platform_device *pdev)
 	}
 
 	priv->uioinfo = uioinfo;
-	spin_lock_init(&priv->lock);
-	priv->flags = 0; /* interrupt is enabled to begin with */
 	priv->pdev = pdev;
 
 	if (!uioinfo->irq) {
@@ -194,10 +162,14 @@ int mnet_uio_pdrv_genirq_probe(struct platform_device *pdev)
 	 * for performing hardware specific acknowledge and re-enabling of
 	 * the interrupt in the interrupt controller.
 	 *
+	 * The irq is requested here rather than by the uio core so that
+	 * the handler can coalesce wakeups (see mdev_uio_irq.h).
+	 *
 	 * Interrupt sharing is not supported.
 	 */
 
-	uioinfo->handler = uio_pdrv_genirq_handler;
+	mdev_uio_irq_init(&priv->irq, uioinfo);
+
 	uioinfo->irqcontrol = uio_pdrv_genirq_irqcontrol;
 	uioinfo->open = uio_pdrv_genirq_open;
 	uioinfo->release = uio_pdrv_genirq_release;
@@ -214,10 +186,24 @@ int mnet_uio_pdrv_genirq_probe(struct platform_device *pdev)
 	if (ret) {
 		dev_err(&pdev->dev, "unable to register uio device\n");
 	//	pm_runtime_disable(&pdev->dev);
+		uioinfo->irq = priv->irq.irq;
 		return ret;
 	}
 
 	platform_set_drvdata(pdev, priv);
+
+	ret = mdev_uio_irq_request(&priv->irq);
+	if (ret) {
+		dev_err(&pdev->dev, "unable to request irq %d: %d\n",
+			priv->irq.irq, ret);
+		uio_unregister_device(priv->uioinfo);
+		uioinfo->irq = priv->irq.irq;
+		return ret;
+	}
+
+	if (device_create_file(&pdev->dev, &dev_attr_irq_stats))
+		dev_warn(&pdev->dev, "unable to create irq_stats\n");
+
 	return 0;
 }
 
@@ -225,10 +211,13 @@ int mnet_uio_pdrv_genirq_remove(struct platform_device *pdev)
 {
 	struct uio_pdrv_genirq_platdata *priv = platform_get_drvdata(pdev);
 
+	device_remove_file(&pdev->dev, &dev_attr_irq_stats);
+
+	mdev_uio_irq_stop(&priv->irq);
 	uio_unregister_device(priv->uioinfo);
+	mdev_uio_irq_free(&priv->irq);
 	// pm_runtime_disable(&pdev->dev);
 
-	priv->uioinfo->handler = NULL;
 	priv->uioinfo->irqcontrol = NULL;
 
 	return 0;
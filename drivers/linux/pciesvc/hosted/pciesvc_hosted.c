@@ -0,0 +1,955 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2023, Oracle and/or its affiliates.
+ */
+
+/*
+ * Hosted (userspace) simulation backend for pciesvc
+ *
+ * This file stands in for kpcinterface.c when the pciesvc library
+ * is built on a development host.  It implements the upcalls from
+ * pciesvc against in-memory models of:
+ *
+ *  - the pxb/pxc/intr register windows, including the indirect
+ *    info/aximst/response registers and the notify pi/ci register
+ *  - hwmem (notify rings, cfgcur) and shmem (devs, spmt, sprt, stats)
+ *  - a block of "bar memory" that direct transactions land in
+ *
+ * Register accesses outside the modeled windows are counted
+ * and read back as zero.
+ */
+
+#include <time.h>
+#include "pciesvc_hosted.h"
+
+/* register offsets within the pxb window */
+#define PXB_OFF(REG)		(PXB_(REG) - HOSTED_PXB_PA)
+#define IND_INFO_OFF		PXB_OFF(STA_TGT_IND_INFO)
+#define IND_RSP_OFF		PXB_OFF(DHS_TGT_IND_RSP_ENTRY)
+#define IND_RSP_NWORDS		5
+#define NOTIFY_OFF		PXB_OFF(DHS_TGT_NOTIFY)
+#define AXIMST_OFF		PXB_OFF(DHS_TGT_AXIMST0)
+#define AXIMST_STRIDE		(ASIC_(PXB_CSR_DHS_TGT_AXIMST1_BYTE_ADDRESS) - \
+				 ASIC_(PXB_CSR_DHS_TGT_AXIMST0_BYTE_ADDRESS))
+#define AXIMST_NROWS		5
+#define AXIMST_ROWSZ		16
+#define AXIMST_ENTRY_STRIDE	32
+#define AXIMST_PORT_STRIDE	(AXIMST_ENTRY_STRIDE * HOSTED_IND_NENTRIES)
+
+typedef struct hosted_window_s {
+	u_int64_t base;
+	u_int64_t size;
+	u_int8_t *mem;
+} hosted_window_t;
+
+enum {
+	WIN_PXB,
+	WIN_PXC,
+	WIN_INTR,
+	WIN_HWMEM,
+	WIN_BARMEM,
+	WIN_COUNT,
+};
+
+typedef struct hosted_indq_s {
+	/* raw sram contents for each entry, 5 rows of 16 bytes */
+	u_int8_t sram[HOSTED_IND_NENTRIES][AXIMST_NROWS * AXIMST_ROWSZ];
+	u_int8_t fifo[HOSTED_IND_NENTRIES];
+	u_int32_t head, count;
+} hosted_indq_t;
+
+typedef struct hosted_s {
+	hosted_window_t win[WIN_COUNT];
+	pciehw_shmem_t *shmem;
+	pciehw_mem_t *hwmem;
+	hosted_indq_t indq[PCIEHW_NPORTS];
+	u_int32_t notify_pi[PCIEHW_NPORTS];
+	u_int32_t notify_ci[PCIEHW_NPORTS];
+	u_int32_t ind_rsp[IND_RSP_NWORDS];
+	hosted_ind_rsp_cb_t ind_rsp_cb;
+	void *ind_rsp_arg;
+	hosted_stats_t stats;
+	int verbose;
+} hosted_t;
+
+static hosted_t hosted;
+
+static void *
+hosted_alloc(const size_t size)
+{
+	void *p;
+
+	/* notify_area wants PCIEHW_NOTIFYSZ alignment in hwmem */
+	if (posix_memalign(&p, PCIEHW_NOTIFYSZ, size))
+		return NULL;
+	memset(p, 0, size);
+	return p;
+}
+
+static hosted_window_t *
+hosted_window(const u_int64_t pa, const size_t sz)
+{
+	hosted_window_t *w;
+	int i;
+
+	for (i = 0; i < WIN_COUNT; i++) {
+		w = &hosted.win[i];
+		if (pa >= w->base && pa + sz <= w->base + w->size)
+			return w;
+	}
+	return NULL;
+}
+
+/*****************************************************************
+ * indirect model
+ */
+
+static int
+aximst_decode(const u_int64_t off, int *port, int *entry, int *row, int *wd)
+{
+	u_int64_t o;
+
+	if (off < AXIMST_OFF || off >= AXIMST_OFF + AXIMST_NROWS * AXIMST_STRIDE)
+		return 0;
+	o = off - AXIMST_OFF;
+	*row = o / AXIMST_STRIDE;
+	o %= AXIMST_STRIDE;
+	*port = o / AXIMST_PORT_STRIDE;
+	o %= AXIMST_PORT_STRIDE;
+	*entry = o / AXIMST_ENTRY_STRIDE;
+	o %= AXIMST_ENTRY_STRIDE;
+	if (o >= AXIMST_ROWSZ || *port >= PCIEHW_NPORTS)
+		return 0;
+	*wd = o / 4;
+	return 1;
+}
+
+static u_int32_t
+ind_info_rd(const int port)
+{
+	hosted_indq_t *q = &hosted.indq[port];
+	u_int32_t v = port << 5;
+
+	if (q->count)
+		v |= 1 | (q->fifo[q->head] << 1);
+	return v;
+}
+
+static void
+ind_rsp_deliver(void)
+{
+	hosted_ind_rsp_t rsp;
+	hosted_indq_t *q;
+	u_int32_t w4 = hosted.ind_rsp[4];
+
+	memcpy(rsp.data, hosted.ind_rsp, sizeof(rsp.data));
+	rsp.cpl = w4 & 0x7;
+	rsp.port = (w4 >> 3) & 0x7;
+	rsp.axi_id = (w4 >> 6) & 0x7f;
+
+	q = &hosted.indq[rsp.port];
+	if (q->count) {
+		q->head = (q->head + 1) % HOSTED_IND_NENTRIES;
+		q->count--;
+	}
+	hosted.stats.ind_rsp++;
+	if (hosted.ind_rsp_cb)
+		hosted.ind_rsp_cb(&rsp, hosted.ind_rsp_arg);
+}
+
+/*****************************************************************
+ * register window access with side effects
+ */
+
+static int
+pxb_rd(const u_int64_t off, u_int32_t *val)
+{
+	int port, entry, row, wd;
+
+	if (off >= IND_INFO_OFF && off < IND_INFO_OFF + PCIEHW_NPORTS * 4) {
+		*val = ind_info_rd((off - IND_INFO_OFF) / 4);
+		return 1;
+	}
+	if (off >= NOTIFY_OFF && off < NOTIFY_OFF + PCIEHW_NPORTS * 4) {
+		port = (off - NOTIFY_OFF) / 4;
+		*val = (hosted.notify_ci[port] << 16) |
+			(hosted.notify_pi[port] & 0xffff);
+		return 1;
+	}
+	if (aximst_decode(off, &port, &entry, &row, &wd)) {
+		u_int8_t *p = hosted.indq[port].sram[entry];
+
+		memcpy(val, &p[row * AXIMST_ROWSZ + wd * 4], 4);
+		return 1;
+	}
+	return 0;
+}
+
+static int
+pxb_wr(const u_int64_t off, const u_int32_t val)
+{
+	if (off >= IND_RSP_OFF && off < IND_RSP_OFF + IND_RSP_NWORDS * 4) {
+		const int wd = (off - IND_RSP_OFF) / 4;
+
+		hosted.ind_rsp[wd] = val;
+		/* last word written commits the response */
+		if (wd == IND_RSP_NWORDS - 1)
+			ind_rsp_deliver();
+		return 1;
+	}
+	if (off >= NOTIFY_OFF && off < NOTIFY_OFF + PCIEHW_NPORTS * 4) {
+		/* only ci is writable by sw */
+		hosted.notify_ci[(off - NOTIFY_OFF) / 4] = val >> 16;
+		return 1;
+	}
+	return 0;
+}
+
+/*****************************************************************
+ * setup
+ */
+
+int
+pciesvc_hosted_init(const int hi_ndev)
+{
+	const size_t shmemsz = hi_ndev ?
+		sizeof(pciehw_shmem_hi_t) : sizeof(pciehw_shmem_lo_t);
+	const size_t hwmemsz = hi_ndev ?
+		sizeof(pciehw_mem_hi_t) : sizeof(pciehw_mem_lo_t);
+	pciehw_shmem_t *pshmem;
+	pciehw_mem_t *phwmem;
+	int i;
+
+	memset(&hosted, 0, sizeof(hosted));
+
+	hosted.win[WIN_PXB].base = HOSTED_PXB_PA;
+	hosted.win[WIN_PXB].size = HOSTED_PXB_SIZE;
+	hosted.win[WIN_PXC].base = HOSTED_PXC_PA;
+	hosted.win[WIN_PXC].size = HOSTED_PXC_SIZE;
+	hosted.win[WIN_INTR].base = HOSTED_INTR_PA;
+	hosted.win[WIN_INTR].size = HOSTED_INTR_SIZE;
+	hosted.win[WIN_HWMEM].base = HOSTED_HWMEM_PA;
+	hosted.win[WIN_HWMEM].size = hwmemsz;
+	hosted.win[WIN_BARMEM].base = HOSTED_BARMEM_PA;
+	hosted.win[WIN_BARMEM].size = HOSTED_BARMEM_SIZE;
+
+	for (i = 0; i < WIN_COUNT; i++) {
+		hosted_window_t *w = &hosted.win[i];
+
+		w->mem = hosted_alloc(w->size);
+		if (w->mem == NULL)
+			goto err_out;
+	}
+	hosted.shmem = hosted_alloc(shmemsz);
+	if (hosted.shmem == NULL)
+		goto err_out;
+	hosted.hwmem = (pciehw_mem_t *)hosted.win[WIN_HWMEM].mem;
+
+	pshmem = hosted.shmem;
+	phwmem = hosted.hwmem;
+	pshmem->lo.magic = PCIEHW_MAGIC;
+	pshmem->lo.version = PCIEHW_VERSION;
+	pshmem->lo.hwinit = 1;
+	pshmem->lo.hi_ndev = hi_ndev ? 1 : 0;
+	/* handle 0 is reserved, see cfgpa_to_hwdevh() */
+	PSHMEM_ASGN_FIELD(pshmem, allocdev, 1);
+	PSHMEM_ASGN_FIELD(pshmem, notify_ring_mask,
+			  (PCIEHW_NOTIFYSZ / sizeof(notify_entry_t)) - 1);
+	PHWMEM_ASGN_FIELD(phwmem, pshmem, magic, PCIEHW_MAGIC);
+	PHWMEM_ASGN_FIELD(phwmem, pshmem, version, PCIEHW_VERSION);
+	return 0;
+
+ err_out:
+	pciesvc_hosted_fini();
+	return -1;
+}
+
+void
+pciesvc_hosted_fini(void)
+{
+	int i;
+
+	for (i = 0; i < WIN_COUNT; i++)
+		free(hosted.win[i].mem);
+	free(hosted.shmem);
+	memset(&hosted, 0, sizeof(hosted));
+}
+
+pciehw_shmem_t *
+pciesvc_hosted_shmem(void)
+{
+	return hosted.shmem;
+}
+
+pciehw_mem_t *
+pciesvc_hosted_hwmem(void)
+{
+	return hosted.hwmem;
+}
+
+void *
+pciesvc_hosted_barmem(void)
+{
+	return hosted.win[WIN_BARMEM].mem;
+}
+
+hosted_stats_t *
+pciesvc_hosted_stats(void)
+{
+	return &hosted.stats;
+}
+
+void
+pciesvc_hosted_set_verbose(const int verbose)
+{
+	hosted.verbose = verbose;
+}
+
+/*
+ * Add a simple type 0 endpoint with a writable command register
+ * and header area, and a single cfg pmt entry the indirect
+ * handlers can account against.
+ */
+pciehwdevh_t
+pciesvc_hosted_dev_add(const int port, const char *name,
+		       const u_int16_t bdf,
+		       const u_int16_t vendor, const u_int16_t device)
+{
+	pciehw_shmem_t *pshmem = hosted.shmem;
+	pciehwdevh_t hwdevh = PSHMEM_DATA_FIELD(pshmem, allocdev);
+	pciehwdev_t *phwdev;
+	pciehw_spmt_t *spmt;
+	cfgspace_t cs;
+	int pmti;
+
+	phwdev = pciehwdev_get(hwdevh);
+	if (phwdev == NULL)
+		return 0;
+	pmti = pmt_alloc(1, PMTPRI_CFG);
+	if (pmti < 0)
+		return 0;
+	PSHMEM_ASGN_FIELD(pshmem, allocdev, hwdevh + 1);
+
+	snprintf(phwdev->name, sizeof(phwdev->name), "%s", name);
+	phwdev->port = port;
+	phwdev->pf = 1;
+	phwdev->bdf = bdf;
+	phwdev->pmtb = pmti;
+	phwdev->pmtc = 1;
+	phwdev->cfgloaded = 1;
+	pciehwdev_put(phwdev, DIRTY);
+
+	spmt = pciesvc_spmt_get(pmti);
+	spmt->owner = hwdevh;
+	spmt->loaded = 1;
+	spmt->next = PMT_INVALID;
+	pciesvc_spmt_put(spmt, DIRTY);
+
+	pciesvc_cfgspace_get(hwdevh, &cs);
+	cs.rst[PCI_VENDOR_ID + 0] = vendor & 0xff;
+	cs.rst[PCI_VENDOR_ID + 1] = vendor >> 8;
+	cs.rst[PCI_DEVICE_ID + 0] = device & 0xff;
+	cs.rst[PCI_DEVICE_ID + 1] = device >> 8;
+	cs.msk[PCI_COMMAND + 0] = 0xff;
+	cs.msk[PCI_COMMAND + 1] = 0x07;
+	memset(&cs.msk[PCI_CACHE_LINE_SIZE], 0xff, 2);
+	memset(&cs.msk[PCI_INTERRUPT_LINE], 0xff, 1);
+	memcpy(cs.cur, cs.rst, PCIEHW_CFGSZ);
+	pciesvc_cfgspace_put(&cs, DIRTY);
+
+	return hwdevh;
+}
+
+/*
+ * Add nvfs VFs under the PF pfh as a contiguous block of devices
+ * with contiguous intr and lif ranges, the way pciemgr lays out
+ * sriov VFs.  VFs get the PF ids and the same writable header
+ * as pciesvc_hosted_dev_add(), but no pmt entries.
+ * Returns the handle of the first VF.
+ */
+pciehwdevh_t
+pciesvc_hosted_vfs_add(const pciehwdevh_t pfh, const int nvfs,
+		       const u_int32_t intrb, const u_int32_t intrc,
+		       const u_int32_t lifb, const u_int32_t lifc)
+{
+	pciehw_shmem_t *pshmem = hosted.shmem;
+	const pciehwdevh_t childh = PSHMEM_DATA_FIELD(pshmem, allocdev);
+	pciehwdev_t *pfdev = pciehwdev_get(pfh);
+	pciehwdev_t *phwdev;
+	cfgspace_t pfcs, cs;
+	int i;
+
+	if (pfdev == NULL || nvfs <= 0 ||
+	    childh + nvfs > PSHMEM_NDEVS(pshmem))
+		return 0;
+	PSHMEM_ASGN_FIELD(pshmem, allocdev, childh + nvfs);
+	pfdev->childh = childh;
+	pfdev->totalvfs = nvfs;
+	pfdev->numvfs = nvfs;
+	pciehwdev_put(pfdev, DIRTY);
+
+	pciesvc_cfgspace_get(pfh, &pfcs);
+	for (i = 0; i < nvfs; i++) {
+		phwdev = pciehwdev_get(childh + i);
+		if (phwdev == NULL)
+			return 0;
+		snprintf(phwdev->name, sizeof(phwdev->name), "vf%d", i);
+		phwdev->port = pfdev->port;
+		phwdev->vf = 1;
+		phwdev->vfidx = i;
+		phwdev->bdf = pfdev->bdf + 1 + i;
+		phwdev->intrb = intrb + i * intrc;
+		phwdev->intrc = intrc;
+		phwdev->lifb = lifb + i * lifc;
+		phwdev->lifc = lifc;
+		phwdev->parenth = pfh;
+		pciehwdev_put(phwdev, DIRTY);
+
+		pciesvc_cfgspace_get(childh + i, &cs);
+		memcpy(cs.rst, pfcs.rst, PCI_HEADER_TYPE);
+		memcpy(cs.msk, pfcs.msk, PCIEHW_CFGSZ);
+		memcpy(cs.cur, cs.rst, PCIEHW_CFGSZ);
+		pciesvc_cfgspace_put(&cs, DIRTY);
+	}
+	pciesvc_cfgspace_put(&pfcs, CLEAN);
+	return childh;
+}
+
+int
+pciesvc_hosted_bar_add(pciehwdevh_t hwdevh, const int cfgidx,
+		       const u_int64_t addr, const u_int64_t size,
+		       const u_int8_t hnd)
+{
+	pciehwdev_t *phwdev = pciehwdev_get(hwdevh);
+	pciehwbar_t *phwbar;
+	pciehw_spmt_t *spmt;
+	pciehw_sprt_t *sprt;
+	int pmti, prti;
+
+	if (phwdev == NULL || cfgidx < 0 || cfgidx >= PCIEHW_NBAR ||
+	    size == 0 || (size & (size - 1)) || size > HOSTED_BARMEM_SIZE)
+		return -1;
+	pmti = pmt_alloc(1, PMTPRI_BAR);
+	prti = prt_alloc(1);
+	if (pmti < 0 || prti < 0)
+		return -1;
+
+	/* one indirect resource prt maps the whole bar to bar memory */
+	sprt = pciesvc_sprt_get(prti);
+	memset(&sprt->prt, 0, sizeof(sprt->prt));
+	sprt->prt.res.valid = 1;
+	sprt->prt.res.type = PRT_TYPE_RES;
+	sprt->prt.res.indirect = 1;
+	sprt->prt.res.addrdw = HOSTED_BARMEM_PA >> 2;
+	sprt->next = PRT_INVALID;
+	pciesvc_sprt_put(sprt, DIRTY);
+
+	spmt = pciesvc_spmt_get(pmti);
+	spmt->owner = hwdevh;
+	spmt->cfgidx = cfgidx;
+	spmt->baroff = 0;
+	spmt->next = PMT_INVALID;
+	spmt->pmt.pmre.bar.valid = 1;
+	spmt->pmt.pmre.bar.indirect = 1;
+	spmt->pmt.pmre.bar.prtb = prti;
+	spmt->pmt.pmre.bar.prtc = 1;
+	spmt->pmt.pmre.bar.prtsize = __builtin_ctzll(size);
+	pciesvc_spmt_put(spmt, DIRTY);
+
+	phwbar = &phwdev->bar[cfgidx];
+	phwbar->valid = 1;
+	phwbar->type = PCIEHWBARTYPE_MEM64;
+	phwbar->cfgidx = cfgidx;
+	phwbar->hnd = hnd;
+	phwbar->size = size;
+	phwbar->addr = addr;
+	phwbar->pmtb = pmti;
+	phwbar->pmtc = 1;
+	pciehw_bar_load(phwdev, phwbar);
+	pciehwdev_put(phwdev, DIRTY);
+	return pmti;
+}
+
+u_int64_t
+pciesvc_hosted_cfgpa(const pciehwdevh_t hwdevh, const u_int16_t reg)
+{
+	return pciesvc_cfgcur_pa() + ((u_int64_t)hwdevh << PCIEHW_CFGSHIFT) + reg;
+}
+
+/*
+ * Log ring consumer, what pciemgr would do on the far side of the
+ * cmd interface: read one record, fetch its format string and
+ * format it.  Each conversion spec is rebuilt with an "ll" length
+ * so the 64-bit record args can be passed straight to snprintf.
+ */
+static int
+hosted_cmd(const pciesvc_cmd_t *cmd, pciesvc_cmdres_t *res)
+{
+	if (pciesvc_cmd_write((const char *)cmd, 0, sizeof(*cmd)) < 0 ||
+	    pciesvc_cmd_read((char *)res, 0, sizeof(*res)) < 0)
+		return -1;
+	return res->nop.status ? -1 : 0;
+}
+
+static int
+hosted_logfmt_get(const u_int32_t fmtid, char *fmt, const size_t n)
+{
+	pciesvc_cmdres_t res;
+	pciesvc_cmd_t cmd;
+	size_t off = 0;
+
+	do {
+		memset(&cmd, 0, sizeof(cmd));
+		cmd.log_fmt.cmd = PCIESVC_CMD_LOG_FMT;
+		cmd.log_fmt.fmtid = fmtid;
+		cmd.log_fmt.off = off;
+		if (hosted_cmd(&cmd, &res) < 0)
+			return -1;
+		snprintf(fmt + off, n - off, "%s", res.log_fmt.fmt);
+		off += strlen(res.log_fmt.fmt);
+	} while (off < res.log_fmt.len && off < n - 1);
+	return 0;
+}
+
+static void
+hosted_logrec_format(const pciesvc_logrec_t *rec, const char *fmt,
+		     char *buf, const size_t n)
+{
+	char spec[16];
+	size_t o = 0;
+	int a = 0, k;
+
+	while (*fmt && o < n - 1) {
+		if (*fmt != '%' || fmt[1] == '%') {
+			buf[o++] = *fmt;
+			fmt += *fmt == '%' ? 2 : 1;
+			continue;
+		}
+		for (k = 0; k < sizeof(spec) - 3 &&
+		     strchr("%-+ #0123456789.", *fmt); k++)
+			spec[k] = *fmt++;
+		while (*fmt == 'l' || *fmt == 'z' || *fmt == 'h')
+			fmt++;
+		if (*fmt == 's') {
+			spec[k++] = 's';
+			spec[k] = '\0';
+			o += snprintf(buf + o, n - o, spec, rec->str);
+		} else if (*fmt == 'p') {
+			spec[k++] = 'p';
+			spec[k] = '\0';
+			o += snprintf(buf + o, n - o, spec,
+				      (void *)(uintptr_t)rec->args[a++]);
+		} else {
+			spec[k++] = 'l';
+			spec[k++] = 'l';
+			spec[k++] = *fmt;
+			spec[k] = '\0';
+			o += snprintf(buf + o, n - o, spec,
+				      (unsigned long long)rec->args[a++]);
+		}
+		if (*fmt)
+			fmt++;
+		if (o > n - 1)
+			o = n - 1;
+	}
+	buf[o] = '\0';
+}
+
+int
+pciesvc_hosted_log_read(char *buf, const size_t n)
+{
+	pciesvc_cmdres_t res;
+	pciesvc_cmd_t cmd;
+	char fmt[256];
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.log_read.cmd = PCIESVC_CMD_LOG_READ;
+	if (hosted_cmd(&cmd, &res) < 0)
+		return -1;
+	if (!res.log_read.valid)
+		return 0;
+	if (hosted_logfmt_get(res.log_read.rec.fmtid, fmt, sizeof(fmt)) < 0)
+		return -1;
+	hosted_logrec_format(&res.log_read.rec, fmt, buf, n);
+	return 1;
+}
+
+/*
+ * Fill in the aux info the hardware would have delivered with
+ * this tlp.  Cfg transactions target the cfgcur copy of config
+ * space, bar transactions target bar memory at the bar offset.
+ */
+int
+pciesvc_hosted_tlpinfo(const pcie_stlp_t *stlp,
+		       const pciehwdevh_t hwdevh,
+		       tlpauxinfo_t *info)
+{
+	pciehwdev_t *phwdev = pciehwdev_get(hwdevh);
+	const pciehwbar_t *phwbar = NULL;
+	int i;
+
+	if (phwdev == NULL)
+		return -1;
+
+	memset(info, 0, sizeof(*info));
+	info->direct_size = stlp->size;
+	info->is_indirect = 1;
+	info->pmt_hit = 1;
+	info->sop = 1;
+	info->eop = 1;
+
+	switch (stlp->type) {
+	case PCIE_STLP_CFGRD:
+	case PCIE_STLP_CFGWR:
+	case PCIE_STLP_CFGRD1:
+	case PCIE_STLP_CFGWR1:
+		info->pmti = phwdev->pmtb;
+		info->direct_addr = pciesvc_hosted_cfgpa(hwdevh, stlp->addr);
+		break;
+	case PCIE_STLP_MEMRD:
+	case PCIE_STLP_MEMWR:
+	case PCIE_STLP_MEMRD64:
+	case PCIE_STLP_MEMWR64:
+	case PCIE_STLP_IORD:
+	case PCIE_STLP_IOWR:
+		for (i = 0; i < PCIEHW_NBAR; i++) {
+			const pciehwbar_t *b = &phwdev->bar[i];
+
+			if (b->valid && stlp->addr >= b->addr &&
+			    stlp->addr < b->addr + b->size) {
+				phwbar = b;
+				break;
+			}
+		}
+		if (phwbar == NULL ||
+		    stlp->addr - phwbar->addr >= HOSTED_BARMEM_SIZE)
+			goto err_out;
+		info->pmti = phwbar->pmtb;
+		info->direct_addr = HOSTED_BARMEM_PA +
+			(stlp->addr - phwbar->addr);
+		break;
+	default:
+		goto err_out;
+	}
+	pciehwdev_put(phwdev, CLEAN);
+	return 0;
+
+ err_out:
+	pciehwdev_put(phwdev, CLEAN);
+	return -1;
+}
+
+/*****************************************************************
+ * transaction injection
+ */
+
+void
+pciesvc_hosted_set_ind_rsp_cb(hosted_ind_rsp_cb_t cb, void *arg)
+{
+	hosted.ind_rsp_cb = cb;
+	hosted.ind_rsp_arg = arg;
+}
+
+/*
+ * Load the tlp and aux info into the next free aximst entry
+ * in the reversed layout read_indirect_info() expects.
+ */
+int
+pciesvc_hosted_ind_post(const int port,
+			const void *rtlp, const size_t rtlpsz,
+			const tlpauxinfo_t *info)
+{
+	hosted_indq_t *q = &hosted.indq[port];
+	const u_int8_t *tlp = rtlp;
+	u_int8_t *sram;
+	int entry, i;
+
+	if (port < 0 || port >= PCIEHW_NPORTS ||
+	    rtlpsz > INDIRECT_TLPSZ || q->count >= HOSTED_IND_NENTRIES)
+		return -1;
+
+	entry = (q->head + q->count) % HOSTED_IND_NENTRIES;
+	sram = q->sram[entry];
+	memset(sram, 0, sizeof(q->sram[entry]));
+	for (i = 0; i < rtlpsz; i++)
+		sram[INDIRECT_TLPSZ - 1 - i] = tlp[i];
+	memcpy(&sram[INDIRECT_TLPSZ], info, sizeof(*info));
+
+	q->fifo[entry] = entry;
+	q->count++;
+	hosted.stats.ind_post++;
+	return entry;
+}
+
+int
+pciesvc_hosted_ind_pending(const int port)
+{
+	return hosted.indq[port].count;
+}
+
+/*
+ * Append an entry to the notify ring and advance pi.
+ * The ring holds ring_mask entries, one slot stays empty.
+ */
+int
+pciesvc_hosted_not_post(const int port,
+			const void *rtlp, const size_t rtlpsz,
+			const tlpauxinfo_t *info)
+{
+	const u_int32_t ring_mask = PSHMEM_DATA_FIELD(hosted.shmem,
+						      notify_ring_mask);
+	notify_entry_t *nentry;
+	u_int32_t pi;
+
+	if (port < 0 || port >= PCIEHW_NPORTS || rtlpsz > NOTIFY_TLPSZ)
+		return -1;
+	pi = (hosted.notify_pi[port] + 1) & ring_mask;
+	if (pi == (hosted.notify_ci[port] & ring_mask))
+		return -1;
+
+	nentry = pciesvc_notify_ring_get(port, pi);
+	memset(nentry, 0, sizeof(*nentry));
+	memcpy(nentry->rtlp, rtlp, rtlpsz);
+	nentry->info = *info;
+
+	hosted.notify_pi[port] = pi;
+	hosted.stats.not_post++;
+	return pi;
+}
+
+int
+pciesvc_hosted_not_pending(const int port)
+{
+	const u_int32_t ring_mask = PSHMEM_DATA_FIELD(hosted.shmem,
+						      notify_ring_mask);
+
+	return (hosted.notify_pi[port] - hosted.notify_ci[port]) & ring_mask;
+}
+
+u_int64_t
+pciesvc_hosted_nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u_int64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*****************************************************************
+ * Up calls from pciesvc
+ */
+
+u64
+pciesvc_vtop(const void *hwmemva)
+{
+	const hosted_window_t *w = &hosted.win[WIN_HWMEM];
+	const u_int8_t *va = hwmemva;
+
+	if (va >= w->mem && va < w->mem + w->size)
+		return w->base + (va - w->mem);
+	return 0;
+}
+
+void *
+pciesvc_hwmem_get(void)
+{
+	return hosted.hwmem;
+}
+
+void *
+pciesvc_shmem_get(void)
+{
+	return hosted.shmem;
+}
+
+uint32_t
+pciesvc_reg_rd32(const uint64_t pa)
+{
+	hosted_window_t *w = hosted_window(pa, 4);
+	u_int32_t val = 0;
+
+	pciesvc_assert((pa & 0x3) == 0);
+	hosted.stats.reg_rd++;
+	if (w == NULL) {
+		hosted.stats.reg_bad++;
+		return 0;
+	}
+	if (w == &hosted.win[WIN_PXB] && pxb_rd(pa - w->base, &val))
+		return val;
+	memcpy(&val, w->mem + (pa - w->base), 4);
+	return val;
+}
+
+void
+pciesvc_pciepreg_rd32(const uint64_t pa, uint32_t *dest)
+{
+	*dest = pciesvc_reg_rd32(pa);
+}
+
+void
+pciesvc_reg_wr32(const uint64_t pa, const uint32_t val)
+{
+	hosted_window_t *w = hosted_window(pa, 4);
+
+	pciesvc_assert((pa & 0x3) == 0);
+	hosted.stats.reg_wr++;
+	if (w == NULL) {
+		hosted.stats.reg_bad++;
+		return;
+	}
+	if (w == &hosted.win[WIN_PXB] && pxb_wr(pa - w->base, val))
+		return;
+	memcpy(w->mem + (pa - w->base), &val, 4);
+}
+
+/*
+ * Table writes land in the window with a single lookup.  Words that
+ * hit a modeled pxb register still go through pxb_wr() so the
+ * indirect and notify models see them.
+ */
+void
+pciesvc_reg_wr32_table(const uint64_t pa, const uint32_t stride,
+		       const uint32_t *w, const uint32_t nw, const uint32_t n)
+{
+	hosted_window_t *win;
+	u_int64_t off;
+	u_int32_t i, j;
+
+	if (n == 0)
+		return;
+	pciesvc_assert((pa & 0x3) == 0 && (stride & 0x3) == 0);
+	hosted.stats.reg_wr += n * nw;
+	hosted.stats.reg_wr_table++;
+	win = hosted_window(pa, (n - 1) * stride + nw * 4);
+	if (win == NULL) {
+		hosted.stats.reg_bad += n * nw;
+		return;
+	}
+	off = pa - win->base;
+	for (i = 0; i < n; i++, off += stride, w += nw) {
+		if (win != &hosted.win[WIN_PXB]) {
+			memcpy(win->mem + off, w, nw * 4);
+			continue;
+		}
+		for (j = 0; j < nw; j++) {
+			if (!pxb_wr(off + j * 4, w[j]))
+				memcpy(win->mem + off + j * 4, &w[j], 4);
+		}
+	}
+}
+
+int
+pciesvc_mem_rd(const uint64_t pa, void *buf, const size_t sz)
+{
+	hosted_window_t *w = hosted_window(pa, sz);
+
+	if (sz != 1 && sz != 2 && sz != 4 && sz != 8)
+		return -1;
+	if (w == NULL || w == &hosted.win[WIN_PXB]) {
+		/* registers go through the 32-bit path */
+		u_int32_t v;
+
+		if (sz >= 4) {
+			pciesvc_reg_rd32w(pa, buf, sz >> 2);
+			return 0;
+		}
+		v = pciesvc_reg_rd32(pa & ~0x3);
+		memcpy(buf, (u_int8_t *)&v + (pa & 0x3), sz);
+		return 0;
+	}
+	memcpy(buf, w->mem + (pa - w->base), sz);
+	return 0;
+}
+
+void
+pciesvc_mem_wr(const uint64_t pa, const void *buf, const size_t sz)
+{
+	hosted_window_t *w = hosted_window(pa, sz);
+
+	if (sz != 1 && sz != 2 && sz != 4 && sz != 8)
+		return;
+	if (w == NULL || w == &hosted.win[WIN_PXB]) {
+		u_int32_t v;
+
+		if (sz >= 4) {
+			pciesvc_reg_wr32w(pa, buf, sz >> 2);
+			return;
+		}
+		v = pciesvc_reg_rd32(pa & ~0x3);
+		memcpy((u_int8_t *)&v + (pa & 0x3), buf, sz);
+		pciesvc_reg_wr32(pa & ~0x3, v);
+		return;
+	}
+	memcpy(w->mem + (pa - w->base), buf, sz);
+}
+
+void
+pciesvc_mem_barrier(void)
+{
+	__sync_synchronize();
+}
+
+void *
+pciesvc_memset(void *s, int c, size_t n)
+{
+	return memset(s, c, n);
+}
+
+void *
+pciesvc_memcpy(void *dst, const void *src, size_t n)
+{
+	return memcpy(dst, src, n);
+}
+
+void *
+pciesvc_memcpy_toio(void *dsthw, const void *src, size_t n)
+{
+	return memcpy(dsthw, src, n);
+}
+
+void
+pciesvc_log(const char *msg)
+{
+	hosted.stats.logs++;
+	if (!hosted.verbose)
+		return;
+	/* strip the kernel log level, if any */
+	if (msg[0] == KERN_SOH[0] && msg[1] != '\0')
+		msg += 2;
+	fputs(msg, stderr);
+}
+
+u64
+pciesvc_nsecs(void)
+{
+	return pciesvc_hosted_nsecs();
+}
+
+int
+pciesvc_event_handler(pciesvc_eventdata_t *evdata, const size_t evsize)
+{
+	if (evsize != sizeof(pciesvc_eventdata_t))
+		return -1;
+	hosted.stats.events++;
+	return 0;
+}
+
+int
+virtual(void)
+{
+	return 1;
+}
+
+void
+pciesvc_debug_cmd(uint32_t *cmd)
+{
+	switch (*cmd) {
+	case 0x17:
+		*cmd = virtual();
+		return;
+	default:
+		if (*cmd)
+			usleep(*cmd);
+		break;
+	}
+}
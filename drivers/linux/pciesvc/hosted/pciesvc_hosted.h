@@ -0,0 +1,125 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2023, Oracle and/or its affiliates.
+ */
+
+/*
+ * Hosted (userspace) simulation backend for pciesvc
+ *
+ * Provides the pciesvc upcalls on top of a simple in-memory
+ * model of the pxb register space, hwmem and shmem so the
+ * pciesvc library can be built and exercised on a development
+ * host without a Pensando ARM cpu or the kpcimgr driver.
+ */
+
+#ifndef __PCIESVC_HOSTED_H__
+#define __PCIESVC_HOSTED_H__
+
+#include "pciesvc_impl.h"
+#include "pcieshmem.h"
+#include "pciehwmem.h"
+#include "pcietlp.h"
+#include "indirect_entry.h"
+
+/*
+ * Simulated physical address map.  The register windows use the
+ * real asic addresses so the pciesvc register macros work unchanged,
+ * hwmem and bar memory are placed in otherwise unused ranges.
+ */
+#define HOSTED_PXB_PA		ELB_ADDR_BASE_PXB_PXB_OFFSET
+#define HOSTED_PXB_SIZE		0x100000
+#define HOSTED_PXC_PA		ELB_ADDR_BASE_PP_PXC_0_OFFSET
+#define HOSTED_PXC_SIZE		(PCIEHW_NPORTS * ELB_ADDR_BASE_PP_PXC_0_SIZE)
+#define HOSTED_INTR_PA		ELB_ADDR_BASE_INTR_INTR_OFFSET
+#define HOSTED_INTR_SIZE	0x100000
+#define HOSTED_HWMEM_PA		0xc0000000ULL
+#define HOSTED_BARMEM_PA	0x100000000ULL
+#define HOSTED_BARMEM_SIZE	(16 * 1024 * 1024)
+
+/* indirect srams hold this many outstanding transactions per port */
+#define HOSTED_IND_NENTRIES	16
+
+/* completion delivered by pciehw_indirect_complete() */
+typedef struct hosted_ind_rsp_s {
+	u_int32_t data[4];
+	u_int32_t cpl;
+	u_int32_t port;
+	u_int32_t axi_id;
+} hosted_ind_rsp_t;
+
+typedef void (*hosted_ind_rsp_cb_t)(const hosted_ind_rsp_t *rsp, void *arg);
+
+/* counters maintained by the simulation, not by pciesvc */
+typedef struct hosted_stats_s {
+	u_int64_t reg_rd;		/* register reads */
+	u_int64_t reg_wr;		/* register writes */
+	u_int64_t reg_bad;		/* accesses outside any window */
+	u_int64_t reg_wr_table;		/* pciesvc_reg_wr32_table() calls */
+	u_int64_t ind_post;		/* indirect entries posted */
+	u_int64_t ind_rsp;		/* indirect responses delivered */
+	u_int64_t not_post;		/* notify entries posted */
+	u_int64_t events;		/* pciesvc_event_handler() calls */
+	u_int64_t logs;			/* pciesvc_log() calls */
+} hosted_stats_t;
+
+int pciesvc_hosted_init(const int hi_ndev);
+void pciesvc_hosted_fini(void);
+
+pciehw_shmem_t *pciesvc_hosted_shmem(void);
+pciehw_mem_t *pciesvc_hosted_hwmem(void);
+void *pciesvc_hosted_barmem(void);
+hosted_stats_t *pciesvc_hosted_stats(void);
+void pciesvc_hosted_set_verbose(const int verbose);
+
+/* simple device/table setup normally done by userspace pciemgr */
+pciehwdevh_t pciesvc_hosted_dev_add(const int port, const char *name,
+				    const u_int16_t bdf,
+				    const u_int16_t vendor,
+				    const u_int16_t device);
+int pciesvc_hosted_bar_add(pciehwdevh_t hwdevh, const int cfgidx,
+			   const u_int64_t addr, const u_int64_t size,
+			   const u_int8_t hnd);
+pciehwdevh_t pciesvc_hosted_vfs_add(const pciehwdevh_t pfh, const int nvfs,
+				    const u_int32_t intrb,
+				    const u_int32_t intrc,
+				    const u_int32_t lifb,
+				    const u_int32_t lifc);
+u_int64_t pciesvc_hosted_cfgpa(const pciehwdevh_t hwdevh, const u_int16_t reg);
+
+/* pmt allocator, no prototype in the library headers */
+int pmt_alloc(const int n, const int pri);
+void pmt_free(const int pmtb, const int pmtc);
+
+/* prt allocator/loaders, src/prt.h is shadowed by include/prt.h */
+int prt_alloc(const int n);
+int pciehw_prt_load(const int prtbase, const int prtcount);
+void pciehw_prt_unload(const int prtbase, const int prtcount);
+
+/* transaction injection */
+void pciesvc_hosted_set_ind_rsp_cb(hosted_ind_rsp_cb_t cb, void *arg);
+int pciesvc_hosted_ind_post(const int port,
+			    const void *rtlp, const size_t rtlpsz,
+			    const tlpauxinfo_t *info);
+int pciesvc_hosted_ind_pending(const int port);
+int pciesvc_hosted_not_post(const int port,
+			    const void *rtlp, const size_t rtlpsz,
+			    const tlpauxinfo_t *info);
+int pciesvc_hosted_not_pending(const int port);
+
+/* build the hw aux info for a tlp targeting hwdevh */
+int pciesvc_hosted_tlpinfo(const pcie_stlp_t *stlp,
+			   const pciehwdevh_t hwdevh,
+			   tlpauxinfo_t *info);
+
+/* read and format the next log ring record, 0 if the ring is empty */
+int pciesvc_hosted_log_read(char *buf, const size_t n);
+
+/* monotonic time for measurements */
+u_int64_t pciesvc_hosted_nsecs(void);
+
+/* the switch based decoder pcietlp_decode() replaced, pcietlp_ref.c */
+int pcietlp_ref_decode(pcie_stlp_t *stlp, const void *rtlp,
+		       const size_t rtlpsz);
+char *pcietlp_ref_get_error(void);
+
+#endif /* __PCIESVC_HOSTED_H__ */
@@ -0,0 +1,607 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2023, Oracle and/or its affiliates.
+ */
+
+/*
+ * pciesvc_sim - drive a few transactions through the hosted
+ * pciesvc build and check the completions.
+ *
+ * usage: pciesvc_sim [-v]
+ */
+
+#include "pciesvc_hosted.h"
+#include "serial_state.h"
+#include "reset.h"
+#include "hdrt.h"
+#include "log.h"
+#include "virtio.h"
+
+#define SIM_PORT	0
+#define SIM_BDF		0x0100
+#define SIM_VENDOR	0x1dd8
+#define SIM_DEVICE	0x1002
+#define SIM_BARADDR	0xe0000000ULL
+#define SIM_BARSIZE	0x10000
+#define SIM_SERADDR	0xe1000000ULL
+#define SIM_NVFS	4
+#define SIM_VIOADDR	0xe2000000ULL
+#define SIM_VFBDF	0x0200
+
+static hosted_ind_rsp_t last_rsp;
+static int nrsp;
+
+static void
+sim_rsp_cb(const hosted_ind_rsp_t *rsp, void *arg)
+{
+	last_rsp = *rsp;
+	nrsp++;
+}
+
+static int
+sim_indirect(pciehwdevh_t hwdevh, const pcie_stlp_t *stlp, u_int32_t *data)
+{
+	u_int8_t rtlp[INDIRECT_TLPSZ];
+	tlpauxinfo_t info;
+	int n = nrsp;
+
+	if (pcietlp_encode(stlp, rtlp, sizeof(rtlp)) < 0 ||
+	    pciesvc_hosted_tlpinfo(stlp, hwdevh, &info) < 0 ||
+	    pciesvc_hosted_ind_post(SIM_PORT, rtlp, sizeof(rtlp), &info) < 0)
+		return -1;
+	while (pciesvc_poll(SIM_PORT) > 0)
+		;
+	if (nrsp != n + 1 || last_rsp.cpl != PCIECPL_SC)
+		return -1;
+	if (data)
+		*data = last_rsp.data[0];
+	return 0;
+}
+
+static int
+sim_notify(pciehwdevh_t hwdevh, const pcie_stlp_t *stlp)
+{
+	u_int8_t rtlp[NOTIFY_TLPSZ];
+	tlpauxinfo_t info;
+
+	if (pcietlp_encode(stlp, rtlp, sizeof(rtlp)) < 0 ||
+	    pciesvc_hosted_tlpinfo(stlp, hwdevh, &info) < 0)
+		return -1;
+	info.is_indirect = 0;
+	info.is_notify = 1;
+	if (pciesvc_hosted_not_post(SIM_PORT, rtlp, sizeof(rtlp), &info) < 0)
+		return -1;
+	while (pciesvc_poll(SIM_PORT) > 0)
+		;
+	return pciesvc_hosted_not_pending(SIM_PORT) ? -1 : 0;
+}
+
+/*
+ * Free a multi-entry range in the middle of the high priority
+ * region and check it gets reused, then clear the stats, free
+ * everything we took and check the region shrinks back and the
+ * gauges come back right.
+ */
+static int
+sim_pmt_reuse(void)
+{
+	pciemgr_stats_t *s = &pciesvc_port_get(0)->stats;
+	pciehw_shmem_t *pshmem = pciesvc_shmem_get();
+	const u_int32_t high = PSHMEM_DATA_FIELD(pshmem, allocpmt_high);
+	const u_int64_t reuse = s->pmt_reuse;
+	const u_int64_t inuse = s->pmt_inuse;
+	int a, b, c, d;
+
+	a = pmt_alloc(4, PMTPRI_HIGH);
+	b = pmt_alloc(8, PMTPRI_HIGH);
+	c = pmt_alloc(1, PMTPRI_HIGH);
+	if (a < 0 || b != a + 4 || c != b + 8)
+		return -1;
+	pmt_free(b, 8);
+	d = pmt_alloc(6, PMTPRI_HIGH);
+	if (d != b || s->pmt_reuse != reuse + 1 || s->pmt_freelist != 2 ||
+	    s->pmt_inuse != inuse + 11)
+		return -1;
+	s->pmt_freelist = s->pmt_inuse = 0;	/* as if the stats were cleared */
+	pmt_free(a, 4);
+	pmt_free(c, 1);
+	pmt_free(d, 6);
+	if (PSHMEM_DATA_FIELD(pshmem, allocpmt_high) != high ||
+	    s->pmt_freelist != 0 || s->pmt_inuse != inuse)
+		return -1;
+	return 0;
+}
+
+/*
+ * Bulk console output: one 8 byte write to SERIAL_BULK_TX and one
+ * THR write should land, in order, on the bulk tx queue.
+ */
+static int
+sim_serial_bulk(void)
+{
+	pciemgr_stats_t *s = &pciesvc_port_get(SIM_PORT)->stats;
+	pciehw_shmem_t *pshmem = pciesvc_shmem_get();
+	serial_uart_state_t *su =
+		(serial_uart_state_t *)PSHMEM_DATA_FIELD(pshmem, serial[0]);
+	serial_state_t *st = &su->serial_state;
+	pciehwdevh_t hwdevh;
+	pcie_stlp_t stlp;
+	u_int32_t v;
+
+	if (sizeof(*st) > sizeof(su->_pad1))
+		return -1;
+	hwdevh = pciesvc_hosted_dev_add(SIM_PORT, "sim1", SIM_BDF + 1,
+					SIM_VENDOR, SIM_DEVICE);
+	if (hwdevh == 0 ||
+	    pciesvc_hosted_bar_add(hwdevh, 0, SIM_SERADDR, 0x1000,
+				   PCIEHW_BARHND_SERIAL) < 0)
+		return -1;
+	st->bulk_en = 1;
+
+	memset(&stlp, 0, sizeof(stlp));
+	stlp.type = PCIE_STLP_MEMWR64;
+	stlp.addr = SIM_SERADDR + SERIAL_BULK_TX;
+	stlp.size = 8;
+	memcpy(&stlp.data, "bulk tx ", 8);
+	if (sim_indirect(hwdevh, &stlp, NULL) < 0)
+		return -1;
+	stlp.addr = SIM_SERADDR + UART_TX_BUF;
+	stlp.size = 1;
+	stlp.data = '!';
+	if (sim_indirect(hwdevh, &stlp, NULL) < 0)
+		return -1;
+
+	stlp.type = PCIE_STLP_MEMRD64;
+	stlp.addr = SIM_SERADDR + SERIAL_BULK_STATUS;
+	stlp.size = 4;
+	if (sim_indirect(hwdevh, &stlp, &v) < 0)
+		return -1;
+
+	if (st->bulktxq.pidx != 9 ||
+	    memcmp(st->bulktxq.buf, "bulk tx !", 9) != 0 ||
+	    v != (SERIAL_BULK_STATUS_EN | (BULKQ_BUFSZ - 1 - 9)) ||
+	    s->serial_tlps != 3 || s->serial_txbytes != 9)
+		return -1;
+	return 0;
+}
+
+/*
+ * Disable a block of VFs: every VF cmd register should be back at
+ * its reset value after one pciehw_reset_vfs(), with a single reset
+ * event covering all the VF lifs.
+ */
+static int
+sim_vf_reset(void)
+{
+	const u_int64_t events = pciesvc_hosted_stats()->events;
+	pciehwdevh_t pfh, vfh;
+	pciehwdev_t *pfdev;
+	cfgspace_t cs;
+	int i;
+
+	pfh = pciesvc_hosted_dev_add(SIM_PORT, "sim2", SIM_BDF + 2,
+				     SIM_VENDOR, SIM_DEVICE);
+	if (pfh == 0)
+		return -1;
+	vfh = pciesvc_hosted_vfs_add(pfh, SIM_NVFS, 0, 2, 0, 1);
+	if (vfh == 0)
+		return -1;
+	for (i = 0; i < SIM_NVFS; i++) {
+		pciesvc_cfgspace_get(vfh + i, &cs);
+		cfgspace_writew(&cs, PCI_COMMAND, PCI_COMMAND_MASTER);
+		pciesvc_cfgspace_put(&cs, DIRTY);
+	}
+
+	pfdev = pciehwdev_get(pfh);
+	pciehw_reset_vfs(pfdev, 0, SIM_NVFS);
+	pciehwdev_put(pfdev, CLEAN);
+
+	for (i = 0; i < SIM_NVFS; i++) {
+		pciesvc_cfgspace_get(vfh + i, &cs);
+		if (cfgspace_readw(&cs, PCI_COMMAND) != 0 ||
+		    memcmp(cs.cur, cs.rst, PCIEHW_CFGSZ) != 0)
+			return -1;
+		pciesvc_cfgspace_put(&cs, CLEAN);
+	}
+	/* the "vfs reset" log msg and the reset event */
+	return pciesvc_hosted_stats()->events == events + 2 ? 0 : -1;
+}
+
+/*
+ * Range table writes: a hdrt load spanning more than one staging
+ * buffer should program exactly the lifs asked for, and a prt load
+ * should copy the shadow entries out unchanged.
+ */
+static int
+sim_table_range(void)
+{
+	const u_int64_t hdrt = PXB_(DHS_ITR_PCIHDRT);
+	const u_int64_t prt = PXB_(DHS_TGT_PRT);
+	const int lifb = 5, lifc = 40, prtb = 4000, prtc = 40;
+	pciehw_sprt_t *sprt;
+	u_int32_t w0;
+	int i;
+
+	pciehw_hdrt_load(lifb, lifc, 0x1234);
+	for (i = lifb - 1; i <= lifb + lifc; i++) {
+		w0 = pciesvc_reg_rd32(hdrt + i * 16);
+		if (w0 != (i < lifb || i == lifb + lifc ? 0 : 1 | 0x1234 << 1))
+			return -1;
+	}
+	pciehw_hdrt_unload(lifb, lifc);
+	for (i = lifb; i < lifb + lifc; i++) {
+		if (pciesvc_reg_rd32(hdrt + i * 16) != 0)
+			return -1;
+	}
+
+	for (i = prtb; i < prtb + prtc; i++) {
+		sprt = pciesvc_sprt_get(i);
+		sprt->prt.w[0] = i;
+		sprt->prt.w[2] = ~i;
+		pciesvc_sprt_put(sprt, DIRTY);
+	}
+	pciehw_prt_load(prtb, prtc);
+	for (i = prtb; i < prtb + prtc; i++) {
+		if (pciesvc_reg_rd32(prt + i * 16) != i ||
+		    pciesvc_reg_rd32(prt + i * 16 + 8) != ~i)
+			return -1;
+	}
+	pciehw_prt_unload(prtb, prtc);
+	return pciesvc_reg_rd32(prt + prtb * 16) == 0 ? 0 : -1;
+}
+
+static int
+sim_logring_set(const int enable)
+{
+	pciesvc_cmd_t cmd;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.set_log_ring.cmd = PCIESVC_CMD_SET_LOG_RING;
+	cmd.set_log_ring.enable = enable;
+	return pciesvc_cmd_write((char *)&cmd, 0, sizeof(cmd)) < 0 ? -1 : 0;
+}
+
+/*
+ * Binary log ring: messages should come back out of the ring
+ * formatted exactly as vsnprintf would have, without posting a
+ * log event, while a message the ring can't carry still goes
+ * out as an event.
+ */
+static int
+sim_log_ring(void)
+{
+	const u_int64_t events = pciesvc_hosted_stats()->events;
+	pciesvc_log_stats_t ls;
+	char buf[128];
+	u_int32_t nfmts;
+	int r = -1;
+
+	if (sim_logring_set(1) < 0)
+		return -1;
+	pciesvc_logring_stats(&ls);
+	nfmts = ls.nfmts;
+	pciesvc_loginfo("%s: lif %d-%d reset\n", "sim2", 5, 44);
+	pciesvc_logwarn("pa 0x%08llx sz %u 100%%\n", 0x1234abcdULL, 4);
+	pciesvc_logerror("%*d\n", 4, 7);
+	if (pciesvc_hosted_stats()->events != events + 1)
+		goto out;
+
+	if (pciesvc_hosted_log_read(buf, sizeof(buf)) != 1 ||
+	    strcmp(buf, "sim2: lif 5-44 reset\n") != 0)
+		goto out;
+	if (pciesvc_hosted_log_read(buf, sizeof(buf)) != 1 ||
+	    strcmp(buf, "pa 0x1234abcd sz 4 100%\n") != 0)
+		goto out;
+	if (pciesvc_hosted_log_read(buf, sizeof(buf)) != 0)
+		goto out;
+
+	pciesvc_logring_stats(&ls);
+	/* the eager message must not have used up a format id */
+	if (ls.posted == 2 && ls.eager == 1 && ls.drops == 0 && ls.queued == 0 &&
+	    ls.nfmts <= nfmts + 2)
+		r = 0;
+out:
+	sim_logring_set(0);
+	return r;
+}
+
+/*
+ * Bar access profile: bar reads and writes on hwdevh should be
+ * counted per (offset, size, direction) and read back through
+ * the cmd interface.
+ */
+static int
+sim_bar_prof(const pciehwdevh_t hwdevh)
+{
+	pciesvc_barprof_ent_t *e;
+	pciesvc_cmdres_t res;
+	pciesvc_cmd_t cmd;
+	pcie_stlp_t stlp;
+	int i, found = 0;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.set_bar_prof.cmd = PCIESVC_CMD_SET_BAR_PROF;
+	cmd.set_bar_prof.enable = 1;
+	cmd.set_bar_prof.hwdevh = hwdevh;
+	cmd.set_bar_prof.clear = 1;
+	if (pciesvc_cmd_write((char *)&cmd, 0, sizeof(cmd)) < 0)
+		return -1;
+
+	memset(&stlp, 0, sizeof(stlp));
+	stlp.type = PCIE_STLP_MEMWR64;
+	stlp.bdf = SIM_BDF;
+	stlp.addr = SIM_BARADDR + 0x40;
+	stlp.size = 4;
+	if (sim_indirect(hwdevh, &stlp, NULL) < 0)
+		return -1;
+	stlp.type = PCIE_STLP_MEMRD64;
+	for (i = 0; i < 3; i++) {
+		if (sim_indirect(hwdevh, &stlp, NULL) < 0)
+			return -1;
+	}
+	stlp.addr = SIM_BARADDR + 0x44;
+	if (sim_indirect(hwdevh, &stlp, NULL) < 0)
+		return -1;
+
+	cmd.set_bar_prof.enable = 0;
+	cmd.set_bar_prof.clear = 0;
+	if (pciesvc_cmd_write((char *)&cmd, 0, sizeof(cmd)) < 0 ||
+	    pciesvc_cmd_read((char *)&res, 0, sizeof(res)) < 0 ||
+	    res.set_bar_prof.nents != 3 || res.set_bar_prof.full != 0)
+		return -1;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.bar_prof_read.cmd = PCIESVC_CMD_BAR_PROF_READ;
+	for (;;) {
+		if (pciesvc_cmd_write((char *)&cmd, 0, sizeof(cmd)) < 0 ||
+		    pciesvc_cmd_read((char *)&res, 0, sizeof(res)) < 0)
+			return -1;
+		if (!res.bar_prof_read.valid)
+			break;
+		e = &res.bar_prof_read.ent;
+		if (e->hwdevh != hwdevh || e->cfgidx != 0 || e->size != 4)
+			return -1;
+		if (e->baroff == 0x40 && e->wr && e->count == 1)
+			found |= 1;
+		else if (e->baroff == 0x40 && !e->wr && e->count == 3)
+			found |= 2;
+		else if (e->baroff == 0x44 && !e->wr && e->count == 1)
+			found |= 4;
+		else
+			return -1;
+		cmd.bar_prof_read.idx = res.bar_prof_read.next;
+	}
+	return found == 7 ? 0 : -1;
+}
+
+/*
+ * Virtio queue notify: a 2-byte legacy queue_notify write should
+ * take the fast path (latch the queue index and raise one notify
+ * event), anything else at that register the full virtio path.
+ */
+static int
+sim_vnotify(void)
+{
+	hosted_stats_t *hs = pciesvc_hosted_stats();
+	const u_int64_t baroff = virtio_notify_baroff();
+	u_int8_t *barmem = pciesvc_hosted_barmem();
+	pciemgr_stats_t *s = &pciesvc_port_get(SIM_PORT)->stats;
+	u_int64_t events, vnotify;
+	pciehwdevh_t hwdevh;
+	pcie_stlp_t stlp;
+	u_int16_t q;
+
+	hwdevh = pciesvc_hosted_dev_add(SIM_PORT, "sim3", SIM_BDF + 3,
+					SIM_VENDOR, SIM_DEVICE);
+	if (hwdevh == 0 ||
+	    pciesvc_hosted_bar_add(hwdevh, 0, SIM_VIOADDR, 0x1000,
+				   PCIEHW_BARHND_VIRTIO) < 0)
+		return -1;
+
+	memset(&stlp, 0, sizeof(stlp));
+	stlp.type = PCIE_STLP_MEMWR64;
+	stlp.bdf = SIM_BDF + 3;
+	stlp.addr = SIM_VIOADDR + baroff;
+	stlp.size = 2;
+	stlp.data = 3;
+	events = hs->events;
+	vnotify = s->vnotify_wr;
+	if (sim_indirect(hwdevh, &stlp, NULL) < 0)
+		return -1;
+	memcpy(&q, barmem + baroff, sizeof(q));
+	if (q != 3 || s->vnotify_wr != vnotify + 1 ||
+	    hs->events != events + 1)
+		return -1;
+
+	/* any queue index is latched by the fast path */
+	stlp.data = 0x1234;
+	if (sim_indirect(hwdevh, &stlp, NULL) < 0)
+		return -1;
+	memcpy(&q, barmem + baroff, sizeof(q));
+	if (q != 0x1234 || s->vnotify_wr != vnotify + 2)
+		return -1;
+
+	/* a 4-byte write at the register takes the full path */
+	stlp.size = 4;
+	stlp.data = 5;
+	if (sim_indirect(hwdevh, &stlp, NULL) < 0)
+		return -1;
+	memcpy(&q, barmem + baroff, sizeof(q));
+	return q == 5 && s->vnotify_wr == vnotify + 2 ? 0 : -1;
+}
+
+/*
+ * VF bars loaded and unloaded as a block: every bar goes through the
+ * common bar load path, so virtio VFs get their notify fast path,
+ * and the prt/pmr/tcam writes go out as one table write per run of
+ * adjacent entries rather than one per entry.
+ */
+static int
+sim_vf_bars_check(const pciehwdevh_t vfh, const int *pmti, const int loaded)
+{
+	pciehw_spmt_t *spmt;
+	pciehwdev_t *vfdev;
+	pmt_t pmt;
+	int i, r = 0;
+
+	for (i = 0; i < SIM_NVFS; i++) {
+		vfdev = pciehwdev_get(vfh + i);
+		spmt = pciesvc_spmt_get(pmti[i]);
+		pmt_get(pmti[i], &pmt);
+		if (vfdev->bar[0].loaded != loaded ||
+		    !vfdev->vnotify_pa != !loaded ||
+		    pmt.pmte.tcam.v != loaded ||
+		    (loaded && memcmp(&pmt, &spmt->pmt, sizeof(pmt)) != 0))
+			r = -1;
+		pciesvc_spmt_put(spmt, CLEAN);
+		pciehwdev_put(vfdev, CLEAN);
+	}
+	return r;
+}
+
+static int
+sim_vf_bars(void)
+{
+	hosted_stats_t *hs = pciesvc_hosted_stats();
+	pciehwdevh_t pfh, vfh;
+	pciehw_spmt_t *spmt;
+	pciehwdev_t *pfdev;
+	int pmti[SIM_NVFS];
+	u_int64_t tbl;
+	int i, r = 0;
+
+	pfh = pciesvc_hosted_dev_add(SIM_PORT, "sim4", SIM_VFBDF,
+				     SIM_VENDOR, SIM_DEVICE);
+	if (pfh == 0)
+		return -1;
+	vfh = pciesvc_hosted_vfs_add(pfh, SIM_NVFS, 0, 2, 0, 1);
+	if (vfh == 0)
+		return -1;
+	for (i = 0; i < SIM_NVFS; i++) {
+		pmti[i] = pciesvc_hosted_bar_add(vfh + i, 0,
+						 SIM_VIOADDR + (i + 1) * 0x1000,
+						 0x1000, PCIEHW_BARHND_VIRTIO);
+		if (pmti[i] < 0 || (i && pmti[i] != pmti[i - 1] + 1))
+			return -1;
+		/* a valid tcam image, so the check can tell it was written */
+		spmt = pciesvc_spmt_get(pmti[i]);
+		spmt->pmt.pmte.tcam.v = 1;
+		pciesvc_spmt_put(spmt, DIRTY);
+	}
+
+	pfdev = pciehwdev_get(pfh);
+	pciehw_vfs_unload_bars(pfdev, 0, SIM_NVFS);
+	if (sim_vf_bars_check(vfh, pmti, 0) < 0)
+		r = -1;
+
+	/* one table write each for the prts, the pmrs and the tcams */
+	tbl = hs->reg_wr_table;
+	pciehw_vfs_load_bars(pfdev, 0, SIM_NVFS);
+	if (hs->reg_wr_table != tbl + 3 ||
+	    sim_vf_bars_check(vfh, pmti, 1) < 0)
+		r = -1;
+	pciehwdev_put(pfdev, CLEAN);
+	return r;
+}
+
+#define CHECK(name, expr)						\
+	do {								\
+		if (!(expr)) {						\
+			printf("FAIL: %s\n", name);			\
+			fails++;					\
+		} else {						\
+			printf("ok:   %s\n", name);			\
+		}							\
+	} while (0)
+
+int
+main(int argc, char *argv[])
+{
+	pciesvc_params_t p;
+	pciemgr_stats_t *s;
+	pciehwdevh_t hwdevh;
+	pcie_stlp_t stlp;
+	u_int32_t v;
+	int fails = 0;
+
+	if (pciesvc_hosted_init(0) < 0) {
+		fprintf(stderr, "pciesvc_hosted_init failed\n");
+		return 1;
+	}
+	if (argc > 1 && strcmp(argv[1], "-v") == 0)
+		pciesvc_hosted_set_verbose(1);
+	pciesvc_hosted_set_ind_rsp_cb(sim_rsp_cb, NULL);
+
+	memset(&p, 0, sizeof(p));
+	p.version = 0;
+	p.params_v0.port = SIM_PORT;
+	p.params_v0.ind_poll = 1;
+	p.params_v0.not_poll = 1;
+	if (pciesvc_init(&p) < 0) {
+		fprintf(stderr, "pciesvc_init failed\n");
+		return 1;
+	}
+
+	hwdevh = pciesvc_hosted_dev_add(SIM_PORT, "sim0", SIM_BDF,
+					SIM_VENDOR, SIM_DEVICE);
+	pciesvc_hosted_bar_add(hwdevh, 0, SIM_BARADDR, SIM_BARSIZE,
+			       PCIEHW_BARHND_NONE);
+
+	memset(&stlp, 0, sizeof(stlp));
+	stlp.type = PCIE_STLP_CFGRD;
+	stlp.bdf = SIM_BDF;
+	stlp.addr = PCI_VENDOR_ID;
+	stlp.size = 4;
+	v = 0;
+	CHECK("indirect cfgrd ids",
+	      sim_indirect(hwdevh, &stlp, &v) == 0 &&
+	      v == (SIM_DEVICE << 16 | SIM_VENDOR));
+
+	stlp.type = PCIE_STLP_CFGWR;
+	stlp.addr = PCI_COMMAND;
+	stlp.size = 2;
+	stlp.data = PCI_COMMAND_MEMORY;
+	CHECK("indirect cfgwr cmd", sim_indirect(hwdevh, &stlp, NULL) == 0);
+
+	stlp.type = PCIE_STLP_CFGRD;
+	v = 0;
+	CHECK("indirect cfgrd cmd",
+	      sim_indirect(hwdevh, &stlp, &v) == 0 &&
+	      (v & 0xffff) == PCI_COMMAND_MEMORY);
+
+	stlp.type = PCIE_STLP_MEMWR64;
+	stlp.addr = SIM_BARADDR + 0x40;
+	stlp.size = 4;
+	stlp.data = 0x12345678;
+	CHECK("indirect memwr", sim_indirect(hwdevh, &stlp, NULL) == 0);
+
+	stlp.type = PCIE_STLP_MEMRD64;
+	v = 0;
+	CHECK("indirect memrd",
+	      sim_indirect(hwdevh, &stlp, &v) == 0 && v == 0x12345678);
+
+	stlp.type = PCIE_STLP_CFGRD;
+	stlp.addr = PCI_VENDOR_ID;
+	CHECK("notify cfgrd", sim_notify(hwdevh, &stlp) == 0);
+
+	CHECK("pmt multi-entry reuse", sim_pmt_reuse() == 0);
+
+	s = &pciesvc_port_get(SIM_PORT)->stats;
+	CHECK("port stats",
+	      s->ind_cfgrd == 2 && s->ind_cfgwr == 1 &&
+	      s->ind_memrd == 1 && s->ind_memwr == 1 && s->not_cfgrd == 1);
+	CHECK("cfgrd fast path", s->ind_cfgrd_fast == 1);
+	CHECK("serial bulk tx", sim_serial_bulk() == 0);
+	CHECK("vf range reset", sim_vf_reset() == 0);
+	CHECK("table range writes", sim_table_range() == 0);
+	CHECK("log ring", sim_log_ring() == 0);
+	CHECK("bar access profile", sim_bar_prof(hwdevh) == 0);
+	CHECK("virtio notify fast path", sim_vnotify() == 0);
+	CHECK("vf bar bulk load", sim_vf_bars() == 0);
+	CHECK("no stray register access",
+	      pciesvc_hosted_stats()->reg_bad == 0);
+
+	pciesvc_shut(SIM_PORT);
+	pciesvc_hosted_fini();
+	return fails ? 1 : 0;
+}
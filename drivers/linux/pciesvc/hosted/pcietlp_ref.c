@@ -0,0 +1,364 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2023, Oracle and/or its affiliates.
+ */
+
+/*
+ * pcietlp_ref - the switch based TLP decoder pcietlp_decode() was
+ * replaced by, kept here so tlpbench can check the table driven
+ * decoder against it and time the two side by side.  Apart from
+ * the renamed entry point and error helpers this is the decode
+ * half of the old pcietlp.c unchanged.
+ */
+
+#include "pciesvc_hosted.h"
+
+static struct {
+    unsigned int error:1;
+    char error_str[80];
+} ref_info;
+
+static int ref_set_error(const char *fmt, ...)
+    __attribute__((format (printf, 1, 2)));
+static int ref_set_error(const char *fmt, ...)
+{
+    if (ref_info.error == 0) {
+        va_list ap;
+
+        va_start(ap, fmt);
+        vsnprintf(ref_info.error_str, sizeof(ref_info.error_str), fmt, ap);
+        va_end(ap);
+        ref_info.error = 1;
+    }
+    return -1;
+}
+
+static void
+ref_clr_error(void)
+{
+    ref_info.error_str[0] = '\0';
+    ref_info.error = 0;
+}
+
+static int
+ref_is_error(void)
+{
+    return ref_info.error;
+}
+
+char *
+pcietlp_ref_get_error(void)
+{
+    return ref_info.error_str;
+}
+
+static u_int32_t
+stlp_dw(const pcie_stlp_t *stlp)
+{
+    const u_int64_t dw_start = stlp->addr >> 2;
+    const u_int64_t dw_end   = (stlp->addr + stlp->size + 3) >> 2;
+
+    return dw_end - dw_start;
+}
+
+static inline int
+bitcount(u_int32_t n)
+{
+    int count = 0;
+
+    while (n) {
+        count++;
+        n &= ~(-n); /* clear low order 1 bit */
+    }
+    return count;
+}
+
+static void
+decode_addr32(pcie_stlp_t *stlp, const u_int32_t addr)
+{
+    stlp->addr += pciesvc_be32toh(addr);
+}
+
+static void
+decode_addr64(pcie_stlp_t *stlp, const u_int32_t *addrp)
+{
+    stlp->addr += ((u_int64_t)pciesvc_be32toh(addrp[0]) << 32) |
+                              pciesvc_be32toh(addrp[1]);
+}
+
+static void
+decode_data32(pcie_stlp_t *stlp, const u_int32_t *datap)
+{
+    const u_int32_t v = pciesvc_le32toh(*datap);
+
+    stlp->data = v >> ((stlp->addr & 0x3) * 8);
+
+    /* mask off unused byte lanes */
+    if (stlp->size < 4) {
+        const u_int32_t datamask = (1 << stlp->size * 8) - 1;
+        stlp->data &= datamask;
+    }
+}
+
+static void
+decode_data64(pcie_stlp_t *stlp, const u_int32_t *datap)
+{
+    const u_int64_t v = (pciesvc_le32toh(datap[0]) |
+                         (u_int64_t)pciesvc_le32toh(datap[1]) << 32);
+
+    stlp->data = v >> ((stlp->addr & 0x3) * 8);
+
+    /* mask off unused byte lanes */
+    if (stlp->size < 8) {
+        const u_int64_t datamask = (1ULL << stlp->size * 8) - 1;
+        stlp->data &= datamask;
+    }
+}
+
+static void
+decode_data(pcie_stlp_t *stlp, const u_int32_t *datap)
+{
+    if (stlp_dw(stlp) <= 1) {
+        decode_data32(stlp, datap);
+    } else {
+        decode_data64(stlp, datap);
+    }
+}
+
+static void
+decode_cmn_hdr(pcie_stlp_t *stlp, const void *rtlp)
+{
+    const pcie_tlp_common_hdr_t *hdr = rtlp;
+    const u_int8_t be_dw = (hdr->fbe > 0) + (hdr->lbe > 0);
+    const u_int8_t be_bits = bitcount(hdr->fbe) + bitcount(hdr->lbe);
+    const u_int8_t ffbe = pciesvc_ffs(hdr->fbe);
+    u_int16_t ndw = (hdr->len_hi << 8) | hdr->len_lo;
+
+    /* ndw=0 indicates max 0x400 */
+    if (ndw == 0) ndw = 0x400;
+
+    /* Compute size.  Start with ndw, then adjust for the Byte Enable bits. */
+    if (ndw == 1 && !be_bits) {
+        stlp->size = 0;
+    } else {
+        stlp->size = ((ndw - be_dw) << 2) + be_bits;
+    }
+
+    /* addr start depends on first First Byte Enable bit position.*/
+    stlp->addr = ffbe ? ffbe - 1 : 0;
+
+    stlp->reqid = pciesvc_be16toh(hdr->reqid);
+    stlp->tag = (hdr->t9 << 9) | (hdr->t8 << 8) | hdr->tag;
+}
+
+static void
+decode_cfg_hdr(pcie_stlp_t *stlp, const void *rtlp)
+{
+    const pcie_tlp_cfg_t *cfg = rtlp;
+
+    decode_cmn_hdr(stlp, cfg);
+    stlp->bdf = pciesvc_be16toh(cfg->bdf);
+    stlp->addr += (cfg->extreg << 8) | cfg->reg;
+}
+
+static void
+decode_mem32_hdr(pcie_stlp_t *stlp, const void *rtlp)
+{
+    const pcie_tlp_mem32_t *mem = rtlp;
+
+    decode_cmn_hdr(stlp, mem);
+    decode_addr32(stlp, mem->addr);
+}
+
+static void
+decode_mem64_hdr(pcie_stlp_t *stlp, const void *rtlp)
+{
+    const pcie_tlp_mem64_t *mem = rtlp;
+
+    decode_cmn_hdr(stlp, mem);
+    decode_addr64(stlp, &mem->addr_hi);
+}
+
+static int
+decode_cfgrd(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
+{
+    const int tlpsz = 12;
+
+    if (rtlpsz < tlpsz) {
+        return ref_set_error("cfgrd: rtlpsz want %d got %ld",
+                                 tlpsz, rtlpsz);
+    }
+
+    decode_cfg_hdr(stlp, rtlp);
+    return tlpsz;
+}
+
+static int
+decode_cfgwr(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
+{
+    const int tlpsz = 16;
+
+    if (rtlpsz < tlpsz) {
+        return ref_set_error("cfgwr: rtlpsz want %d got %ld",
+                                 tlpsz, rtlpsz);
+    }
+
+    decode_cfg_hdr(stlp, rtlp);
+    decode_data32(stlp, rtlp + 12);
+    return tlpsz;
+}
+
+static int
+decode_memrd(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
+{
+    const int tlpsz = 12;
+
+    if (rtlpsz < tlpsz) {
+        return ref_set_error("memrd: rtlpsz want %d got %ld",
+                                 tlpsz, rtlpsz);
+    }
+
+    decode_mem32_hdr(stlp, rtlp);
+    return tlpsz;
+}
+
+static int
+decode_memwr(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
+{
+    const int tlpsz = 12;
+
+    if (rtlpsz < tlpsz) {
+        return ref_set_error("memwr: rtlpsz want %d got %ld",
+                                 tlpsz, rtlpsz);
+    }
+
+    decode_mem32_hdr(stlp, rtlp);
+
+    if (rtlpsz < tlpsz + stlp->size) {
+        return ref_set_error("memwr: rtlpsz want %d got %ld",
+                                 tlpsz + stlp->size, rtlpsz);
+    }
+
+    decode_data(stlp, rtlp + 12);
+    return tlpsz + stlp->size;
+}
+
+static int
+decode_memrd64(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
+{
+    const int tlpsz = 16;
+
+    if (rtlpsz < tlpsz) {
+        return ref_set_error("memrd64: rtlpsz want %d got %ld",
+                                 tlpsz, rtlpsz);
+    }
+
+    decode_mem64_hdr(stlp, rtlp);
+    return tlpsz;
+}
+
+static int
+decode_memwr64(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
+{
+    const int tlpsz = 16;
+
+    if (rtlpsz < tlpsz) {
+        return ref_set_error("memwr64: rtlpsz want %d got %ld",
+                                 tlpsz, rtlpsz);
+    }
+
+    decode_mem64_hdr(stlp, rtlp);
+
+    if (rtlpsz < tlpsz + stlp->size) {
+        return ref_set_error("memwr64: rtlpsz want %d got %ld",
+                                 tlpsz + stlp->size, rtlpsz);
+    }
+
+    decode_data(stlp, rtlp + 16);
+    return tlpsz + stlp->size;
+}
+
+static int
+decode_iord(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
+{
+    const int tlpsz = 12;
+
+    if (rtlpsz < tlpsz) {
+        return ref_set_error("iord: rtlpsz want %d got %ld",
+                                 tlpsz, rtlpsz);
+    }
+
+    decode_mem32_hdr(stlp, rtlp);
+    return tlpsz;
+}
+
+static int
+decode_iowr(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
+{
+    const int tlpsz = 16;
+
+    if (rtlpsz < tlpsz) {
+        return ref_set_error("iowr: rtlpsz want %d got %ld",
+                                 tlpsz, rtlpsz);
+    }
+
+    decode_mem32_hdr(stlp, rtlp);
+    decode_data(stlp, rtlp + 12);
+    return tlpsz;
+}
+
+int
+pcietlp_ref_decode(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
+{
+    const pcie_tlp_common_hdr_t *hdr = rtlp;
+    int n;
+
+    ref_clr_error();
+    switch (hdr->type) {
+    case PCIE_TLP_TYPE_MEMRD:
+        stlp->type = PCIE_STLP_MEMRD;
+        n = decode_memrd(stlp, rtlp, rtlpsz);
+        break;
+    case PCIE_TLP_TYPE_MEMRD64:
+        stlp->type = PCIE_STLP_MEMRD64;
+        n = decode_memrd64(stlp, rtlp, rtlpsz);
+        break;
+    case PCIE_TLP_TYPE_MEMWR:
+        stlp->type = PCIE_STLP_MEMWR;
+        n = decode_memwr(stlp, rtlp, rtlpsz);
+        break;
+    case PCIE_TLP_TYPE_MEMWR64:
+        stlp->type = PCIE_STLP_MEMWR64;
+        n = decode_memwr64(stlp, rtlp, rtlpsz);
+        break;
+    case PCIE_TLP_TYPE_IORD:
+        stlp->type = PCIE_STLP_IORD;
+        n = decode_iord(stlp, rtlp, rtlpsz);
+        break;
+    case PCIE_TLP_TYPE_IOWR:
+        stlp->type = PCIE_STLP_IOWR;
+        n = decode_iowr(stlp, rtlp, rtlpsz);
+        break;
+    case PCIE_TLP_TYPE_CFGRD0:
+        stlp->type = PCIE_STLP_CFGRD;
+        n = decode_cfgrd(stlp, rtlp, rtlpsz);
+        break;
+    case PCIE_TLP_TYPE_CFGWR0:
+        stlp->type = PCIE_STLP_CFGWR;
+        n = decode_cfgwr(stlp, rtlp, rtlpsz);
+        break;
+    case PCIE_TLP_TYPE_CFGRD1:
+        stlp->type = PCIE_STLP_CFGRD1;
+        n = decode_cfgrd(stlp, rtlp, rtlpsz);
+        break;
+    case PCIE_TLP_TYPE_CFGWR1:
+        stlp->type = PCIE_STLP_CFGWR1;
+        n = decode_cfgwr(stlp, rtlp, rtlpsz);
+        break;
+    default:
+        ref_set_error("decode: unhandled type 0x%x\n", hdr->type);
+        n = -1;
+        break;
+    }
+    return ref_is_error() ? -1 : n;
+}
@@ -0,0 +1,278 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2023, Oracle and/or its affiliates.
+ */
+
+/*
+ * rangebench - time range operations through the hosted pciesvc build
+ *
+ * These are the operations whose cost grows with the size of a
+ * device block rather than with the TLP rate: resetting a block
+ * of VFs when a PF disables sriov, loading and unloading the bars
+ * of a block of VFs when a PF enables sriov, and programming the
+ * hdrt and prt tables for a range of lifs/entries.  Each operation is
+ * repeated and reported as min/median latency and the simulated
+ * register writes it issued.
+ *
+ * usage: rangebench [-n iters] [-v]
+ */
+
+#include <getopt.h>
+#include "pciesvc_hosted.h"
+#include "reset.h"
+#include "hdrt.h"
+#include "pmt.h"
+
+#define BENCH_PORT	0
+#define BENCH_BDF	0x0100
+#define BENCH_MAXVFS	256
+#define BENCH_INTRC	4
+#define BENCH_LIFC	1
+#define BENCH_VFBAR	0xe0000000ULL
+#define BENCH_VFBARSZ	0x1000
+
+static const int vfcounts[] = { 1, 64, 256 };
+static const int tblcounts[] = { 1, 16, 256, 1024, 2048, 4096 };
+
+enum {
+	TBL_HDRT_LOAD,
+	TBL_HDRT_UNLOAD,
+	TBL_PRT_LOAD,
+	TBL_PRT_UNLOAD,
+	TBL_COUNT,
+};
+
+static const char *tbl_name[TBL_COUNT] = {
+	"hdrt load", "hdrt unload", "prt load", "prt unload",
+};
+
+static int
+cmp_u64(const void *a, const void *b)
+{
+	const u_int64_t x = *(const u_int64_t *)a;
+	const u_int64_t y = *(const u_int64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Dirty the cmd register of each VF so every reset has real
+ * work to do, then time pciehw_reset_vfs() over the block.
+ */
+static void
+run_vfreset(const pciehwdevh_t pfh, const int iters)
+{
+	hosted_stats_t *hs = pciesvc_hosted_stats();
+	u_int64_t *ns = calloc(iters, sizeof(*ns));
+	u_int64_t t0, wr;
+	pciehwdev_t *pfdev;
+	cfgspace_t cs;
+	int i, j, v;
+
+	printf("%-8s %12s %12s %12s %12s\n",
+	       "vfs", "min ns", "median ns", "ns/vf", "reg wr");
+	for (i = 0; i < sizeof(vfcounts) / sizeof(vfcounts[0]); i++) {
+		const int nvfs = vfcounts[i];
+
+		wr = 0;
+		for (j = 0; j < iters; j++) {
+			pfdev = pciehwdev_get(pfh);
+			for (v = 0; v < nvfs; v++) {
+				pciesvc_cfgspace_get(pfdev->childh + v, &cs);
+				cfgspace_writew(&cs, PCI_COMMAND,
+						PCI_COMMAND_MEMORY);
+				pciesvc_cfgspace_put(&cs, DIRTY);
+			}
+			wr -= hs->reg_wr;
+			t0 = pciesvc_hosted_nsecs();
+			pciehw_reset_vfs(pfdev, 0, nvfs);
+			ns[j] = pciesvc_hosted_nsecs() - t0;
+			wr += hs->reg_wr;
+			pciehwdev_put(pfdev, CLEAN);
+		}
+		qsort(ns, iters, sizeof(*ns), cmp_u64);
+		printf("%-8d %12"PRIu64" %12"PRIu64" %12.1f %12"PRIu64"\n",
+		       nvfs, ns[0], ns[iters / 2],
+		       (double)ns[iters / 2] / nvfs, wr / iters);
+	}
+	free(ns);
+}
+
+/*
+ * Time pciehw_vfs_load_bars() and pciehw_vfs_unload_bars() over the
+ * block, what a NumVFs write with memory space enabled costs.  Each
+ * VF has one virtio bar so the per-bar notify setup is included.
+ */
+static void
+run_vfbars(const pciehwdevh_t pfh, const int iters)
+{
+	hosted_stats_t *hs = pciesvc_hosted_stats();
+	u_int64_t *ns[2], t0, wr[2], tbl[2];
+	pciehwdev_t *pfdev;
+	int i, j, k;
+
+	ns[0] = calloc(iters, sizeof(*ns[0]));
+	ns[1] = calloc(iters, sizeof(*ns[1]));
+	printf("%-8s %-8s %12s %12s %12s %10s %8s\n",
+	       "vfs", "op", "min ns", "median ns", "ns/vf", "reg wr", "tbl wr");
+	pfdev = pciehwdev_get(pfh);
+	pciehw_vfs_unload_bars(pfdev, 0, BENCH_MAXVFS);
+	for (i = 0; i < sizeof(vfcounts) / sizeof(vfcounts[0]); i++) {
+		const int nvfs = vfcounts[i];
+
+		wr[0] = wr[1] = tbl[0] = tbl[1] = 0;
+		for (j = 0; j < iters; j++) {
+			for (k = 0; k < 2; k++) {
+				wr[k] -= hs->reg_wr;
+				tbl[k] -= hs->reg_wr_table;
+				t0 = pciesvc_hosted_nsecs();
+				if (k == 0)
+					pciehw_vfs_load_bars(pfdev, 0, nvfs);
+				else
+					pciehw_vfs_unload_bars(pfdev, 0, nvfs);
+				ns[k][j] = pciesvc_hosted_nsecs() - t0;
+				wr[k] += hs->reg_wr;
+				tbl[k] += hs->reg_wr_table;
+			}
+		}
+		for (k = 0; k < 2; k++) {
+			qsort(ns[k], iters, sizeof(*ns[k]), cmp_u64);
+			printf("%-8d %-8s %12"PRIu64" %12"PRIu64" %12.1f "
+			       "%10"PRIu64" %8"PRIu64"\n",
+			       nvfs, k == 0 ? "load" : "unload",
+			       ns[k][0], ns[k][iters / 2],
+			       (double)ns[k][iters / 2] / nvfs,
+			       wr[k] / iters, tbl[k] / iters);
+		}
+	}
+	pciehwdev_put(pfdev, CLEAN);
+	free(ns[0]);
+	free(ns[1]);
+}
+
+static int
+tbl_size(const int op)
+{
+	return op <= TBL_HDRT_UNLOAD ?
+		ASIC_(PXB_CSR_DHS_ITR_PCIHDRT_ENTRIES) : PRT_COUNT;
+}
+
+static void
+tbl_op(const int op, const int n)
+{
+	switch (op) {
+	case TBL_HDRT_LOAD:	pciehw_hdrt_load(0, n, BENCH_BDF); break;
+	case TBL_HDRT_UNLOAD:	pciehw_hdrt_unload(0, n); break;
+	case TBL_PRT_LOAD:	pciehw_prt_load(0, n); break;
+	case TBL_PRT_UNLOAD:	pciehw_prt_unload(0, n); break;
+	}
+}
+
+/*
+ * Program a range of table entries from entry 0.  Counts larger
+ * than the table (the hdrt has one entry per lif) are skipped.
+ */
+static void
+run_tables(const int iters)
+{
+	hosted_stats_t *hs = pciesvc_hosted_stats();
+	u_int64_t *ns = calloc(iters, sizeof(*ns));
+	u_int64_t t0, wr, tbl;
+	int op, i, j;
+
+	printf("%-12s %8s %12s %12s %10s %10s %8s\n", "table", "entries",
+	       "min ns", "median ns", "ns/entry", "reg wr", "tbl wr");
+	for (op = 0; op < TBL_COUNT; op++) {
+		for (i = 0; i < sizeof(tblcounts) / sizeof(tblcounts[0]); i++) {
+			const int n = tblcounts[i];
+
+			if (n > tbl_size(op))
+				continue;
+			wr = hs->reg_wr;
+			tbl = hs->reg_wr_table;
+			for (j = 0; j < iters; j++) {
+				t0 = pciesvc_hosted_nsecs();
+				tbl_op(op, n);
+				ns[j] = pciesvc_hosted_nsecs() - t0;
+			}
+			wr = hs->reg_wr - wr;
+			tbl = hs->reg_wr_table - tbl;
+			qsort(ns, iters, sizeof(*ns), cmp_u64);
+			printf("%-12s %8d %12"PRIu64" %12"PRIu64" %10.1f "
+			       "%10"PRIu64" %8"PRIu64"\n",
+			       tbl_name[op], n, ns[0], ns[iters / 2],
+			       (double)ns[iters / 2] / n,
+			       wr / iters, tbl / iters);
+		}
+	}
+	free(ns);
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-n iters] [-v]\n", prog);
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	pciesvc_params_t p;
+	pciehwdevh_t pfh, vfh;
+	int c, iters = 200;
+
+	while ((c = getopt(argc, argv, "n:v")) != -1) {
+		switch (c) {
+		case 'n': iters = atoi(optarg); break;
+		case 'v': pciesvc_hosted_set_verbose(1); break;
+		default: usage(argv[0]);
+		}
+	}
+	if (iters <= 0)
+		usage(argv[0]);
+
+	if (pciesvc_hosted_init(0) < 0) {
+		fprintf(stderr, "pciesvc_hosted_init failed\n");
+		return 1;
+	}
+	memset(&p, 0, sizeof(p));
+	p.version = 0;
+	p.params_v0.port = BENCH_PORT;
+	if (pciesvc_init(&p) < 0) {
+		fprintf(stderr, "pciesvc_init failed\n");
+		return 1;
+	}
+
+	pfh = pciesvc_hosted_dev_add(BENCH_PORT, "pf0", BENCH_BDF,
+				     0x1dd8, 0x1002);
+	vfh = pfh ? pciesvc_hosted_vfs_add(pfh, BENCH_MAXVFS, 0, BENCH_INTRC,
+					   0, BENCH_LIFC) : 0;
+	for (c = 0; vfh && c < BENCH_MAXVFS; c++) {
+		if (pciesvc_hosted_bar_add(vfh + c, 0,
+					   BENCH_VFBAR + c * BENCH_VFBARSZ,
+					   BENCH_VFBARSZ,
+					   PCIEHW_BARHND_VIRTIO) < 0)
+			vfh = 0;
+	}
+	if (vfh == 0) {
+		fprintf(stderr, "device setup failed\n");
+		return 1;
+	}
+
+	printf("vf reset, %d iters, %d intrs %d lifs per vf:\n",
+	       iters, BENCH_INTRC, BENCH_LIFC);
+	run_vfreset(pfh, iters);
+
+	printf("\nvf bar load/unload, %d iters, 1 virtio bar per vf:\n",
+	       iters);
+	run_vfbars(pfh, iters);
+
+	printf("\ntable programming, %d iters:\n", iters);
+	run_tables(iters);
+
+	printf("\nhosted reg bad %"PRIu64"\n", pciesvc_hosted_stats()->reg_bad);
+	pciesvc_shut(BENCH_PORT);
+	pciesvc_hosted_fini();
+	return 0;
+}
@@ -0,0 +1,823 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2023, Oracle and/or its affiliates.
+ */
+
+/*
+ * tlpbench - replay TLP streams through the hosted pciesvc build
+ *
+ * Each TLP is encoded, posted to the simulated indirect srams or
+ * notify ring, and serviced with pciesvc_poll(), so the measured
+ * path is pcietlp_decode() -> handle_indirect()/handle_notify() ->
+ * handlers -> pciehw_indirect_complete().
+ *
+ * Latency is measured per TLP (post, then poll to completion) and
+ * reported as percentiles by path and TLP type.  Throughput is
+ * measured separately by posting bursts that fill the indirect
+ * srams (or a chunk of the notify ring) and draining them.
+ * Decode cost alone is measured by running pcietlp_decode() over
+ * the pre-encoded stream, next to the switch based decoder it
+ * replaced (pcietlp_ref.c), after checking the two agree over the
+ * stream and over random, possibly truncated, headers.
+ *
+ * usage: tlpbench [-n count] [-d ndevs] [-b burst] [-B budget] [-m mix]
+ *                 [-p ind|not|both] [-P nports] [-r replayfile] [-H top]
+ *                 [-V fast|slow] [-v]
+ *
+ *   -B budget  indirect entries serviced per pciesvc_poll(),
+ *              set with PCIESVC_CMD_SET_IND_BUDGET
+ *   -H top     profile bar accesses during the latency run with
+ *              PCIESVC_CMD_SET_BAR_PROF and print the top entries
+ *   -V mode    make the bars virtio and every memwr a legacy
+ *              queue_notify doorbell, serviced by the notify fast
+ *              path (fast) or the full virtio_barwr() path (slow)
+ *   -m mix     weights by type, e.g. "cfgrd=60,cfgwr=20,memrd=10,memwr=10"
+ *   -P nports  spread devices over this many ports and drain them
+ *              with pciesvc_poll_round() like the kpcimgr poller
+ *   -r file    replay TLPs from file instead of a synthetic stream,
+ *              one per line: <ind|not> <cfgrd|cfgwr|memrd|memwr>
+ *              <dev> <addr> <size> [data], '#' starts a comment
+ */
+
+#include <getopt.h>
+#include "pciesvc_hosted.h"
+#include "virtio.h"
+
+#define BENCH_PORT(dev)	((dev) % nports)
+#define BENCH_BDF(i)	(0x0100 + (i))
+#define BENCH_BARADDR	0xe0000000ULL
+#define BENCH_BARSIZE	0x1000
+#define BENCH_HOTREGS	16
+
+enum {
+	PATH_IND,
+	PATH_NOT,
+	PATH_COUNT,
+};
+
+enum {
+	OP_CFGRD,
+	OP_CFGWR,
+	OP_MEMRD,
+	OP_MEMWR,
+	OP_COUNT,
+};
+
+static const char *path_name[PATH_COUNT] = { "ind", "not" };
+static const char *op_name[OP_COUNT] = { "cfgrd", "cfgwr", "memrd", "memwr" };
+
+typedef struct bench_tlp_s {
+	u_int8_t path;
+	u_int8_t op;
+	u_int16_t dev;
+	u_int16_t size;
+	u_int64_t addr;
+	u_int64_t data;
+} bench_tlp_t;
+
+typedef struct bench_samples_s {
+	u_int64_t *ns;
+	size_t n, max;
+} bench_samples_t;
+
+static pciehwdevh_t *devh;
+static int ndevs = 64;
+static int nports = 1;
+static int vnotify = -1;		/* -V: -1 off, 0 slow, 1 fast */
+static u_int64_t port_polls[PCIEHW_NPORTS], port_serviced[PCIEHW_NPORTS];
+static int nrsp;
+static bench_samples_t samples[PATH_COUNT][OP_COUNT];
+
+static void
+bench_rsp_cb(const hosted_ind_rsp_t *rsp, void *arg)
+{
+	nrsp++;
+}
+
+static int
+samples_add(bench_samples_t *s, const u_int64_t ns)
+{
+	if (s->n == s->max) {
+		size_t max = s->max ? s->max * 2 : 1024;
+		u_int64_t *p = realloc(s->ns, max * sizeof(*p));
+
+		if (p == NULL)
+			return -1;
+		s->ns = p;
+		s->max = max;
+	}
+	s->ns[s->n++] = ns;
+	return 0;
+}
+
+static int
+u64cmp(const void *a, const void *b)
+{
+	const u_int64_t x = *(const u_int64_t *)a;
+	const u_int64_t y = *(const u_int64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static u_int64_t
+percentile(const bench_samples_t *s, const double pct)
+{
+	size_t i = (size_t)(pct / 100.0 * (s->n - 1) + 0.5);
+
+	return s->ns[i];
+}
+
+static void
+tlp_to_stlp(const bench_tlp_t *t, pcie_stlp_t *stlp)
+{
+	memset(stlp, 0, sizeof(*stlp));
+	stlp->bdf = BENCH_BDF(t->dev);
+	stlp->size = t->size;
+	stlp->data = t->data;
+	switch (t->op) {
+	case OP_CFGRD:
+		stlp->type = PCIE_STLP_CFGRD;
+		stlp->addr = t->addr;
+		break;
+	case OP_CFGWR:
+		stlp->type = PCIE_STLP_CFGWR;
+		stlp->addr = t->addr;
+		break;
+	case OP_MEMRD:
+		stlp->type = PCIE_STLP_MEMRD64;
+		stlp->addr = BENCH_BARADDR + t->addr;
+		break;
+	case OP_MEMWR:
+		stlp->type = PCIE_STLP_MEMWR64;
+		stlp->addr = BENCH_BARADDR + t->addr;
+		break;
+	}
+}
+
+static int
+tlp_post(const bench_tlp_t *t)
+{
+	u_int8_t rtlp[INDIRECT_TLPSZ];
+	tlpauxinfo_t info;
+	pcie_stlp_t stlp;
+
+	tlp_to_stlp(t, &stlp);
+	if (pcietlp_encode(&stlp, rtlp, sizeof(rtlp)) < 0 ||
+	    pciesvc_hosted_tlpinfo(&stlp, devh[t->dev], &info) < 0)
+		return -1;
+	if (t->path == PATH_IND)
+		return pciesvc_hosted_ind_post(BENCH_PORT(t->dev), rtlp,
+					       INDIRECT_TLPSZ, &info);
+	info.is_indirect = 0;
+	info.is_notify = 1;
+	return pciesvc_hosted_not_post(BENCH_PORT(t->dev), rtlp,
+				       NOTIFY_TLPSZ, &info);
+}
+
+static int
+drained(void)
+{
+	int port;
+
+	for (port = 0; port < nports; port++)
+		if (pciesvc_hosted_ind_pending(port) ||
+		    pciesvc_hosted_not_pending(port))
+			return 0;
+	return 1;
+}
+
+static int
+drain(void)
+{
+	const u_int32_t mask = pciesvc_ports_valid();
+	int res[PCIEHW_NPORTS], polls = 0, port;
+	u_int32_t worked;
+
+	while (!drained()) {
+		worked = pciesvc_poll_round(mask, res);
+		for (port = 0; port < nports; port++) {
+			if (res[port] < 0)
+				return -1;
+			port_polls[port]++;
+			if (worked & (1 << port))
+				port_serviced[port]++;
+		}
+		polls++;
+	}
+	return polls;
+}
+
+/*****************************************************************
+ * stream generation
+ */
+
+static int
+parse_mix(const char *mix, int *weight)
+{
+	char *s = strdup(mix), *tok, *save = NULL;
+	int i, w, ok = 0;
+
+	memset(weight, 0, OP_COUNT * sizeof(*weight));
+	for (tok = strtok_r(s, ",", &save); tok;
+	     tok = strtok_r(NULL, ",", &save)) {
+		char *eq = strchr(tok, '=');
+
+		if (eq == NULL)
+			break;
+		*eq = '\0';
+		w = atoi(eq + 1);
+		for (i = 0; i < OP_COUNT; i++) {
+			if (strcmp(tok, op_name[i]) == 0) {
+				weight[i] = w;
+				ok = 1;
+			}
+		}
+	}
+	free(s);
+	return ok ? 0 : -1;
+}
+
+/*
+ * Synthetic stream resembling host enumeration: mostly
+ * dword config reads across the header and capability area,
+ * some config writes to command/bars, and bar register traffic.
+ * Like most device registers the bar traffic is skewed, 3/4 of
+ * it goes to the first BENCH_HOTREGS dwords of the bar.
+ */
+static u_int64_t
+bar_reg(void)
+{
+	if (random() % 4)
+		return (random() % BENCH_HOTREGS) * 4;
+	return (random() % (BENCH_BARSIZE / 4)) * 4;
+}
+
+static void
+gen_tlp(bench_tlp_t *t, const int path, const int *weight, const int wsum)
+{
+	int r = random() % wsum, op;
+
+	for (op = 0; op < OP_COUNT - 1 && r >= weight[op]; op++)
+		r -= weight[op];
+
+	memset(t, 0, sizeof(*t));
+	t->path = path;
+	t->op = op;
+	t->dev = random() % ndevs;
+	t->size = 4;
+	switch (op) {
+	case OP_CFGRD:
+		t->addr = (random() % 64) * 4;
+		break;
+	case OP_CFGWR:
+		/* command register and cache line/latency are writable */
+		t->addr = (random() & 1) ? PCI_COMMAND : PCI_CACHE_LINE_SIZE;
+		t->size = 2;
+		t->data = random() & 0xffff;
+		break;
+	case OP_MEMRD:
+		t->addr = bar_reg();
+		break;
+	case OP_MEMWR:
+		if (vnotify >= 0) {
+			t->addr = virtio_notify_baroff();
+			t->size = 2;
+			t->data = random() % 8;
+			break;
+		}
+		t->addr = bar_reg();
+		t->data = random();
+		break;
+	}
+}
+
+static bench_tlp_t *
+load_replay(const char *path, size_t *ntlps)
+{
+	FILE *fp = fopen(path, "r");
+	bench_tlp_t *tlps = NULL, *t;
+	size_t n = 0, max = 0;
+	char line[256], p[8], o[8];
+	unsigned long long addr, data;
+	unsigned int dev, size;
+	int i, nf;
+
+	if (fp == NULL) {
+		perror(path);
+		return NULL;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		char *c = strchr(line, '#');
+
+		if (c)
+			*c = '\0';
+		data = 0;
+		nf = sscanf(line, "%7s %7s %u %llx %u %llx",
+			    p, o, &dev, &addr, &size, &data);
+		if (nf <= 0)
+			continue;
+		if (nf < 5 || dev >= ndevs) {
+			fprintf(stderr, "%s: bad line: %s", path, line);
+			continue;
+		}
+		if (n == max) {
+			max = max ? max * 2 : 1024;
+			tlps = realloc(tlps, max * sizeof(*tlps));
+			if (tlps == NULL)
+				break;
+		}
+		t = &tlps[n];
+		memset(t, 0, sizeof(*t));
+		t->path = strcmp(p, "not") == 0 ? PATH_NOT : PATH_IND;
+		t->op = OP_COUNT;
+		for (i = 0; i < OP_COUNT; i++)
+			if (strcmp(o, op_name[i]) == 0)
+				t->op = i;
+		if (t->op == OP_COUNT) {
+			fprintf(stderr, "%s: bad type: %s\n", path, o);
+			continue;
+		}
+		t->dev = dev;
+		t->addr = addr;
+		t->size = size;
+		t->data = data;
+		n++;
+	}
+	fclose(fp);
+	*ntlps = n;
+	return tlps;
+}
+
+/*****************************************************************
+ * measurement
+ */
+
+static int
+run_latency(const bench_tlp_t *tlps, const size_t ntlps)
+{
+	u_int64_t t0;
+	size_t i;
+
+	for (i = 0; i < ntlps; i++) {
+		const bench_tlp_t *t = &tlps[i];
+
+		if (tlp_post(t) < 0)
+			return -1;
+		t0 = pciesvc_hosted_nsecs();
+		if (drain() < 0)
+			return -1;
+		if (samples_add(&samples[t->path][t->op],
+				pciesvc_hosted_nsecs() - t0) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+static int
+run_throughput(const bench_tlp_t *tlps, const size_t ntlps,
+	       const int path, const int burst, double *rate)
+{
+	u_int64_t t0, elapsed = 0;
+	size_t i, n = 0;
+	int b;
+
+	for (i = 0; i < ntlps; ) {
+		/* posting is not part of the measured service time */
+		for (b = 0; b < burst && i < ntlps; i++) {
+			if (tlps[i].path != path)
+				continue;
+			if (tlp_post(&tlps[i]) < 0)
+				return -1;
+			b++;
+		}
+		t0 = pciesvc_hosted_nsecs();
+		if (drain() < 0)
+			return -1;
+		elapsed += pciesvc_hosted_nsecs() - t0;
+		n += b;
+	}
+	*rate = elapsed ? n * 1e9 / elapsed : 0;
+	return n;
+}
+
+/*
+ * Decoded results must match the reference decoder's: return value,
+ * and the decoded fields on success or the error string on failure.
+ */
+static int
+decode_agrees(const void *rtlp, const size_t rtlpsz)
+{
+	pcie_stlp_t a, b;
+	int na, nb;
+
+	memset(&a, 0, sizeof(a));
+	memset(&b, 0, sizeof(b));
+	na = pcietlp_decode(&a, rtlp, rtlpsz);
+	nb = pcietlp_ref_decode(&b, rtlp, rtlpsz);
+	if (na != nb)
+		return 0;
+	if (na < 0)
+		return strcmp(pcietlp_get_error(), pcietlp_ref_get_error()) == 0;
+	return a.type == b.type && a.reqid == b.reqid && a.tag == b.tag &&
+		a.bdf == b.bdf && a.size == b.size && a.addr == b.addr &&
+		a.data == b.data;
+}
+
+/*
+ * Random headers, biased to the handled types, at random lengths
+ * so the truncation checks are exercised too.
+ */
+static int
+check_decode_random(const int n)
+{
+	static const u_int8_t types[] = {
+		PCIE_TLP_TYPE_MEMRD, PCIE_TLP_TYPE_MEMRD64,
+		PCIE_TLP_TYPE_MEMWR, PCIE_TLP_TYPE_MEMWR64,
+		PCIE_TLP_TYPE_IORD, PCIE_TLP_TYPE_IOWR,
+		PCIE_TLP_TYPE_CFGRD0, PCIE_TLP_TYPE_CFGWR0,
+		PCIE_TLP_TYPE_CFGRD1, PCIE_TLP_TYPE_CFGWR1,
+	};
+	u_int8_t rtlp[INDIRECT_TLPSZ];
+	int i, j;
+
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < sizeof(rtlp); j++)
+			rtlp[j] = random();
+		if (i % 8)
+			rtlp[0] = types[random() % sizeof(types)];
+		if (!decode_agrees(rtlp, random() % (sizeof(rtlp) + 1)))
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ * Decode a cache-resident sample of the encoded stream, per TLP
+ * type, so the per-call cost isn't swamped by the simulated
+ * register accesses on the service path.  Each sample is timed
+ * with the current decoder and with the reference one.
+ */
+#define DECODE_SAMPLE	256
+#define DECODE_RANDOM	200000
+
+static int
+run_decode(const bench_tlp_t *tlps, const size_t ntlps, const int loops)
+{
+	u_int8_t rtlp[DECODE_SAMPLE][INDIRECT_TLPSZ];
+	u_int64_t t0, ns[2];
+	pcie_stlp_t stlp;
+	size_t i;
+	int op, n, l, k, ref;
+
+	if (check_decode_random(DECODE_RANDOM) < 0) {
+		fprintf(stderr, "decode: random headers disagree with ref\n");
+		return -1;
+	}
+	printf("%-6s %10s %12s %12s\n", "type", "decodes", "ns/decode",
+	       "ref ns");
+	for (op = 0; op < OP_COUNT; op++) {
+		for (n = 0, i = 0; i < ntlps && n < DECODE_SAMPLE; i++) {
+			if (tlps[i].op != op)
+				continue;
+			tlp_to_stlp(&tlps[i], &stlp);
+			if (pcietlp_encode(&stlp, rtlp[n], sizeof(rtlp[n])) < 0 ||
+			    !decode_agrees(rtlp[n], sizeof(rtlp[n])))
+				return -1;
+			n++;
+		}
+		if (n == 0)
+			continue;
+		for (ref = 0; ref < 2; ref++) {
+			t0 = pciesvc_hosted_nsecs();
+			for (l = 0; l < loops; l++) {
+				for (k = 0; k < n; k++) {
+					if ((ref ? pcietlp_ref_decode :
+					     pcietlp_decode)(&stlp, rtlp[k],
+							     sizeof(rtlp[k])) < 0)
+						return -1;
+				}
+			}
+			ns[ref] = pciesvc_hosted_nsecs() - t0;
+		}
+		printf("%-6s %10d %12.2f %12.2f\n", op_name[op], n * loops,
+		       (double)ns[0] / (n * loops), (double)ns[1] / (n * loops));
+	}
+	return 0;
+}
+
+static void
+report(void)
+{
+	bench_samples_t *s;
+	u_int64_t sum;
+	size_t i;
+	int path, op;
+
+	printf("%-4s %-6s %9s %10s %7s %7s %7s %7s %7s %8s\n",
+	       "path", "type", "count", "tlps/s",
+	       "min", "p50", "p90", "p99", "p99.9", "max(ns)");
+	for (path = 0; path < PATH_COUNT; path++) {
+		for (op = 0; op < OP_COUNT; op++) {
+			s = &samples[path][op];
+			if (s->n == 0)
+				continue;
+			qsort(s->ns, s->n, sizeof(*s->ns), u64cmp);
+			for (sum = 0, i = 0; i < s->n; i++)
+				sum += s->ns[i];
+			printf("%-4s %-6s %9zu %10.0f "
+			       "%7"PRIu64" %7"PRIu64" %7"PRIu64" %7"PRIu64" "
+			       "%7"PRIu64" %8"PRIu64"\n",
+			       path_name[path], op_name[op], s->n,
+			       sum ? s->n * 1e9 / sum : 0,
+			       s->ns[0], percentile(s, 50), percentile(s, 90),
+			       percentile(s, 99), percentile(s, 99.9),
+			       s->ns[s->n - 1]);
+		}
+	}
+}
+
+static int
+set_ind_budget(const int budget)
+{
+	pciesvc_cmd_t cmd;
+	pciesvc_cmdres_t res;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.set_ind_budget.cmd = PCIESVC_CMD_SET_IND_BUDGET;
+	cmd.set_ind_budget.budget = budget;
+	if (pciesvc_cmd_write((char *)&cmd, 0, sizeof(cmd)) < 0 ||
+	    pciesvc_cmd_read((char *)&res, 0, sizeof(res)) < 0 ||
+	    res.set_ind_budget.status != PCIESVC_CMDSTATUS_SUCCESS)
+		return -1;
+	return 0;
+}
+
+static int
+set_bar_prof(const int enable)
+{
+	pciesvc_cmd_t cmd;
+	pciesvc_cmdres_t res;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.set_bar_prof.cmd = PCIESVC_CMD_SET_BAR_PROF;
+	cmd.set_bar_prof.enable = enable;
+	cmd.set_bar_prof.clear = enable;
+	if (pciesvc_cmd_write((char *)&cmd, 0, sizeof(cmd)) < 0 ||
+	    pciesvc_cmd_read((char *)&res, 0, sizeof(res)) < 0 ||
+	    res.set_bar_prof.status != PCIESVC_CMDSTATUS_SUCCESS)
+		return -1;
+	if (!enable)
+		printf("%u of %u entries used, %"PRIu64" accesses not counted\n",
+		       res.set_bar_prof.nents, res.set_bar_prof.nslots,
+		       res.set_bar_prof.full);
+	return 0;
+}
+
+static int
+barprof_cmp(const void *a, const void *b)
+{
+	const pciesvc_barprof_ent_t *x = a, *y = b;
+
+	return x->count < y->count ? 1 : x->count > y->count ? -1 : 0;
+}
+
+/*
+ * Read the profile back through the cmd interface, the way a
+ * reader of the kpcimgr sysfs file would, hottest entries first.
+ */
+static int
+report_bar_prof(const int top)
+{
+	pciesvc_barprof_ent_t *ents = NULL;
+	pciesvc_cmd_t cmd;
+	pciesvc_cmdres_t res;
+	u_int64_t total = 0;
+	int n = 0, max = 0, i;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.bar_prof_read.cmd = PCIESVC_CMD_BAR_PROF_READ;
+	for (;;) {
+		if (pciesvc_cmd_write((char *)&cmd, 0, sizeof(cmd)) < 0 ||
+		    pciesvc_cmd_read((char *)&res, 0, sizeof(res)) < 0) {
+			free(ents);
+			return -1;
+		}
+		if (!res.bar_prof_read.valid)
+			break;
+		if (n == max) {
+			max = max ? max * 2 : 64;
+			ents = realloc(ents, max * sizeof(*ents));
+		}
+		ents[n++] = res.bar_prof_read.ent;
+		total += res.bar_prof_read.ent.count;
+		cmd.bar_prof_read.idx = res.bar_prof_read.next;
+	}
+	qsort(ents, n, sizeof(*ents), barprof_cmp);
+
+	printf("%-8s %-4s %-8s %-4s %-3s %10s %7s\n",
+	       "dev", "bar", "offset", "size", "dir", "count", "%");
+	for (i = 0; i < n && i < top; i++)
+		printf("%-8u %-4u 0x%06x %-4u %-3s %10"PRIu64" %6.2f%%\n",
+		       ents[i].hwdevh, ents[i].cfgidx, ents[i].baroff,
+		       ents[i].size, ents[i].wr ? "wr" : "rd", ents[i].count,
+		       100.0 * ents[i].count / total);
+	free(ents);
+	return 0;
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-n count] [-d ndevs] [-b burst] [-B budget] [-m mix]\n"
+		"       [-p ind|not|both] [-P nports] [-r replayfile] [-s seed]\n"
+		"       [-H top] [-V fast|slow] [-v]\n",
+		prog);
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *mix = "cfgrd=60,cfgwr=20,memrd=10,memwr=10";
+	const char *replay = NULL, *paths = "both";
+	int weight[OP_COUNT], wsum, c, i, burst = HOSTED_IND_NENTRIES;
+	int budget = 0, prof = 0;
+	bench_tlp_t *tlps;
+	size_t ntlps = 100000;
+	pciesvc_params_t p;
+	pciemgr_stats_t *st;
+	u_int64_t cfgrd = 0, cfgrd_fast = 0;
+	u_int64_t memwr = 0, vnotify_wr = 0;
+	double rate;
+	int n, port;
+
+	while ((c = getopt(argc, argv, "b:B:d:H:m:n:p:P:r:s:vV:")) != -1) {
+		switch (c) {
+		case 'b': burst = atoi(optarg); break;
+		case 'B': budget = atoi(optarg); break;
+		case 'd': ndevs = atoi(optarg); break;
+		case 'H': prof = atoi(optarg); break;
+		case 'm': mix = optarg; break;
+		case 'n': ntlps = strtoul(optarg, NULL, 0); break;
+		case 'p': paths = optarg; break;
+		case 'P': nports = atoi(optarg); break;
+		case 'r': replay = optarg; break;
+		case 's': srandom(atoi(optarg)); break;
+		case 'v': pciesvc_hosted_set_verbose(1); break;
+		case 'V':
+			vnotify = strcmp(optarg, "fast") == 0 ? 1 :
+				  strcmp(optarg, "slow") == 0 ? 0 : -2;
+			break;
+		default: usage(argv[0]);
+		}
+	}
+	if (ndevs <= 0 || ndevs >= PCIEHW_NDEVS || burst <= 0 || vnotify < -1 ||
+	    nports <= 0 || nports > PCIEHW_NPORTS ||
+	    parse_mix(mix, weight) < 0)
+		usage(argv[0]);
+	for (wsum = 0, i = 0; i < OP_COUNT; i++)
+		wsum += weight[i];
+	if (wsum <= 0)
+		usage(argv[0]);
+
+	if (pciesvc_hosted_init(0) < 0) {
+		fprintf(stderr, "pciesvc_hosted_init failed\n");
+		return 1;
+	}
+	pciesvc_hosted_set_ind_rsp_cb(bench_rsp_cb, NULL);
+
+	for (port = 0; port < nports; port++) {
+		memset(&p, 0, sizeof(p));
+		p.version = 0;
+		p.params_v0.port = port;
+		p.params_v0.ind_poll = 1;
+		p.params_v0.not_poll = 1;
+		if (pciesvc_init(&p) < 0) {
+			fprintf(stderr, "pciesvc_init port %d failed\n", port);
+			return 1;
+		}
+	}
+
+	if (budget && set_ind_budget(budget) < 0) {
+		fprintf(stderr, "invalid indirect budget %d\n", budget);
+		return 1;
+	}
+
+	devh = calloc(ndevs, sizeof(*devh));
+	for (i = 0; i < ndevs; i++) {
+		char name[16];
+
+		snprintf(name, sizeof(name), "bench%d", i);
+		devh[i] = pciesvc_hosted_dev_add(BENCH_PORT(i), name, BENCH_BDF(i),
+						 0x1dd8, 0x1002);
+		if (devh[i] == 0 ||
+		    pciesvc_hosted_bar_add(devh[i], 0, BENCH_BARADDR,
+					   BENCH_BARSIZE, vnotify >= 0 ?
+					   PCIEHW_BARHND_VIRTIO :
+					   PCIEHW_BARHND_NONE) < 0) {
+			fprintf(stderr, "device setup failed at %d\n", i);
+			return 1;
+		}
+		if (vnotify == 0) {
+			pciehwdev_t *phwdev = pciehwdev_get(devh[i]);
+
+			phwdev->vnotify_pa = 0;
+			pciehwdev_put(phwdev, DIRTY);
+		}
+	}
+
+	if (replay) {
+		tlps = load_replay(replay, &ntlps);
+		if (tlps == NULL || ntlps == 0)
+			return 1;
+	} else {
+		tlps = calloc(ntlps, sizeof(*tlps));
+		for (i = 0; i < ntlps; i++) {
+			int path = PATH_IND;
+
+			if (strcmp(paths, "not") == 0 ||
+			    (strcmp(paths, "both") == 0 && (i & 1)))
+				path = PATH_NOT;
+			gen_tlp(&tlps[i], path, weight, wsum);
+		}
+	}
+
+	printf("tlpbench: %zu tlps, %d devs, burst %d, ind budget %d\n",
+	       ntlps, ndevs, burst, pciesvc_ind_budget);
+
+	if (prof && set_bar_prof(1) < 0) {
+		fprintf(stderr, "bar profile enable failed\n");
+		return 1;
+	}
+	if (run_latency(tlps, ntlps) < 0) {
+		fprintf(stderr, "latency run failed\n");
+		return 1;
+	}
+	report();
+
+	if (prof) {
+		printf("\nbar access profile, top %d:\n", prof);
+		if (report_bar_prof(prof) < 0 || set_bar_prof(0) < 0) {
+			fprintf(stderr, "bar profile read failed\n");
+			return 1;
+		}
+	}
+
+	printf("\nthroughput (burst drain):\n");
+	for (i = 0; i < PATH_COUNT; i++) {
+		/* indirect srams bound the number of outstanding entries */
+		const int b = i == PATH_IND && burst > HOSTED_IND_NENTRIES ?
+			HOSTED_IND_NENTRIES : burst;
+
+		n = run_throughput(tlps, ntlps, i, b, &rate);
+		if (n < 0) {
+			fprintf(stderr, "throughput run failed\n");
+			return 1;
+		}
+		if (n)
+			printf("%-4s %9d tlps %12.0f tlps/s\n",
+			       path_name[i], n, rate);
+	}
+
+	printf("\ndecode:\n");
+	if (run_decode(tlps, ntlps, 10000) < 0) {
+		fprintf(stderr, "decode run failed: %s\n", pcietlp_get_error());
+		return 1;
+	}
+
+	printf("\nindirect responses %d, hosted reg rd %"PRIu64" wr %"PRIu64
+	       " bad %"PRIu64"\n", nrsp,
+	       pciesvc_hosted_stats()->reg_rd,
+	       pciesvc_hosted_stats()->reg_wr,
+	       pciesvc_hosted_stats()->reg_bad);
+
+	for (port = 0; port < nports; port++) {
+		st = &pciesvc_port_get(port)->stats;
+		cfgrd += st->ind_cfgrd;
+		cfgrd_fast += st->ind_cfgrd_fast;
+		if (nports > 1)
+			printf("port %d: %"PRIu64" polls, %"PRIu64" serviced, "
+			       "%"PRIu64" ind + %"PRIu64" not tlps\n", port,
+			       port_polls[port], port_serviced[port],
+			       st->ind_cfgrd + st->ind_cfgwr +
+			       st->ind_memrd + st->ind_memwr,
+			       st->not_cfgrd + st->not_cfgwr +
+			       st->not_memrd + st->not_memwr);
+	}
+	printf("ind cfgrd %"PRIu64", fast path %"PRIu64" (%.1f%%)\n",
+	       cfgrd, cfgrd_fast, cfgrd ? 100.0 * cfgrd_fast / cfgrd : 0.0);
+	for (port = 0; port < nports; port++) {
+		st = &pciesvc_port_get(port)->stats;
+		memwr += st->ind_memwr;
+		vnotify_wr += st->vnotify_wr;
+	}
+	printf("ind memwr %"PRIu64", virtio notify fast path %"PRIu64
+	       " (%.1f%%)\n", memwr, vnotify_wr,
+	       memwr ? 100.0 * vnotify_wr / memwr : 0.0);
+
+	for (port = 0; port < nports; port++)
+		pciesvc_shut(port);
+	pciesvc_hosted_fini();
+	return 0;
+}
@@ -31,6 +31,11 @@
 #define OK_TO_WRITE 0x20
 #define UART_THRE_BIT 5
 
+/* cntvct_el0 runs at 200MHz */
+#define TICKS_PER_US 200
+#define TICKS_PER_MS  (1000*TICKS_PER_US)
+#define TICKS_PER_SEC (1000*TICKS_PER_MS)
+
 /* phases */
 #define NOMMU 0
 #define NORMAL 1
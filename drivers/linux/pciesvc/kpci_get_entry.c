@@ -14,6 +14,7 @@ extern int kpcimgr_not_intr(void *, int);
 extern void kpcimgr_undefined_entry(void);
 extern int pciesvc_sysfs_cmd_read(void *, char *, int *);
 extern int pciesvc_sysfs_cmd_write(void *, char *, size_t, int *);
+extern int kpcimgr_evring_ctl(void *, unsigned int);
 
 extern int pciesvc_version_major;
 extern int pciesvc_version_minor;
@@ -45,6 +46,7 @@ struct kpcimgr_entry_points_t *kpci_get_entry_points(void)
 	ep.entry_point[K_ENTRY_CMD_READ] = pciesvc_sysfs_cmd_read;
 	ep.entry_point[K_ENTRY_CMD_WRITE] = pciesvc_sysfs_cmd_write;
 	ep.entry_point[K_ENTRY_GET_VERSION] = kpcimgr_version_fn;
+	ep.entry_point[K_ENTRY_EVRING_CTL] = kpcimgr_evring_ctl;
 
 	return &ep;
 }
@@ -14,10 +14,6 @@
 #include "pciesvc.h"
 #include "pciesvc_system.h"
 
-#define TICKS_PER_US 200
-#define TICKS_PER_MS  (1000*TICKS_PER_US)
-#define TICKS_PER_SEC (1000*TICKS_PER_MS)
-
 int holding_pen_idx;
 unsigned long kstate_paddr;
 kstate_t *kstate = NULL;
@@ -142,9 +138,7 @@ void serial_input(char c)
 		kpr_err("serial thread running on cpu#%d\n", cpuid());
 		break;
 	case 'e': case 'E':
-		n = ks->evq_head - ks->evq_tail;
-		if (n < 0)
-			n += EVENT_QUEUE_LENGTH;
+		n = evq_count(ks);
 		kpr_err("event queue contains %d records\n", n);
 		break;
 	case 'f': case 'F':
@@ -10,10 +10,7 @@
  */
 
 #include "pciesvc_impl.h"
-
-#define TICKS_PER_US 200
-#define TICKS_PER_MS  (1000*TICKS_PER_US)
-#define TICKS_PER_SEC (1000*TICKS_PER_MS)
+#include "log.h"
 
 /*
  * kp_udelay
@@ -160,12 +157,44 @@ void trigger_serr(int val)
 		pciesvc_pciepreg_rd32(good_bad_pa, &dummy);
 }
 
+/*
+ * Service latency histogram, see kpcimgr_record_latency()
+ */
+static void kpcimgr_report_latency(kstate_t *ks, int phase)
+{
+	unsigned long *h = &ks->trace_data[phase][LAT_HIST];
+
+	kpr_err("         %s latency us: <1 %ld, <2 %ld, <4 %ld, <8 %ld, <16 %ld, <32 %ld, <64 %ld, <128 %ld, <256 %ld, <512 %ld, <1024 %ld, more %ld; %ld idle skips\n",
+		(phase == NOMMU) ? "nommu" : "normal",
+		h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7], h[8], h[9],
+		h[10], h[11], ks->trace_data[phase][POLL_SKIPS]);
+}
+
+/*
+ * Per port poll counters, see kpcimgr_poll_ports()
+ */
+static void kpcimgr_report_ports(kstate_t *ks, int phase)
+{
+	unsigned long *td = ks->trace_data[phase];
+	int port;
+
+	for (port = 0; port < TRACE_NPORTS; port++) {
+		if (td[PORT_POLLS + port] == 0)
+			continue;
+		kpr_err("         %s port %d: %ld polls, %ld serviced, %ld deferred\n",
+			(phase == NOMMU) ? "nommu" : "normal", port,
+			td[PORT_POLLS + port], td[PORT_SERVICED + port],
+			td[PORT_DEFERRED + port]);
+	}
+}
+
 void kpcimgr_report_stats(kstate_t *ks, int phase, int always, int rightnow)
 {
 	pciehw_shmem_t *pshmem = pciesvc_shmem_get();
 	unsigned long now = read_sysreg(cntvct_el0);
 	uint64_t cfgrd, cfgwr, memrd, memwr;
 	static unsigned long last_call = 0;
+	pciesvc_log_stats_t ls;
 	pciemgr_stats_t *s;
 	pciehw_port_t *p;
 
@@ -187,6 +216,34 @@ void kpcimgr_report_stats(kstate_t *ks, int phase, int always, int rightnow)
 			ks->ncalls, (phase == NOMMU) ? "nommu" : "normal",
 			cfgrd, cfgwr, memrd, memwr);
 		kpr_err("         %d ind_intr, %d not_intr, %d event_intr\n", ks->ind_intr, ks->not_intr, ks->event_intr);
+		kpr_err("         ind bursts: %lld x1, %lld x2-3, %lld x4-7, %lld x8+, %lld at budget\n",
+			s->ind_burst1, s->ind_burst2, s->ind_burst4,
+			s->ind_burst8, s->ind_budget);
+		kpr_err("         not passes: %lld x1, %lld x2-7, %lld x8-31, %lld x32+, %lld ci writebacks\n",
+			s->not_burst1, s->not_burst2, s->not_burst8,
+			s->not_burst32, s->not_ciwb);
+		kpcimgr_report_latency(ks, NOMMU);
+		kpcimgr_report_latency(ks, NORMAL);
+		kpcimgr_report_ports(ks, NOMMU);
+		kpcimgr_report_ports(ks, NORMAL);
+		kpr_err("         events: %ld posted, %ld wakeups, %ld stalls, %ld dropped, %d queued%s, ports held %x\n",
+			ks->evr.prod.posted, ks->evr.prod.wakeups,
+			ks->evr.prod.stalls, ks->evr.prod.drops, evq_count(ks),
+			(ks->evr.prod.mode & EVRING_F_ENABLE) ? " (ring)" : "",
+			ks->evr.prod.pending);
+		pciesvc_logring_stats(&ls);
+		if (ls.posted || ls.eager)
+			kpr_err("         log ring: %lld posted, %lld dropped, %lld eager, %d queued, %d fmts, ~%lld us fmt saved\n",
+				ls.posted, ls.drops, ls.eager, ls.queued,
+				ls.nfmts, ls.fmt_ns_saved / 1000);
+		if (s->serial_tlps)
+			kpr_err("         serial: %lld tlps, %lld tx bytes, %lld.%02lld bytes/tlp\n",
+				s->serial_tlps, s->serial_txbytes,
+				s->serial_txbytes / s->serial_tlps,
+				s->serial_txbytes * 100 / s->serial_tlps % 100);
+		if (s->vnotify_wr)
+			kpr_err("         memwr: %lld virtio notify fast path of %lld\n",
+				s->vnotify_wr, s->ind_memwr);
 	}
 
 	ks->ind_cfgrd = s->ind_cfgrd;
@@ -38,6 +38,7 @@
 #define K_ENTRY_CMD_READ 8
 #define K_ENTRY_CMD_WRITE 9
 #define K_ENTRY_GET_VERSION 10
+#define K_ENTRY_EVRING_CTL 11
 #define K_NUM_ENTRIES 16
 
 struct kpcimgr_entry_points_t {
@@ -57,6 +58,82 @@ struct kpcimgr_entry_points_t {
 #define EVENT_QUEUE_LENGTH 1024
 #define EVENT_SIZE 128
 
+/*
+ * Event ring
+ *
+ * A consumer that understands the ring requests EVRING_F_ENABLE,
+ * after which events are posted through evr rather
+ * than evq_head/evq_tail.  The ring reuses the evq[] slots, with free
+ * running indexes masked by EVENT_QUEUE_LENGTH - 1 so every slot is
+ * usable.  Producer and consumer indexes sit on separate cache lines
+ * and the whole thing lives in kstate, so a consumer can map the
+ * kstate region and read events without a syscall per event.
+ *
+ * Wakeups are coalesced: the consumer is woken once per poll or
+ * interrupt pass, or every EVRING_WAKE_BATCH events in a long pass.
+ *
+ * The consumer asks for a mode through K_ENTRY_EVRING_CTL (or by
+ * writing cons.flags directly), and the producer switches over at the
+ * start of its next pass, once the queue it is leaving has drained.
+ * prod.mode is the mode actually in effect.
+ *
+ * With EVRING_F_BACKPRESSURE set an event that finds the ring full is
+ * stashed per port instead of dropped, the port's bit is set in
+ * prod.pending, and the port is neither polled nor serviced from its
+ * interrupts until its stash has been re-posted at the start of a
+ * later pass.  The host transaction stays in the hardware queue
+ * meanwhile, nothing waits in the servicing path, and the poll timer
+ * is not throttled while any port is held back.
+ *
+ * The stash therefore only has to absorb the rest of the one
+ * pciesvc_poll() or interrupt call that filled the ring.  An indirect
+ * TLP raises at most one event, except a secondary bus reset, which
+ * raises one per function below the bridge (VFs share their PF's).
+ * Notify entries raise one each.  A call drains up to
+ * pciesvc_ind_budget indirect entries plus the notify ring backlog,
+ * so a burst of more than EVRING_NSTASH events behind a full ring is
+ * still dropped and counted in prod.drops.
+ */
+#define EVRING_F_ENABLE		0x1
+#define EVRING_F_BACKPRESSURE	0x2
+#define EVRING_WAKE_BATCH	32
+#define EVRING_MASK		(EVENT_QUEUE_LENGTH - 1)
+#define EVRING_NPORTS		8	/* PCIEHW_NPORTS */
+#define EVRING_NSTASH		16	/* stashed events per port */
+
+_Static_assert((EVENT_QUEUE_LENGTH & EVRING_MASK) == 0,
+	       "event queue length must be a power of 2");
+_Static_assert((EVRING_NSTASH & (EVRING_NSTASH - 1)) == 0,
+	       "event stash depth must be a power of 2");
+
+struct kpcimgr_evstash_t {
+	unsigned char head, tail;	/* free running, masked on use */
+	char ev[EVRING_NSTASH][EVENT_SIZE];
+};
+
+struct kpcimgr_evring_t {
+	/* written by the consumer */
+	struct {
+		unsigned int flags;	/* EVRING_F_* */
+		unsigned int tail;	/* next slot to consume */
+	} cons __attribute__((aligned(64)));
+
+	/* written by the producer */
+	struct {
+		unsigned int head;	/* next slot to fill */
+		unsigned int unwoken;	/* posted since last wakeup */
+		unsigned long posted;	/* events posted */
+		unsigned long wakeups;	/* consumer wakeups */
+		unsigned int mode;	/* EVRING_F_* in effect */
+		unsigned int pending;	/* ports with stashed events */
+		unsigned long stalls;	/* events stashed on a full ring */
+		unsigned long drops;	/* events lost to a full ring */
+	} prod __attribute__((aligned(64)));
+
+	/* producer private, events held back by a full ring */
+	struct kpcimgr_evstash_t stash[EVRING_NPORTS];
+};
+
 /* max command size for sysfs cmd node */
 #define CMD_SIZE 4096
 
@@ -119,12 +196,26 @@ struct kpcimgr_state_t {
 
 	/* offsets into relocated library code */
 	int code_offsets[K_NUM_ENTRIES];
+
+	/* event ring, see above */
+	struct kpcimgr_evring_t evr;
 };
 
 typedef struct kpcimgr_state_t kstate_t;
 _Static_assert(sizeof(kstate_t) < SHMEM_KSTATE_SIZE,
 	       "kstate size insufficient");
 
+/* events waiting for the consumer, in either queue mode */
+static inline int evq_count(kstate_t *k)
+{
+	int n;
+
+	if (k->evr.prod.mode & EVRING_F_ENABLE)
+		return k->evr.prod.head - k->evr.cons.tail;
+	n = k->evq_head - k->evq_tail;
+	return n < 0 ? n + EVENT_QUEUE_LENGTH : n;
+}
+
 /* trace_data[] elements */
 #define FIRST_CALL_TIME 0
 #define FIRST_SEQNUM 1
@@ -136,7 +227,16 @@ _Static_assert(sizeof(kstate_t) < SHMEM_KSTATE_SIZE,
 #define NUM_PENDINGS 7
 #define LAST_CALL_TIME 8
 #define EARLY_POLL 9
-#define MAX_DATA 10
+#define POLL_SKIPS 10		/* idle ticks skipped by adaptive polling */
+#define LAT_HIST 11		/* service latency histogram, log2 usecs */
+#define LAT_HIST_NBUCKETS 12	/* <1us, <2us, ... <1024us, >=1024us */
+#define TRACE_NPORTS 8		/* per port counters, PCIEHW_NPORTS */
+#define PORT_POLLS (LAT_HIST + LAT_HIST_NBUCKETS)	/* pciesvc_poll calls */
+#define PORT_SERVICED (PORT_POLLS + TRACE_NPORTS)	/* calls that did work */
+#define PORT_DEFERRED (PORT_SERVICED + TRACE_NPORTS)	/* left busy at budget or stash */
+#define MAX_DATA (PORT_DEFERRED + TRACE_NPORTS)
+
+_Static_assert(MAX_DATA <= DATA_SIZE, "trace_data elements exceed DATA_SIZE");
 
 #define KPCIMGR_DEV "/dev/kpcimgr"
 #define KPCIMGR_NAME "kpcimgr"
@@ -12,6 +12,9 @@
 #include "pciesvc_impl.h"
 #include "version.h"
 
+static void kpcimgr_event_flush(kstate_t *ks);
+static void kpcimgr_evring_sync(kstate_t *ks);
+
 /*
  * This file contains only functions essential to the
  * operation of the pciesvc library code.
@@ -86,6 +89,142 @@ void kpcimgr_init_poll(kstate_t *ks)
 	pciesvc_init(&p);
 }
 
+/*
+ * Adaptive poll budget
+ *
+ * Each pciesvc_poll() call drains up to pciesvc_ind_budget
+ * indirect entries, and we keep calling while work keeps
+ * showing up, up to poll_budget calls per tick.  If a tick
+ * used the whole budget there is a burst in progress (e.g. the
+ * host enumerating VFs) so let the next tick do more, and decay
+ * back to the minimum once a tick finds little to do.
+ */
+#define POLL_BUDGET_MIN 10
+#define POLL_BUDGET_MAX 160
+
+static int poll_budget = POLL_BUDGET_MIN;
+
+static void kpcimgr_adjust_poll_budget(int used)
+{
+	if (used >= poll_budget) {
+		poll_budget *= 2;
+		if (poll_budget > POLL_BUDGET_MAX)
+			poll_budget = POLL_BUDGET_MAX;
+	} else if (used < poll_budget / 4 && poll_budget > POLL_BUDGET_MIN) {
+		poll_budget /= 2;
+		if (poll_budget < POLL_BUDGET_MIN)
+			poll_budget = POLL_BUDGET_MIN;
+	}
+}
+
+/*
+ * Adaptive poll cadence
+ *
+ * kpcimgr calls us from a fixed rate timer whether or not the host
+ * is doing anything.  Once the port has been idle for a while, only
+ * look at the hardware every poll_interval ticks, doubling the
+ * interval up to POLL_INTERVAL_MAX.  Any work seen drops straight
+ * back to polling on every tick.  The NOMMU phase runs from a
+ * dedicated spin loop during kexec and is never throttled.
+ */
+#define POLL_IDLE_TICKS 100
+#define POLL_INTERVAL_MAX 8
+
+static int poll_idle, poll_interval = 1, poll_skipped;
+
+static int kpcimgr_poll_skip(void)
+{
+	if (poll_interval == 1)
+		return 0;
+	if (++poll_skipped < poll_interval)
+		return 1;
+	poll_skipped = 0;
+	return 0;
+}
+
+static void kpcimgr_adjust_poll_interval(int used)
+{
+	if (used) {
+		poll_idle = 0;
+		poll_interval = 1;
+		poll_skipped = 0;
+	} else if (++poll_idle >= POLL_IDLE_TICKS) {
+		poll_idle = 0;
+		if (poll_interval < POLL_INTERVAL_MAX)
+			poll_interval *= 2;
+	}
+}
+
+/*
+ * Service latency histogram
+ *
+ * Time from entering the poll or interrupt handler until the
+ * completion for a transaction has been written, bucketed by
+ * power of two microseconds into trace_data[phase][LAT_HIST...].
+ */
+static void kpcimgr_record_latency(kstate_t *ks, int phase, long start)
+{
+	unsigned long us = (read_sysreg(cntvct_el0) - start) / TICKS_PER_US;
+	int b = us ? 64 - __builtin_clzl(us) : 0;
+
+	if (b >= LAT_HIST_NBUCKETS)
+		b = LAT_HIST_NBUCKETS - 1;
+	ks->trace_data[phase][LAT_HIST + b]++;
+}
+
+/*
+ * Multi-port servicing
+ *
+ * Every port set up through pciesvc_init() is polled, one
+ * pciesvc_poll() per busy port per round, until all ports are idle
+ * or each has done poll_budget calls worth of work.  The rotation
+ * in pciesvc_poll_round() keeps one port from always going first.
+ * A port still busy at its budget is counted as deferred and picked
+ * up on the next tick.  Returns the most work done by any one port,
+ * which is what the budget adapts to.
+ */
+static int kpcimgr_poll_ports(kstate_t *ks, int phase, long ts)
+{
+	unsigned long *td = ks->trace_data[phase];
+	int res[PCIEHW_NPORTS], served[PCIEHW_NPORTS] = { 0 };
+	u_int32_t busy, worked;
+	int port, used = 0;
+
+	/* ports holding stashed events wait until the ring drains */
+	busy = pciesvc_ports_valid() & ~ks->evr.prod.pending;
+	while (busy) {
+		worked = pciesvc_poll_round(busy, res);
+		for (port = 0; port < PCIEHW_NPORTS; port++) {
+			if (!(busy & (1 << port)))
+				continue;
+			td[PORT_POLLS + port]++;
+			/*
+			 * res[port]:
+			 * >0: valid pending and handled
+			 *  0: nothing pending
+			 * <0: error
+			 */
+			if (res[port] < 0)
+				uart_write_debug(ks, '?');
+			if (!(worked & (1 << port)))
+				continue;
+
+			uart_write_debug(ks, 'h');
+			kpcimgr_record_latency(ks, phase, ts);
+			td[NUM_PENDINGS]++;
+			td[PORT_SERVICED + port]++;
+			if (++served[port] > used)
+				used = served[port];
+			if (served[port] >= poll_budget) {
+				td[PORT_DEFERRED + port]++;
+				worked &= ~(1 << port);
+			}
+		}
+		busy = worked & ~ks->evr.prod.pending;
+	}
+	return used;
+}
+
 /*
  * Main poll function
  *
@@ -95,7 +234,7 @@ void kpcimgr_init_poll(kstate_t *ks)
  */
 void kpcimgr_poll(kstate_t *ks, int index, int phase)
 {
-	int i, result;
+	int used;
 	long ts = read_sysreg(cntvct_el0);
 
 	set_kstate(ks);
@@ -126,6 +265,12 @@ void kpcimgr_poll(kstate_t *ks, int index, int phase)
 		return;
 	}
 
+	/* ports held back by a full ring are only picked up from here */
+	if (phase == NORMAL && !ks->evr.prod.pending && kpcimgr_poll_skip()) {
+		ks->trace_data[phase][POLL_SKIPS]++;
+		return;
+	}
+
 	ks->trace_data[phase][LAST_CALL_TIME] = ts;
 	ks->trace_data[phase][NUM_CHECKS]++;
 
@@ -134,38 +279,42 @@ void kpcimgr_poll(kstate_t *ks, int index, int phase)
 		ks->debug &= ~0x300;
 	}
 
-	for (i=0; i<10; i++) {
-
-		result = pciesvc_poll(0);
-		/*
-		 * return value:
-		 *  1: valid pending and handled
-		 *  0: nothing pending
-		 */
-
-		if (result == 0)
-			break;
-		if (result == -1) {
-			uart_write_debug(ks, '?');
-			break;
-		}
-
-		uart_write_debug(ks, 'h');
-
-		ks->trace_data[phase][NUM_PENDINGS]++;
-	}
+	kpcimgr_evring_sync(ks);
+	used = kpcimgr_poll_ports(ks, phase, ts);
+	kpcimgr_adjust_poll_budget(used);
+	kpcimgr_adjust_poll_interval(used);
+	kpcimgr_event_flush(ks);
 	kpcimgr_report_stats(ks, phase, 0, 0);
 }
 
+/*
+ * A port with stashed events is left alone until the ring drains,
+ * the work stays queued in hardware for the poll that releases it.
+ */
+static int kpcimgr_port_held(kstate_t *ks, int port)
+{
+	if (!(ks->evr.prod.pending & (1 << (port % EVRING_NPORTS))))
+		return 0;
+	ks->trace_data[NORMAL][PORT_DEFERRED + port % TRACE_NPORTS]++;
+	return 1;
+}
+
 /*
  * ISR for Indirect Interrupt
  */
 int kpcimgr_ind_intr(kstate_t *ks, int port)
 {
-	int ret;
+	long ts = read_sysreg(cntvct_el0);
+	int ret = 0;
 
 	set_kstate(ks);
-	ret = pciesvc_indirect_intr(port);
+	kpcimgr_evring_sync(ks);
+	if (!kpcimgr_port_held(ks, port)) {
+		ret = pciesvc_indirect_intr(port);
+		if (ret > 0)
+			kpcimgr_record_latency(ks, NORMAL, ts);
+	}
+	kpcimgr_event_flush(ks);
 	if (ks->debug & 0x300) {
 		trigger_serr(ks->debug & 0x300);
 		ks->debug &= ~0x300;
@@ -179,8 +328,18 @@ int kpcimgr_ind_intr(kstate_t *ks, int port)
  */
 int kpcimgr_not_intr(kstate_t *ks, int port)
 {
+	long ts = read_sysreg(cntvct_el0);
+	int ret = 0;
+
 	set_kstate(ks);
-	return pciesvc_notify_intr(port);
+	kpcimgr_evring_sync(ks);
+	if (!kpcimgr_port_held(ks, port)) {
+		ret = pciesvc_notify_intr(port);
+		if (ret > 0)
+			kpcimgr_record_latency(ks, NORMAL, ts);
+	}
+	kpcimgr_event_flush(ks);
+	return ret;
 }
 
 /*
@@ -274,6 +433,30 @@ pciesvc_reg_wr32(const uint64_t pa, const uint32_t val)
     writel(val, va);
 }
 
+/*
+ * Write n table entries of nw words each, entry i at pa + i * stride,
+ * from the packed array w.  The range is translated once and the
+ * write barrier writel() issues per word is issued once up front.
+ */
+void
+pciesvc_reg_wr32_table(const uint64_t pa, const uint32_t stride,
+                       const uint32_t *w, const uint32_t nw,
+                       const uint32_t n)
+{
+    u_int8_t *va;
+    u_int32_t i, j;
+
+    if (n == 0)
+        return;
+    pciesvc_assert((pa & 0x3) == 0 && (stride & 0x3) == 0);
+    va = kpcimgr_va_get(pa, (n - 1) * stride + nw * 4);
+    __iowmb();
+    for (i = 0; i < n; i++, va += stride, w += nw) {
+        for (j = 0; j < nw; j++)
+            writel_relaxed(w[j], va + j * 4);
+    }
+}
+
 /*
  * Similar calls implemented in terms of rd32/wr32.
  */
@@ -436,6 +619,14 @@ pciesvc_log(const char *msg)
 		kdbg_puts((char *)msg);
 }
 
+u64
+pciesvc_nsecs(void)
+{
+	const u64 t = read_sysreg(cntvct_el0);
+
+	return t / TICKS_PER_US * 1000 + t % TICKS_PER_US * 1000 / TICKS_PER_US;
+}
+
 void wakeup_event_queue(void)
 {
 	kstate_t *ks = get_kstate();
@@ -446,6 +637,144 @@ void wakeup_event_queue(void)
 		upcall(WAKE_UP_EVENT_QUEUE);
 }
 
+/*
+ * Coalesced wakeups
+ *
+ * Events are posted without waking the consumer, which is woken
+ * once at the end of the poll or interrupt pass that posted them
+ * (or every EVRING_WAKE_BATCH events during a long pass).  A storm
+ * of per-VF events from a single NumVFs write then costs a handful
+ * of wakeups instead of one per event.
+ */
+static void kpcimgr_event_wakeup(kstate_t *ks)
+{
+	ks->evr.prod.unwoken = 0;
+	ks->evr.prod.wakeups++;
+	wakeup_event_queue();
+}
+
+static void kpcimgr_event_posted(kstate_t *ks)
+{
+	ks->evr.prod.posted++;
+	if (++ks->evr.prod.unwoken >= EVRING_WAKE_BATCH)
+		kpcimgr_event_wakeup(ks);
+}
+
+static void kpcimgr_event_flush(kstate_t *ks)
+{
+	if (ks->evr.prod.unwoken)
+		kpcimgr_event_wakeup(ks);
+}
+
+/*
+ * Event Ring Handler
+ *
+ * Used once EVRING_F_ENABLE is in effect, see kpcimgr_api.h.
+ * head and tail run freely and are masked on use, the ring is full
+ * when head - tail == EVENT_QUEUE_LENGTH.  The event is copied into
+ * its slot before head is advanced so the consumer never sees a
+ * partially written slot.
+ */
+static int kpcimgr_evring_put(kstate_t *ks, void *evdata)
+{
+	struct kpcimgr_evring_t *evr = &ks->evr;
+	volatile unsigned int *tail = &evr->cons.tail;
+	unsigned int head = evr->prod.head;
+
+	if (head - *tail >= EVENT_QUEUE_LENGTH)
+		return -1;
+
+	pciesvc_memcpy_toio((void *)ks->evq[head & EVRING_MASK], evdata,
+			    sizeof(pciesvc_eventdata_t));
+	pciesvc_mem_barrier();
+	evr->prod.head = head + 1;
+	kpcimgr_event_posted(ks);
+	return 0;
+}
+
+static int kpcimgr_evring_post(kstate_t *ks, pciesvc_eventdata_t *evdata)
+{
+	struct kpcimgr_evring_t *evr = &ks->evr;
+	int port = evdata->port % EVRING_NPORTS;
+	struct kpcimgr_evstash_t *st = &evr->stash[port];
+
+	/* a stalled port's events stay behind the ones it already stashed */
+	if (!(evr->prod.pending & (1 << port)) &&
+	    kpcimgr_evring_put(ks, evdata) == 0)
+		return 0;
+
+	/* the consumer can't make room if it is asleep */
+	kpcimgr_event_wakeup(ks);
+
+	if (!(evr->prod.mode & EVRING_F_BACKPRESSURE) ||
+	    (unsigned char)(st->head - st->tail) >= EVRING_NSTASH) {
+		evr->prod.drops++;
+		return -1;
+	}
+
+	pciesvc_memcpy(st->ev[st->head % EVRING_NSTASH], evdata,
+		       sizeof(pciesvc_eventdata_t));
+	st->head++;
+	evr->prod.pending |= 1 << port;
+	evr->prod.stalls++;
+	return 0;
+}
+
+/*
+ * Start of a poll or interrupt pass
+ *
+ * Re-post events stashed by stalled ports, oldest first, and release
+ * each port whose stash empties so kpcimgr_poll_ports() services it
+ * again.  Then apply a mode change requested in cons.flags, which
+ * waits until the queue being left is empty so no event is stranded.
+ */
+static void kpcimgr_evring_sync(kstate_t *ks)
+{
+	struct kpcimgr_evring_t *evr = &ks->evr;
+	unsigned int want = evr->cons.flags & (EVRING_F_ENABLE |
+					       EVRING_F_BACKPRESSURE);
+	int port;
+
+	for (port = 0; evr->prod.pending && port < EVRING_NPORTS; port++) {
+		struct kpcimgr_evstash_t *st = &evr->stash[port];
+
+		if (!(evr->prod.pending & (1 << port)))
+			continue;
+		while (st->tail != st->head &&
+		       kpcimgr_evring_put(ks, st->ev[st->tail % EVRING_NSTASH]) == 0)
+			st->tail++;
+		if (st->tail == st->head)
+			evr->prod.pending &= ~(1 << port);
+	}
+
+	if (want == evr->prod.mode)
+		return;
+
+	if ((want ^ evr->prod.mode) & EVRING_F_ENABLE) {
+		if (evr->prod.mode & EVRING_F_ENABLE) {
+			if (evr->prod.head != evr->cons.tail || evr->prod.pending)
+				return;
+		} else {
+			if (ks->evq_head != ks->evq_tail)
+				return;
+			evr->prod.head = evr->cons.tail;
+		}
+	}
+	evr->prod.mode = want;
+}
+
+/*
+ * Request an event queue mode, K_ENTRY_EVRING_CTL
+ *
+ * Returns the mode currently in effect, the request itself takes hold
+ * at the start of the next pass that finds the old queue drained.
+ */
+int kpcimgr_evring_ctl(kstate_t *ks, unsigned int flags)
+{
+	ks->evr.cons.flags = flags & (EVRING_F_ENABLE | EVRING_F_BACKPRESSURE);
+	return ks->evr.prod.mode;
+}
+
 /*
  * Event Queue Handler
  *
@@ -473,10 +802,15 @@ int pciesvc_event_handler(pciesvc_eventdata_t *evdata, const size_t evsize)
 		return -1;
 	}
 
+	if (ks->evr.prod.mode & EVRING_F_ENABLE)
+		return kpcimgr_evring_post(ks, evdata);
+
 	if ((ks->evq_head + 1) % EVENT_QUEUE_LENGTH == ks->evq_tail) {
 		if (!was_full)
 			pciesvc_log(KERN_INFO "pciesvc_event_handler: event queue full\n");
 		was_full = 1;
+		ks->evr.prod.drops++;
+		kpcimgr_event_wakeup(ks);
 		return -1;
 	}
 	was_full = 0;
@@ -490,7 +824,7 @@ int pciesvc_event_handler(pciesvc_eventdata_t *evdata, const size_t evsize)
 	pciesvc_memcpy_toio((void *)ks->evq[ks->evq_head], evdata, sizeof(pciesvc_eventdata_t));
 
 	ks->evq_head = (ks->evq_head + 1) % EVENT_QUEUE_LENGTH;
-	wakeup_event_queue();
+	kpcimgr_event_posted(ks);
 	return ret;
 }
 
@@ -53,4 +53,34 @@ PCIEMGR_STATS_DEF(ind_unknown)
 
 PCIEMGR_STATS_DEF(healthlog)
 
+/* indirect entries drained per pass, and passes that hit the budget */
+PCIEMGR_STATS_DEF(ind_burst1)
+PCIEMGR_STATS_DEF(ind_burst2)
+PCIEMGR_STATS_DEF(ind_burst4)
+PCIEMGR_STATS_DEF(ind_burst8)
+PCIEMGR_STATS_DEF(ind_budget)
+
+/* pmt allocator (port 0 only): in use, on free lists, reused runs, fails */
+PCIEMGR_STATS_DEF(pmt_inuse)
+PCIEMGR_STATS_DEF(pmt_freelist)
+PCIEMGR_STATS_DEF(pmt_reuse)
+PCIEMGR_STATS_DEF(pmt_allocfail)
+
+/* ind_cfgrd answered straight from cfgcur */
+PCIEMGR_STATS_DEF(ind_cfgrd_fast)
+
+/* serial bar tlps serviced, and console bytes they carried */
+PCIEMGR_STATS_DEF(serial_tlps)
+PCIEMGR_STATS_DEF(serial_txbytes)
+
+/* notify entries per pass (1, 2-7, 8-31, 32+), mid-pass ci writebacks */
+PCIEMGR_STATS_DEF(not_burst1)
+PCIEMGR_STATS_DEF(not_burst2)
+PCIEMGR_STATS_DEF(not_burst8)
+PCIEMGR_STATS_DEF(not_burst32)
+PCIEMGR_STATS_DEF(not_ciwb)
+
+/* ind memwr completed by the virtio queue notify fast path */
+PCIEMGR_STATS_DEF(vnotify_wr)
+
 #undef PCIEMGR_STATS_DEF
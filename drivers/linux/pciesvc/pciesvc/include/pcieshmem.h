@@ -122,6 +122,8 @@ typedef union pciehwdev_u {
         u_int32_t pmtb;                 /* pmt base  for cfg */
         u_int32_t pmtc;                 /* pmt count for cfg */
         ovrdintr_t ovrdintr[NOVRDINTR]; /* override intr resources */
+        u_int64_t vnotify_pa;           /* queue_notify fast path pa, 0=off */
+        u_int8_t vnotify_cfgidx;        /* bar with queue_notify */
     };
     u_int8_t _pad[4096];
 } pciehwdev_t;
@@ -130,6 +132,7 @@ typedef union pciehw_port_u {
     struct {
         u_int8_t secbus;                /* bridge secondary bus */
         pciemgr_stats_t stats;
+        u_int32_t pmt_nfree;            /* port 0: pmts on the free lists */
     };
     u_int8_t _pad[1024];
 } pciehw_port_t;
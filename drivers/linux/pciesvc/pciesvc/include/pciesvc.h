@@ -52,10 +52,21 @@ void pciesvc_shut(const int port);
  * Return value:
  *     <0 error
  *     =0 no work done
- *     >0 work done
+ *     >0 work done, indirect entries serviced (up to
+ *        pciesvc_ind_budget) plus 1 if notify work was done
  */
 int pciesvc_poll(const int port);
 
+/*
+ * Multi-port polling.  pciesvc_ports_valid() returns a bitmask of
+ * the ports set up with pciesvc_init().  pciesvc_poll_round() calls
+ * pciesvc_poll() once on each port in mask, in rotating order, and
+ * leaves each result in res[port] (res has PCIEHW_NPORTS entries).
+ * Returns the mask of ports that did work.
+ */
+u_int32_t pciesvc_ports_valid(void);
+u_int32_t pciesvc_poll_round(const u_int32_t mask, int *res);
+
 int pciesvc_indirect_poll_init(const int port);
 int pciesvc_indirect_poll(const int port);
 int pciesvc_indirect_intr_init(const int port,
@@ -78,6 +89,15 @@ void pciesvc_get_version(int *maj, int *min);
 
 extern pciesvc_logpri_t pciesvc_log_level;
 
+/*
+ * Indirect entries serviced per poll/intr before returning.
+ * The hw has 16 indirect entries per port.
+ */
+#define PCIESVC_IND_BUDGET      16
+#define PCIESVC_IND_BUDGET_MAX  1024
+
+extern int pciesvc_ind_budget;
+
 #ifdef __cplusplus
 }
 #endif
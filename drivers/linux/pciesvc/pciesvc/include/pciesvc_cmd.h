@@ -16,11 +16,19 @@ extern "C" {
 typedef enum pciesvc_cmdcode_e {
     PCIESVC_CMD_NOP                     = 0,
     PCIESVC_CMD_SET_LOG_LEVEL           = 1,
+    PCIESVC_CMD_SET_IND_BUDGET          = 2,
+    PCIESVC_CMD_SET_LOG_RING            = 3,
+    PCIESVC_CMD_LOG_READ                = 4,
+    PCIESVC_CMD_LOG_FMT                 = 5,
+    PCIESVC_CMD_LOG_STATS               = 6,
+    PCIESVC_CMD_SET_BAR_PROF            = 7,
+    PCIESVC_CMD_BAR_PROF_READ           = 8,
 } pciesvc_cmdcode_t;
 
 typedef enum pciesvc_cmdstatus_e {
     PCIESVC_CMDSTATUS_SUCCESS           = 0,
     PCIESVC_CMDSTATUS_UNKNOWN_CMD       = 1,
+    PCIESVC_CMDSTATUS_INVALID_ARG       = 2,
 } pciesvc_cmdstatus_t;
 
 typedef struct pciesvc_cmd_nop_s {
@@ -41,11 +49,145 @@ typedef struct pciesvc_cmdres_set_log_level_s {
     uint32_t old_level;
 } pciesvc_cmdres_set_log_level_t;
 
+typedef struct pciesvc_cmd_set_ind_budget_s {
+    uint32_t cmd;
+    uint32_t budget;                    /* 0 = default */
+} pciesvc_cmd_set_ind_budget_t;
+
+typedef struct pciesvc_cmdres_set_ind_budget_s {
+    uint32_t status;
+    uint32_t old_budget;
+} pciesvc_cmdres_set_ind_budget_t;
+
+/*
+ * Binary log ring.  With the ring enabled log messages are stored
+ * as a format id and raw args instead of being formatted into an
+ * EV_LOGMSG event.  The consumer reads one record per LOG_READ,
+ * fetches the format string for a fmtid with LOG_FMT (in chunks
+ * of up to 56 bytes from off) and formats the record itself:
+ * numeric conversions take args[] in order, the one %s takes str.
+ */
+#define PCIESVC_LOGREC_NARGS    3
+#define PCIESVC_LOGREC_STRSZ    24
+
+typedef struct pciesvc_logrec_s {
+    uint32_t seq;                       /* record sequence number */
+    uint16_t fmtid;                     /* format id for LOG_FMT */
+    uint8_t pri;                        /* PCIESVC_LOGPRI_* */
+    uint8_t nargs;                      /* valid args[] */
+    uint64_t args[PCIESVC_LOGREC_NARGS];/* numeric args, in order */
+    char str[PCIESVC_LOGREC_STRSZ];     /* %s arg, NULL-terminated */
+} pciesvc_logrec_t;
+
+typedef struct pciesvc_log_stats_s {
+    uint64_t posted;                    /* records stored in the ring */
+    uint64_t drops;                     /* records lost to a full ring */
+    uint64_t eager;                     /* msgs formatted, not ring-able */
+    uint64_t fmt_ns_saved;              /* est. formatting time not spent */
+    uint64_t fmt_ns;                    /* est. ns to format one msg */
+    uint32_t nfmts;                     /* format ids assigned */
+    uint32_t queued;                    /* records waiting to be read */
+} pciesvc_log_stats_t;
+
+typedef struct pciesvc_cmd_set_log_ring_s {
+    uint32_t cmd;
+    uint32_t enable;
+} pciesvc_cmd_set_log_ring_t;
+
+typedef struct pciesvc_cmdres_set_log_ring_s {
+    uint32_t status;
+    uint32_t old_enable;
+} pciesvc_cmdres_set_log_ring_t;
+
+typedef struct pciesvc_cmd_log_read_s {
+    uint32_t cmd;
+} pciesvc_cmd_log_read_t;
+
+typedef struct pciesvc_cmdres_log_read_s {
+    uint32_t status;
+    uint32_t valid;                     /* 0 = ring empty */
+    pciesvc_logrec_t rec;
+} pciesvc_cmdres_log_read_t;
+
+typedef struct pciesvc_cmd_log_fmt_s {
+    uint32_t cmd;
+    uint32_t fmtid;
+    uint32_t off;                       /* offset into format string */
+} pciesvc_cmd_log_fmt_t;
+
+typedef struct pciesvc_cmdres_log_fmt_s {
+    uint32_t status;
+    uint32_t len;                       /* full format string length */
+    char fmt[56];                       /* from off, NULL-terminated */
+} pciesvc_cmdres_log_fmt_t;
+
+typedef struct pciesvc_cmd_log_stats_s {
+    uint32_t cmd;
+} pciesvc_cmd_log_stats_t;
+
+typedef struct pciesvc_cmdres_log_stats_s {
+    uint32_t status;
+    uint32_t _pad;
+    pciesvc_log_stats_t stats;
+} pciesvc_cmdres_log_stats_t;
+
+/*
+ * Bar access profile.  While enabled every bar read/write handled
+ * by software in the indirect path is counted by (device, bar,
+ * offset, size, direction), for one device or for all devices if
+ * hwdevh is 0.  BAR_PROF_READ returns the first used entry at or
+ * after table slot idx, and the slot to continue from in next.
+ */
+typedef struct pciesvc_barprof_ent_s {
+    uint64_t count;                     /* accesses */
+    uint32_t baroff;                    /* offset within the bar */
+    uint16_t hwdevh;                    /* device */
+    uint16_t size;                      /* access size in bytes */
+    uint8_t cfgidx;                     /* config bar index (0-5) */
+    uint8_t wr;                         /* 0 = read, 1 = write */
+    uint8_t _pad[6];
+} pciesvc_barprof_ent_t;
+
+typedef struct pciesvc_cmd_set_bar_prof_s {
+    uint32_t cmd;
+    uint32_t enable;
+    uint32_t hwdevh;                    /* profile only this dev, 0=all */
+    uint32_t clear;                     /* clear the table */
+} pciesvc_cmd_set_bar_prof_t;
+
+typedef struct pciesvc_cmdres_set_bar_prof_s {
+    uint32_t status;
+    uint32_t old_enable;
+    uint32_t nents;                     /* table entries in use */
+    uint32_t nslots;                    /* table size */
+    uint64_t full;                      /* accesses lost to a full table */
+} pciesvc_cmdres_set_bar_prof_t;
+
+typedef struct pciesvc_cmd_bar_prof_read_s {
+    uint32_t cmd;
+    uint32_t idx;                       /* table slot to start from */
+} pciesvc_cmd_bar_prof_read_t;
+
+typedef struct pciesvc_cmdres_bar_prof_read_s {
+    uint32_t status;
+    uint32_t valid;                     /* 0 = no more entries */
+    uint32_t next;                      /* idx for the next read */
+    uint32_t _pad;
+    pciesvc_barprof_ent_t ent;
+} pciesvc_cmdres_bar_prof_read_t;
+
 typedef union pciesvc_cmd_u {
     uint32_t words[16];
     uint8_t cmd;
     pciesvc_cmd_nop_t nop;
     pciesvc_cmd_set_log_level_t set_log_level;
+    pciesvc_cmd_set_ind_budget_t set_ind_budget;
+    pciesvc_cmd_set_log_ring_t set_log_ring;
+    pciesvc_cmd_log_read_t log_read;
+    pciesvc_cmd_log_fmt_t log_fmt;
+    pciesvc_cmd_log_stats_t log_stats;
+    pciesvc_cmd_set_bar_prof_t set_bar_prof;
+    pciesvc_cmd_bar_prof_read_t bar_prof_read;
 } pciesvc_cmd_t;
 
 typedef union pciesvc_cmdres_u {
@@ -53,6 +195,13 @@ typedef union pciesvc_cmdres_u {
     uint8_t status;
     pciesvc_cmdres_nop_t nop;
     pciesvc_cmdres_set_log_level_t set_log_level;
+    pciesvc_cmdres_set_ind_budget_t set_ind_budget;
+    pciesvc_cmdres_set_log_ring_t set_log_ring;
+    pciesvc_cmdres_log_read_t log_read;
+    pciesvc_cmdres_log_fmt_t log_fmt;
+    pciesvc_cmdres_log_stats_t log_stats;
+    pciesvc_cmdres_set_bar_prof_t set_bar_prof;
+    pciesvc_cmdres_bar_prof_read_t bar_prof_read;
 } pciesvc_cmdres_t;
 
 #ifdef __cplusplus
@@ -48,6 +48,8 @@ typedef struct pcie_stlp_s {
 
 int pcietlp_decode(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz);
 int pcietlp_encode(const pcie_stlp_t *stlp, void *rtlp, const size_t rtlpsz);
+u_int32_t pcietlp_wrdata32(const void *rtlp, const u_int64_t pa,
+                           const u_int32_t size);
 char *pcietlp_get_error(void);
 char *pcietlp_buf(const pcie_stlp_t *stlp, void *buf, const size_t bufsz);
 char *pcietlp_str(const pcie_stlp_t *stlp);
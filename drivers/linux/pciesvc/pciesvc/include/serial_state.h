@@ -16,15 +16,41 @@ typedef struct memq {
     char buf[MEMQ_BUFSZ] __attribute__((aligned(64)));
 } memq_t;
 
+/*
+ * Larger tx queue for bulk console output, used instead of txq
+ * once seriald sets bulk_en to say it drains it.  Fits in the
+ * serial_state pad so the shmem layout is unchanged.
+ */
+#define BULKQ_BUFSZ   256
+
+typedef struct bulkq {
+    unsigned int pidx    __attribute__((aligned(64)));
+    unsigned int cidx    __attribute__((aligned(64)));
+    char buf[BULKQ_BUFSZ] __attribute__((aligned(64)));
+} bulkq_t;
+
+/*
+ * Bulk registers above the 16550 block.  A 1-8 byte write to
+ * SERIAL_BULK_TX queues that many bytes, so one tlp carries up to
+ * 8 bytes instead of 1 through THR.  SERIAL_BULK_STATUS reads the
+ * free space in the tx queue, with SERIAL_BULK_STATUS_EN set when
+ * the bulk queue is in use.
+ */
+#define SERIAL_BULK_TX          0x10
+#define SERIAL_BULK_STATUS      0x18
+#define SERIAL_BULK_STATUS_EN   0x80000000
+
 typedef struct serial_state {
     u_int32_t intrb;            /* intr resource base */
     u_int32_t intrc;            /* intr resource count */
     u_int32_t gen;              /* generation number */
     u_int32_t gen_ack;          /* generation number ack */
     u_int32_t breakreq;         /* break request */
-    u_int32_t _unused[11];
+    u_int32_t bulk_en;          /* seriald drains bulktxq */
+    u_int32_t _unused[10];
     memq_t txq;                 /* txq from device thr */
     memq_t rxq;                 /* rxq to   device rbr */
+    bulkq_t bulktxq;            /* txq when bulk_en */
 } serial_state_t;
 
 typedef struct serial_uart_state {
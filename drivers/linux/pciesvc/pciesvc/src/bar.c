@@ -48,6 +48,9 @@ pciehw_bar_load(pciehwdev_t *phwdev, pciehwbar_t *phwbar)
 #endif
         phwbar->bdf = pciehwdev_get_hostbdf(phwdev);
         pciehw_bar_load_pmts(phwbar);
+        if (phwbar->hnd == PCIEHW_BARHND_VIRTIO) {
+            virtio_notify_load(phwdev, phwbar);
+        }
         phwbar->loaded = 1;
     }
 }
@@ -63,6 +66,7 @@ pciehw_bar_unload(pciehwdev_t *phwdev, pciehwbar_t *phwbar)
                          phwbar->cfgidx, phwbar->pmtb);
         pciehwdev_put(phwdev, CLEAN);
 #endif
+        virtio_notify_unload(phwdev, phwbar);
         pciehw_bar_unload_pmts(phwbar);
         phwbar->loaded = 0;
     }
@@ -138,6 +142,116 @@ pciehw_barwr_notify(const int port, notify_entry_t *nentry)
     pciesvc_spmt_put(spmt, CLEAN);
 }
 
+/*
+ * Bar access profile
+ *
+ * Counts software handled bar accesses by (hwdevh, bar, offset,
+ * size, direction) so the registers the host hits hardest can be
+ * found and moved to hw handled pmts or cached.  Open addressed
+ * table, an access that finds no slot within BARPROF_PROBES is
+ * counted in full.  Disabled, the cost is the test of barprof.on
+ * in the indirect handlers.
+ */
+#define BARPROF_NSLOTS  512
+#define BARPROF_PROBES  8
+
+typedef struct barprof_s {
+    u_int32_t on;
+    pciehwdevh_t hwdevh;                /* profile this dev, 0=all */
+    u_int32_t nents;
+    u_int64_t full;
+    pciesvc_barprof_ent_t ent[BARPROF_NSLOTS];
+} barprof_t;
+
+static barprof_t barprof;
+
+static void
+barprof_record(const pciehwdev_t *phwdev, const pciehwbar_t *phwbar,
+               const indirect_entry_t *ientry, const int wr)
+{
+    barprof_t *bp = &barprof;
+    const pciehwdevh_t hwdevh = pciehwdev_geth(phwdev);
+    const u_int16_t size = ientry->info.direct_size;
+    pcie_stlp_t stlpbuf, *stlp = &stlpbuf;
+    pciesvc_barprof_ent_t *e;
+    u_int32_t baroff, h;
+    int i;
+
+    if (bp->hwdevh && bp->hwdevh != hwdevh) {
+        return;
+    }
+    pcietlp_decode(stlp, ientry->rtlp, sizeof(ientry->rtlp));
+    baroff = stlp->addr - phwbar->addr;
+
+    h = (hwdevh << 16) ^ (phwbar->cfgidx << 13) ^ baroff ^ (size << 10);
+    h = ((h * 0x9e3779b1) >> 23) ^ wr;
+    for (i = 0; i < BARPROF_PROBES; i++) {
+        e = &bp->ent[(h + i) & (BARPROF_NSLOTS - 1)];
+        if (e->count == 0) {
+            e->baroff = baroff;
+            e->hwdevh = hwdevh;
+            e->cfgidx = phwbar->cfgidx;
+            e->size = size;
+            e->wr = wr;
+            e->count = 1;
+            bp->nents++;
+            return;
+        }
+        if (e->baroff == baroff && e->hwdevh == hwdevh &&
+            e->cfgidx == phwbar->cfgidx && e->size == size && e->wr == wr) {
+            e->count++;
+            return;
+        }
+    }
+    bp->full++;
+}
+
+int
+pciehw_barprof_enable(const int on, const pciehwdevh_t hwdevh,
+                      const int clear)
+{
+    barprof_t *bp = &barprof;
+    const int old = bp->on;
+
+    if (clear) {
+        pciesvc_memset(bp->ent, 0, sizeof(bp->ent));
+        bp->nents = 0;
+        bp->full = 0;
+    }
+    bp->hwdevh = hwdevh;
+    bp->on = on;
+    return old;
+}
+
+void
+pciehw_barprof_stats(u_int32_t *nents, u_int32_t *nslots, u_int64_t *full)
+{
+    barprof_t *bp = &barprof;
+
+    *nents = bp->nents;
+    *nslots = BARPROF_NSLOTS;
+    *full = bp->full;
+}
+
+/*
+ * Return the slot after the first used entry at or after idx,
+ * 0 if there are no more.
+ */
+int
+pciehw_barprof_read(const u_int32_t idx, pciesvc_barprof_ent_t *ent)
+{
+    barprof_t *bp = &barprof;
+    u_int32_t i;
+
+    for (i = idx; i < BARPROF_NSLOTS; i++) {
+        if (bp->ent[i].count) {
+            *ent = bp->ent[i];
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
 void
 pciehw_barrd_indirect(const int port, indirect_entry_t *ientry)
 {
@@ -186,13 +300,50 @@ pciehw_barrd_indirect(const int port, indirect_entry_t *ientry)
         break;
     }
     }
+    if (__builtin_expect(barprof.on, 0)) {
+        barprof_record(phwdev, phwbar, ientry, 0);
+    }
     pciehwdev_put(phwdev, CLEAN);
     pciesvc_spmt_put(spmt, CLEAN);
 
     pciehw_indirect_complete(ientry);
 }
 
-void
+/*
+ * Virtio queue notify fast path, see virtio_notify_load().
+ * Returns 1 if the write was completed here.
+ */
+static int
+barwr_vnotify(const int port, pciehwdev_t *phwdev,
+              const pciehwbar_t *phwbar, const indirect_entry_t *ientry,
+              const pciehw_spmt_t *spmt)
+{
+    const tlpauxinfo_t *info = &ientry->info;
+    pcie_stlp_t stlp;
+    u_int16_t q;
+
+    if (info->direct_size != sizeof(q) ||
+        phwbar->cfgidx != phwdev->vnotify_cfgidx) {
+        return 0;
+    }
+    q = pcietlp_wrdata32(ientry->rtlp, info->direct_addr, sizeof(q));
+    pciesvc_mem_wr(info->direct_addr, &q, sizeof(q));
+
+    /* the event carries the same fields the full decode would give */
+    pciesvc_memset(&stlp, 0, sizeof(stlp));
+    stlp.type = PCIE_STLP_MEMWR;
+    stlp.addr = phwbar->addr + virtio_notify_baroff();
+    stlp.size = sizeof(q);
+    stlp.data = q;
+    pciehw_barrw_notify(PCIESVC_EV_MEMWR_NOTIFY,
+                        port, phwdev, &stlp, info, spmt);
+    return 1;
+}
+
+/*
+ * Returns 1 if the write took the virtio notify fast path.
+ */
+int
 pciehw_barwr_indirect(const int port, indirect_entry_t *ientry)
 {
     const tlpauxinfo_t *info = &ientry->info;
@@ -200,6 +351,13 @@ pciehw_barwr_indirect(const int port, indirect_entry_t *ientry)
     pciehwdev_t *phwdev = pciehwdev_get(spmt->owner + info->vfid);
     const pciehwbar_t *phwbar = pciehw_bar_get(phwdev, spmt->cfgidx);
     pcie_stlp_t stlpbuf, *stlp = &stlpbuf;
+    int fast = 0;
+
+    if (info->direct_addr == phwdev->vnotify_pa &&
+        barwr_vnotify(port, phwdev, phwbar, ientry, spmt)) {
+        fast = 1;
+        goto done;
+    }
 
     pcietlp_decode(stlp, ientry->rtlp, sizeof(ientry->rtlp));
 
@@ -237,8 +395,13 @@ pciehw_barwr_indirect(const int port, indirect_entry_t *ientry)
         break;
     }
     }
+done:
+    if (__builtin_expect(barprof.on, 0)) {
+        barprof_record(phwdev, phwbar, ientry, 1);
+    }
     pciehwdev_put(phwdev, CLEAN);
     pciesvc_spmt_put(spmt, CLEAN);
 
     pciehw_indirect_complete(ientry);
+    return fast;
 }
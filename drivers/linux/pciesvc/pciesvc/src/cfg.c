@@ -655,27 +655,15 @@ pciehw_sriov_adjust_vf0(pciehwdev_t *vfhwdev, const int numvfs)
 }
 
 /*
- * Enable this VF.  Make it visible on the PCIe bus in cfg space,
- * and enable bars too if Memory Space Enable (mse) is set.
+ * Enable VFs [0-numvfs).  Make them visible on the PCIe bus in cfg space,
+ * and enable bars too if Memory Space Enable (mse) is set.  The bars of
+ * all the VFs are programmed together, see pciehw_vfs_load_bars().
  */
-static void
-pciehw_sriov_enable_vf(pciehwdev_t *vfhwdev, const int mse)
-{
-    u_int16_t cmd;
-
-    /* XXX handle vfe load/unload cfg space */
-    /* refactor and call pciehw_cfg_load(vfhwdev) */
-
-    /* load/unload the bars */
-    cmd = mse ? PCI_COMMAND_MEMORY : 0;
-    pciehw_cfg_bars_enable(vfhwdev, cmd);
-}
-
 static void
 pciehw_sriov_enable_vfs(pciehwdev_t *phwdev, const int numvfs, const int mse)
 {
     pciehwdev_t *vfhwdev;
-    int vfidx, r;
+    int r;
 
     vfhwdev = pciehwdev_vfdev_get(phwdev, 0);
     r = pciehw_sriov_adjust_vf0(vfhwdev, numvfs);
@@ -686,21 +674,15 @@ pciehw_sriov_enable_vfs(pciehwdev_t *phwdev, const int numvfs, const int mse)
         return;
     }
 
-    for (vfidx = 0; vfidx < numvfs; vfidx++) {
-        vfhwdev = pciehwdev_vfdev_get(phwdev, vfidx);
-        pciehw_sriov_enable_vf(vfhwdev, mse);
-        pciehwdev_vfdev_put(vfhwdev, DIRTY); /* bdf */
-    }
-}
-
-static void
-pciehw_sriov_disable_vf(pciehwdev_t *vfhwdev)
-{
-    const u_int16_t cmd = 0;
-    pciehw_cfg_bars_enable(vfhwdev, cmd);
-
     /* XXX handle vfe load/unload cfg space */
-    /* refactor and call pciehw_cfg_unload(vfhwdev) */
+    /* refactor and call pciehw_cfg_load(vfhwdev) */
+
+    /* load/unload the bars */
+    if (mse) {
+        pciehw_vfs_load_bars(phwdev, 0, numvfs);
+    } else {
+        pciehw_vfs_unload_bars(phwdev, 0, numvfs);
+    }
 }
 
 /*
@@ -710,13 +692,11 @@ pciehw_sriov_disable_vf(pciehwdev_t *vfhwdev)
 static void
 pciehw_sriov_disable_vfs(pciehwdev_t *phwdev, const int vfb, const int vfc)
 {
-    int vfidx;
+    pciehw_vfs_unload_bars(phwdev, vfb, vfc);
+
+    /* XXX handle vfe load/unload cfg space */
+    /* refactor and call pciehw_cfg_unload(vfhwdev) */
 
-    for (vfidx = vfb; vfidx < vfb + vfc; vfidx++) {
-        pciehwdev_t *vfhwdev = pciehwdev_vfdev_get(phwdev, vfidx);
-        pciehw_sriov_disable_vf(vfhwdev);
-        pciehwdev_vfdev_put(vfhwdev, DIRTY);
-    }
     /* Park disabled vf's in reset state. */
     pciehw_reset_vfs(phwdev, vfb, vfc);
 }
@@ -844,6 +824,16 @@ pciehw_cfgwr_sriov_bars(const handler_ctx_t *hctx)
  * cfg handlers
  */
 
+/*
+ * Does pciehw_cfgrd_handler() do anything for this handler?
+ * Keep in sync with the switch below.
+ */
+static int
+pciehw_cfgrd_has_handler(const pciehw_cfghnd_t hnd)
+{
+    return hnd == PCIEHW_CFGHND_DBG_DELAY;
+}
+
 static void
 pciehw_cfgrd_handler(handler_ctx_t *hctx)
 {
@@ -951,8 +941,41 @@ pciehw_cfgwr_notify(const int port, notify_entry_t *nentry)
  * indirect handlers
  */
 
+/*
+ * Most config reads are aligned dwords of registers with no read
+ * handler.  Answer those with a single 32-bit load from the cfgcur
+ * shadow, skipping the byte-wise cfgspace_read() and the device
+ * get/put to look up the handler.  Returns 0 if the read was done.
+ */
+static int
+pciehw_cfgrd_fast(const pciehwdevh_t hwdevh, const pcie_stlp_t *stlp,
+                  u_int32_t *valp)
+{
+    pciehw_shmem_t *pshmem = pciesvc_shmem_get();
+    pciehw_mem_t *phwmem = pciesvc_hwmem_get();
+    const u_int16_t reg = stlp->addr;
+    const pciehwdev_t *phwdev;
+    u_int8_t *cur;
+
+    if (stlp->size != 4 || (reg & 0x3) != 0 || reg >= PCIEHW_CFGSZ) {
+        return -1;
+    }
+    if (hwdevh == 0 || hwdevh >= PSHMEM_NDEVS(pshmem)) {
+        return -1;
+    }
+    phwdev = PSHMEM_ADDR_FIELD(pshmem, dev[hwdevh]);
+    if (pciehw_cfgrd_has_handler(phwdev->cfghnd[reg >> 2])) {
+        return -1;
+    }
+
+    cur = PHWMEM_DATA_FIELD(phwmem, pshmem, cfgcur[hwdevh]);
+    *valp = *(volatile u_int32_t *)&cur[reg];
+    return 0;
+}
+
 void
-pciehw_cfgrd_indirect(const int port, indirect_entry_t *ientry)
+pciehw_cfgrd_indirect(const int port, pciehw_port_t *p,
+                      indirect_entry_t *ientry)
 {
     handler_ctx_t hctx;
     cfgspace_t cs;
@@ -963,6 +986,12 @@ pciehw_cfgrd_indirect(const int port, indirect_entry_t *ientry)
     hctx.hwdevh = cfgpa_to_hwdevh(ientry->info.direct_addr);
     pcietlp_decode(&hctx.stlp, ientry->rtlp, sizeof(ientry->rtlp));
 
+    if (pciehw_cfgrd_fast(hctx.hwdevh, &hctx.stlp, &ientry->data[0]) == 0) {
+        p->stats.ind_cfgrd_fast++;
+        pciehw_indirect_complete(ientry);
+        return;
+    }
+
     /*
      * For indirect reads read the current value at target addr
      * and put in retval.  The handler has a chance to modify
@@ -1087,3 +1116,24 @@ pciehw_cfg_reset(pciehwdev_t *phwdev, const pciesvc_rsttype_t rsttype)
         pciesvc_cfgspace_put(&cs, DIRTY);
     }
 }
+
+/*
+ * VF range reset (see pciehw_reset_vfs()).  A VF has no bar, rombar
+ * or intx state behind cmd, no bridge header and no sriov capability,
+ * so all that is left of pciehw_cfg_reset() is restoring its reset
+ * image.  The busmaster side effect of the reset cmd is left to the
+ * caller so it can be coalesced across VFs.  Returns the reset value
+ * of cmd.
+ */
+u_int16_t
+pciehw_cfg_reset_vf(pciehwdev_t *vfhwdev)
+{
+    cfgspace_t cs;
+    u_int16_t cmd;
+
+    pciesvc_cfgspace_get(pciehwdev_geth(vfhwdev), &cs);
+    pciesvc_memcpy_toio(cs.cur, cs.rst, cfgspace_size(&cs));
+    cmd = cfgspace_readw(&cs, PCI_COMMAND);
+    pciesvc_cfgspace_put(&cs, DIRTY);
+    return cmd;
+}
@@ -4,6 +4,7 @@
  */
 
 #include "pciesvc_impl.h"
+#include "log.h"
 
 static pciesvc_cmdres_t resbuf;
 
@@ -25,6 +26,90 @@ cmd_set_log_level(const pciesvc_cmd_set_log_level_t *cmd,
     return 0;
 }
 
+static int
+cmd_set_ind_budget(const pciesvc_cmd_set_ind_budget_t *cmd,
+                   pciesvc_cmdres_set_ind_budget_t *res)
+{
+    res->old_budget = pciesvc_ind_budget;
+    if (cmd->budget > PCIESVC_IND_BUDGET_MAX) {
+        res->status = PCIESVC_CMDSTATUS_INVALID_ARG;
+        return 0;
+    }
+    pciesvc_ind_budget = cmd->budget ? cmd->budget : PCIESVC_IND_BUDGET;
+    res->status = 0;
+    return 0;
+}
+
+static int
+cmd_set_bar_prof(const pciesvc_cmd_set_bar_prof_t *cmd,
+                 pciesvc_cmdres_set_bar_prof_t *res)
+{
+    if (cmd->hwdevh >= PCIEHW_NDEVS) {
+        res->status = PCIESVC_CMDSTATUS_INVALID_ARG;
+        return 0;
+    }
+    res->old_enable = pciehw_barprof_enable(cmd->enable != 0,
+                                            cmd->hwdevh, cmd->clear);
+    pciehw_barprof_stats(&res->nents, &res->nslots, &res->full);
+    res->status = 0;
+    return 0;
+}
+
+static int
+cmd_bar_prof_read(const pciesvc_cmd_bar_prof_read_t *cmd,
+                  pciesvc_cmdres_bar_prof_read_t *res)
+{
+    res->next = pciehw_barprof_read(cmd->idx, &res->ent);
+    res->valid = res->next != 0;
+    res->status = 0;
+    return 0;
+}
+
+#ifdef PCIESVC_SYSTEM_EXTERN
+static int
+cmd_set_log_ring(const pciesvc_cmd_set_log_ring_t *cmd,
+                 pciesvc_cmdres_set_log_ring_t *res)
+{
+    res->old_enable = pciesvc_logring_enable(cmd->enable != 0);
+    res->status = 0;
+    return 0;
+}
+
+static int
+cmd_log_read(const pciesvc_cmd_log_read_t *cmd,
+             pciesvc_cmdres_log_read_t *res)
+{
+    res->valid = pciesvc_logring_read(&res->rec);
+    res->status = 0;
+    return 0;
+}
+
+static int
+cmd_log_fmt(const pciesvc_cmd_log_fmt_t *cmd,
+            pciesvc_cmdres_log_fmt_t *res)
+{
+    const int len = pciesvc_logring_fmt(cmd->fmtid, cmd->off,
+                                        res->fmt, sizeof(res->fmt));
+
+    if (len < 0) {
+        res->status = PCIESVC_CMDSTATUS_INVALID_ARG;
+        return 0;
+    }
+    res->len = len;
+    res->status = 0;
+    return 0;
+}
+
+static int
+cmd_log_stats(const pciesvc_cmd_log_stats_t *cmd,
+              pciesvc_cmdres_log_stats_t *res)
+{
+    pciesvc_logring_stats(&res->stats);
+    res->status = 0;
+    return 0;
+}
+#endif
+
 int
 pciesvc_cmd_read(char *buf, const long int off, const size_t count)
 {
@@ -64,6 +149,29 @@ pciesvc_cmd_write(const char *buf, const long int off, const size_t count)
     case PCIESVC_CMD_SET_LOG_LEVEL:
         r = cmd_set_log_level(&cmd->set_log_level, &res->set_log_level);
         break;
+    case PCIESVC_CMD_SET_IND_BUDGET:
+        r = cmd_set_ind_budget(&cmd->set_ind_budget, &res->set_ind_budget);
+        break;
+    case PCIESVC_CMD_SET_BAR_PROF:
+        r = cmd_set_bar_prof(&cmd->set_bar_prof, &res->set_bar_prof);
+        break;
+    case PCIESVC_CMD_BAR_PROF_READ:
+        r = cmd_bar_prof_read(&cmd->bar_prof_read, &res->bar_prof_read);
+        break;
+#ifdef PCIESVC_SYSTEM_EXTERN
+    case PCIESVC_CMD_SET_LOG_RING:
+        r = cmd_set_log_ring(&cmd->set_log_ring, &res->set_log_ring);
+        break;
+    case PCIESVC_CMD_LOG_READ:
+        r = cmd_log_read(&cmd->log_read, &res->log_read);
+        break;
+    case PCIESVC_CMD_LOG_FMT:
+        r = cmd_log_fmt(&cmd->log_fmt, &res->log_fmt);
+        break;
+    case PCIESVC_CMD_LOG_STATS:
+        r = cmd_log_stats(&cmd->log_stats, &res->log_stats);
+        break;
+#endif
     default:
         res->status = PCIESVC_CMDSTATUS_UNKNOWN_CMD;
         r = 0;  /* cmd_write "succeeded" */
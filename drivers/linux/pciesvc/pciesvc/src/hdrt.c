@@ -25,20 +25,45 @@ hdrt_addr(const u_int32_t lif)
 }
 
 static void
-hdrt_set(const u_int32_t lif, const hdrt_t *hdrt)
+hdrt_itr(hdrt_t *h, const u_int16_t bdf)
 {
-    pciesvc_reg_wr32w(hdrt_addr(lif), (u_int32_t *)hdrt, HDRT_NWORDS);
+    pciesvc_memset(h, 0, sizeof(*h));
+    h->valid = 1;
+    h->bdf = bdf;
+    h->attr2_1_rd = 0x1; /* reads get Relaxed Ordering */
 }
 
+/*
+ * Program lifc entries starting at lifb with the same hdrt value.
+ * Entries are staged HDRT_BULK at a time in a local buffer and
+ * pushed with one table write, so a large lif block costs one
+ * register range write per HDRT_BULK lifs instead of one register
+ * write sequence per lif.
+ */
+#define HDRT_BULK       32
+
 static void
-hdrt_set_itr(const u_int32_t lif, const u_int16_t bdf)
+hdrt_set_range(const u_int32_t lifb, const u_int32_t lifc, const hdrt_t *hdrt)
 {
-    hdrt_t h = { 0 };
+    u_int32_t buf[HDRT_BULK][HDRT_NWORDS];
+    u_int32_t lif, n;
+
+    if (lifc == 0) {
+        return;
+    }
+    pciesvc_assert(lifb + lifc <= hdrt_size());
 
-    h.valid = 1;
-    h.bdf = bdf;
-    h.attr2_1_rd = 0x1; /* reads get Relaxed Ordering */
-    hdrt_set(lif, &h);
+    n = lifc < HDRT_BULK ? lifc : HDRT_BULK;
+    for (lif = 0; lif < n; lif++) {
+        pciesvc_memcpy(buf[lif], hdrt, sizeof(buf[lif]));
+    }
+    for (lif = lifb; lif < lifb + lifc; lif += n) {
+        if (lifb + lifc - lif < n) {
+            n = lifb + lifc - lif;
+        }
+        pciesvc_reg_wr32_table(hdrt_addr(lif), HDRT_STRIDE,
+                               buf[0], HDRT_NWORDS, n);
+    }
 }
 
 /******************************************************************
@@ -50,11 +75,10 @@ pciehw_hdrt_load(const u_int32_t lifb,
                  const u_int32_t lifc,
                  const u_int16_t bdf)
 {
-    u_int32_t lif;
+    hdrt_t h;
 
-    for (lif = lifb; lif < lifb + lifc; lif++) {
-        hdrt_set_itr(lif, bdf);
-    }
+    hdrt_itr(&h, bdf);
+    hdrt_set_range(lifb, lifc, &h);
     return 0;
 }
 
@@ -62,10 +86,7 @@ int
 pciehw_hdrt_unload(const u_int32_t lifb, const u_int32_t lifc)
 {
     const hdrt_t h0 = { 0 };
-    u_int32_t lif;
 
-    for (lif = lifb; lif < lifb + lifc; lif++) {
-        hdrt_set(lif, &h0);
-    }
+    hdrt_set_range(lifb, lifc, &h0);
     return 0;
 }
@@ -139,17 +139,6 @@ read_indirect_entry(const unsigned int port,
     ientry->port = port;
 }
 
-static int
-read_pending_indirect_entry(const unsigned int port,
-                            indirect_entry_t *ientry)
-{
-    int entry, pending;
-
-    read_ind_info(port, &entry, &pending);
-    read_indirect_entry(port, entry, ientry);
-    return pending;
-}
-
 void
 pciehw_indirect_complete(indirect_entry_t *ientry)
 {
@@ -217,7 +206,7 @@ handle_indirect(const int port, pciehw_port_t *p, indirect_entry_t *ientry)
     switch (tlp_type) {
     case PCIE_TLP_TYPE_CFGRD0:
     case PCIE_TLP_TYPE_CFGRD1:
-        pciehw_cfgrd_indirect(port, ientry);
+        pciehw_cfgrd_indirect(port, p, ientry);
         spmt->swrd++;
         p->stats.ind_cfgrd++;
         break;
@@ -235,7 +224,9 @@ handle_indirect(const int port, pciehw_port_t *p, indirect_entry_t *ientry)
         break;
     case PCIE_TLP_TYPE_MEMWR:
     case PCIE_TLP_TYPE_MEMWR64:
-        pciehw_barwr_indirect(port, ientry);
+        if (pciehw_barwr_indirect(port, ientry)) {
+            p->stats.vnotify_wr++;
+        }
         spmt->swwr++;
         p->stats.ind_memwr++;
         break;
@@ -271,37 +262,62 @@ pciehw_indirect_intr_init(const int port,
                         msgaddr, msgdata | MSGDATA_ADD_PORT);
 }
 
+static void
+indirect_burst_stats(pciehw_port_t *p, const int n, const int budget)
+{
+    if (n >= 8) {
+        p->stats.ind_burst8++;
+    } else if (n >= 4) {
+        p->stats.ind_burst4++;
+    } else if (n >= 2) {
+        p->stats.ind_burst2++;
+    } else {
+        p->stats.ind_burst1++;
+    }
+    if (n >= budget) p->stats.ind_budget++;
+}
+
+/*
+ * Service pending indirect entries until none are pending or
+ * we've handled "budget" entries.  Each completion releases the
+ * entry in hw so IND_INFO presents the next pending entry, if any,
+ * and we avoid a round trip through the caller for each one.
+ */
 static int
-pciehw_indirect_handle(const int port, const int polled)
+pciehw_indirect_handle(const int port, const int polled, const int budget)
 {
     pciehw_port_t *p = pciesvc_port_get(port);
     indirect_entry_t ientrybuf, *ientry = &ientrybuf;
-    int pending;
-    int r = 0;
-
-    pciesvc_memset(ientry, 0, sizeof(*ientry));
-    pending = read_pending_indirect_entry(port, ientry);
+    int entry, pending;
+    int n;
 
     p->stats.ind_intr++;
     if (polled) p->stats.ind_polled++;
-    if (!pending) {
-        p->stats.ind_spurious++;
-        goto out;
+
+    for (n = 0; n < budget; n++) {
+        read_ind_info(port, &entry, &pending);
+        if (!pending) break;
+
+        pciesvc_memset(ientry, 0, sizeof(*ientry));
+        read_indirect_entry(port, entry, ientry);
+        ientry->cpl = PCIECPL_SC; /* assume success */
+        handle_indirect(port, p, ientry);
     }
 
-    ientry->cpl = PCIECPL_SC; /* assume success */
-    handle_indirect(port, p, ientry);
-    r = 1;
+    if (n == 0) {
+        p->stats.ind_spurious++;
+    } else {
+        indirect_burst_stats(p, n, budget);
+    }
 
- out:
     pciesvc_port_put(p, DIRTY);
-    return r;
+    return n;
 }
 
 int
 pciehw_indirect_intr(const int port)
 {
-    return pciehw_indirect_handle(port, 0);
+    return pciehw_indirect_handle(port, 0, pciesvc_ind_budget);
 }
 
 /*
@@ -325,7 +341,7 @@ pciehw_indirect_poll(const int port)
 
     read_ind_info(port, NULL, &pending);
     if (pending) {
-        r = pciehw_indirect_handle(port, 1);
+        r = pciehw_indirect_handle(port, 1, pciesvc_ind_budget);
     }
     return r;
 }
@@ -8,6 +8,256 @@
 
 #ifdef PCIESVC_SYSTEM_EXTERN
 
+/*
+ * Binary log ring
+ *
+ * With the ring enabled (PCIESVC_CMD_SET_LOG_RING) a log call no
+ * longer formats its message into an EV_LOGMSG event.  It stores a
+ * format id and the raw args in a record and the consumer formats
+ * them later, see pciesvc_cmd.h.  A full ring drops the new record
+ * and counts it in drops, separate from event queue drops.
+ *
+ * Format ids index fmtoff[], the offset of each format string from
+ * logfmt_base.  Offsets rather than pointers so the ids stay valid
+ * when the library is relocated.  Messages a record can't hold
+ * (more than PCIESVC_LOGREC_NARGS numeric args, a second %s, or a
+ * conversion we don't parse) still take the formatted event path.
+ *
+ * One of every LOGRING_SAMPLE records is formatted anyway into a
+ * scratch buffer to keep a running estimate of what formatting
+ * costs, and each record that isn't formatted adds that estimate
+ * to fmt_ns_saved.
+ */
+#define LOGRING_NRECS   256
+#define LOGRING_NFMTS   128
+#define LOGRING_SAMPLE  64
+
+typedef struct logring_s {
+    u_int32_t enable;
+    u_int32_t head;                     /* next record to fill */
+    u_int32_t tail;                     /* next record to read */
+    int32_t fmtoff[LOGRING_NFMTS];      /* fmtid -> logfmt_base offset */
+    pciesvc_log_stats_t stats;
+    pciesvc_logrec_t rec[LOGRING_NRECS];
+} logring_t;
+
+static logring_t logring;
+static const char logfmt_base[] = "";
+
+static int
+logring_fmtid(logring_t *lr, const char *fmt)
+{
+    const int32_t off = (unsigned long)fmt - (unsigned long)logfmt_base;
+    int i;
+
+    for (i = 0; i < lr->stats.nfmts; i++) {
+        if (lr->fmtoff[i] == off) {
+            return i;
+        }
+    }
+    if (lr->stats.nfmts >= LOGRING_NFMTS) {
+        return -1;
+    }
+    lr->fmtoff[lr->stats.nfmts] = off;
+    return lr->stats.nfmts++;
+}
+
+/*
+ * Collect the args for fmt into rec.  Returns -1 if fmt has
+ * a conversion or more args than a record can carry.
+ */
+static int
+logrec_args(pciesvc_logrec_t *rec, const char *fmt, va_list ap)
+{
+    const char *p, *str;
+    u_int64_t v;
+    int nargs, nstr, lng, i;
+
+    nargs = 0;
+    nstr = 0;
+    for (p = fmt; *p; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        p++;
+        if (*p == '%') {
+            continue;
+        }
+        while (*p == '-' || *p == '+' || *p == ' ' || *p == '#') {
+            p++;
+        }
+        while ((*p >= '0' && *p <= '9') || *p == '.') {
+            p++;
+        }
+        for (lng = 0; *p == 'l' || *p == 'z' || *p == 'h'; p++) {
+            if (*p != 'h') lng++;
+        }
+
+        switch (*p) {
+        case 'd':
+        case 'i':
+            if (lng == 0) v = va_arg(ap, int);
+            else if (lng == 1) v = va_arg(ap, long);
+            else v = va_arg(ap, long long);
+            break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        case 'c':
+            if (lng == 0) v = va_arg(ap, unsigned int);
+            else if (lng == 1) v = va_arg(ap, unsigned long);
+            else v = va_arg(ap, unsigned long long);
+            break;
+        case 'p':
+            v = (unsigned long)va_arg(ap, void *);
+            break;
+        case 's':
+            if (nstr++) {
+                return -1;
+            }
+            str = va_arg(ap, const char *);
+            if (str == NULL) {
+                str = "(null)";
+            }
+            for (i = 0; i < sizeof(rec->str) - 1 && str[i]; i++) {
+                rec->str[i] = str[i];
+            }
+            rec->str[i] = '\0';
+            continue;
+        default:
+            return -1;
+        }
+        if (nargs >= PCIESVC_LOGREC_NARGS) {
+            return -1;
+        }
+        rec->args[nargs++] = v;
+    }
+    rec->nargs = nargs;
+    return 0;
+}
+
+/*
+ * Sample what formatting this message would have cost.
+ */
+static void
+logring_sample(logring_t *lr, const char *fmt, va_list ap)
+{
+    u_int64_t t0, ns;
+    char buf[80];
+
+    t0 = pciesvc_nsecs();
+    pciesvc_vsnprintf(buf, sizeof(buf), fmt, ap);
+    ns = pciesvc_nsecs() - t0;
+    lr->stats.fmt_ns = lr->stats.fmt_ns ?
+        (lr->stats.fmt_ns * 7 + ns) / 8 : ns;
+}
+
+/*
+ * Store a log record.  Returns -1 if this message needs
+ * the formatted path instead.
+ */
+static int
+logring_post(pciesvc_logpri_t pri, const char *fmt, va_list ap)
+{
+    logring_t *lr = &logring;
+    pciesvc_logrec_t *rec;
+    va_list aq;
+    int fmtid;
+
+    if (lr->head - lr->tail >= LOGRING_NRECS) {
+        lr->stats.drops++;
+        return 0;
+    }
+
+    rec = &lr->rec[lr->head & (LOGRING_NRECS - 1)];
+    va_copy(aq, ap);
+    if (logrec_args(rec, fmt, aq) < 0) {
+        va_end(aq);
+        return -1;
+    }
+    va_end(aq);
+    /* only claim a format id once the record is known to fit */
+    fmtid = logring_fmtid(lr, fmt);
+    if (fmtid < 0) {
+        return -1;
+    }
+    rec->seq = lr->head;
+    rec->fmtid = fmtid;
+    rec->pri = pri;
+    /* record must be visible to the reader before head moves */
+    pciesvc_mem_barrier();
+    lr->head++;
+    lr->stats.posted++;
+
+    if ((lr->stats.posted % LOGRING_SAMPLE) == 1) {
+        logring_sample(lr, fmt, ap);
+    } else {
+        lr->stats.fmt_ns_saved += lr->stats.fmt_ns;
+    }
+    return 0;
+}
+
+int
+pciesvc_logring_enable(const int on)
+{
+    logring_t *lr = &logring;
+    const int old = lr->enable;
+
+    lr->enable = on;
+    return old;
+}
+
+int
+pciesvc_logring_read(pciesvc_logrec_t *rec)
+{
+    logring_t *lr = &logring;
+
+    if (lr->tail == lr->head) {
+        return 0;
+    }
+    *rec = lr->rec[lr->tail & (LOGRING_NRECS - 1)];
+    lr->tail++;
+    return 1;
+}
+
+/*
+ * Copy up to n-1 bytes of the format string for fmtid, starting
+ * at off, into buf.  Returns the full length, or -1 if fmtid has
+ * not been assigned.
+ */
+int
+pciesvc_logring_fmt(const u_int32_t fmtid, const u_int32_t off,
+                    char *buf, const int n)
+{
+    logring_t *lr = &logring;
+    const char *fmt;
+    int len, i;
+
+    if (fmtid >= lr->stats.nfmts) {
+        return -1;
+    }
+    /* not logfmt_base + off, fmt is not within logfmt_base[] */
+    fmt = (const char *)((unsigned long)logfmt_base + lr->fmtoff[fmtid]);
+    for (len = 0; fmt[len]; len++) {
+        continue;
+    }
+    for (i = 0; i < n - 1 && off + i < len; i++) {
+        buf[i] = fmt[off + i];
+    }
+    buf[i] = '\0';
+    return len;
+}
+
+void
+pciesvc_logring_stats(pciesvc_log_stats_t *stats)
+{
+    logring_t *lr = &logring;
+
+    *stats = lr->stats;
+    stats->queued = lr->head - lr->tail;
+}
+
 static void
 logv(pciesvc_logpri_t pri, const char *fmt, va_list ap)
 {
@@ -19,6 +269,13 @@ logv(pciesvc_logpri_t pri, const char *fmt, va_list ap)
         return;
     }
 
+    if (logring.enable) {
+        if (logring_post(pri, fmt, ap) == 0) {
+            return;
+        }
+        logring.stats.eager++;
+    }
+
     pciesvc_vsnprintf(buf, sizeof(buf), fmt, ap);
 
     pciesvc_memset(&evd, 0, sizeof(evd));
@@ -26,6 +26,12 @@ void pciesvc_logwarn(const char *fmt, ...)
 void pciesvc_logerror(const char *fmt, ...)
     __attribute__((format (printf, 1, 2)));
 
+int pciesvc_logring_enable(const int on);
+int pciesvc_logring_read(pciesvc_logrec_t *rec);
+int pciesvc_logring_fmt(const u_int32_t fmtid, const u_int32_t off,
+                        char *buf, const int n);
+void pciesvc_logring_stats(pciesvc_log_stats_t *stats);
+
 #endif
 
 #ifdef __cplusplus
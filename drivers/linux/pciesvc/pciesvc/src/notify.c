@@ -172,6 +172,56 @@ handle_notify(const int port, pciehw_port_t *p, notify_entry_t *nentry)
     }
 }
 
+static void
+notify_burst_stats(pciehw_port_t *p, const u_int32_t n)
+{
+    if (n >= 32) {
+        p->stats.not_burst32++;
+    } else if (n >= 8) {
+        p->stats.not_burst8++;
+    } else if (n >= 2) {
+        p->stats.not_burst2++;
+    } else {
+        p->stats.not_burst1++;
+    }
+}
+
+/*
+ * How often to hand consumed slots back to hw during a pass.
+ * A backlog under a quarter of the ring can't make hw drop
+ * notifies before we're done so CI is written once at the end,
+ * deeper backlogs return slots every ring/4 or ring/8 entries.
+ */
+static u_int32_t
+notify_ci_interval(const u_int32_t pending, const u_int32_t ring_mask)
+{
+    const u_int32_t ringsz = ring_mask + 1;
+
+    if (pending < ringsz / 4) return 0;
+    if (pending < ringsz / 2) return ringsz / 4;
+    return ringsz / 8;
+}
+
+/*
+ * Look up the next n ring entries starting after idx and get
+ * them on their way into the cache before we need them.
+ */
+#define NOTIFY_BATCH    8
+
+static void
+notify_batch_get(const int port, int idx, const int n,
+                 const u_int32_t ring_mask, notify_entry_t **batch)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        idx = notify_ring_inc(idx, 1, ring_mask);
+        batch[i] = pciesvc_notify_ring_get(port, idx);
+        pciesvc_prefetch(batch[i]);
+        pciesvc_prefetch(&batch[i]->info);
+    }
+}
+
 /******************************************************************
  * apis
  */
@@ -192,8 +242,9 @@ pciehw_notify_handle(const int port, const int polled)
 {
     pciehw_port_t *p = pciesvc_port_get(port);
     const u_int32_t ring_mask = pciesvc_notify_ring_mask(port);
-    int r, pi, ci, i, endidx;
-    u_int32_t pici_delta;
+    notify_entry_t *batch[2][NOTIFY_BATCH];
+    u_int32_t pici_delta, interval, left, since_ci = 0;
+    int r, pi, ci, i, b, n, nnext;
 
     p->stats.not_intr++;
     if (polled) p->stats.not_polled++;
@@ -212,20 +263,38 @@ pciehw_notify_handle(const int port, const int polled)
         p->stats.not_max = pici_delta;
     }
 
-    endidx = notify_ring_inc(pi, 1, ring_mask);
-    for (i = notify_ring_inc(ci, 1, ring_mask);
-         i != endidx;
-         i = notify_ring_inc(i, 1, ring_mask)) {
-        notify_entry_t *nentry;
-
-        nentry = pciesvc_notify_ring_get(port, i);
-        handle_notify(port, p, nentry);
-        pciesvc_notify_ring_put(nentry);
+    /*
+     * pi was read once above, work through everything up to it
+     * NOTIFY_BATCH entries at a time, fetching the next batch
+     * before handling this one.
+     */
+    notify_burst_stats(p, pici_delta);
+    interval = notify_ci_interval(pici_delta, ring_mask);
+    left = pici_delta;
+    n = left < NOTIFY_BATCH ? left : NOTIFY_BATCH;
+    notify_batch_get(port, ci, n, ring_mask, batch[0]);
+    for (b = 0; left; b ^= 1) {
+        left -= n;
+        nnext = left < NOTIFY_BATCH ? left : NOTIFY_BATCH;
+        if (nnext) {
+            notify_batch_get(port, notify_ring_inc(ci, n, ring_mask),
+                             nnext, ring_mask, batch[b ^ 1]);
+        }
 
-        /* return some slots occasionally while processing */
-        if ((i & 0xff) == 0) {
-            notify_set_ci(port, i);
+        for (i = 0; i < n; i++) {
+            handle_notify(port, p, batch[b][i]);
+            pciesvc_notify_ring_put(batch[b][i]);
+        }
+        ci = notify_ring_inc(ci, n, ring_mask);
+
+        /* return some slots while working through a deep backlog */
+        since_ci += n;
+        if (interval && since_ci >= interval && left) {
+            notify_set_ci(port, ci);
+            p->stats.not_ciwb++;
+            since_ci = 0;
         }
+        n = nnext;
     }
 
     /* we consumed these, adjust ci */
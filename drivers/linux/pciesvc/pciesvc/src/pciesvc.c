@@ -12,6 +12,9 @@ int pciesvc_version_minor = PCIESVC_VERSION_MIN;
 
 pciesvc_logpri_t pciesvc_log_level = PCIESVC_LOGPRI_INFO;
 
+/* max indirect entries serviced per poll/intr */
+int pciesvc_ind_budget = PCIESVC_IND_BUDGET;
+
 /* local sanitized version of our params. */
 typedef struct pciesvc_lparams_s {
     int         port;                   /* port */
@@ -210,7 +213,38 @@ pciesvc_poll(const int port)
     ind_poll = pciesvc_indirect_poll(lp->port);
     not_poll = pciesvc_notify_poll(lp->port);
 
-    return (ind_poll || not_poll);
+    return ind_poll + not_poll;
+}
+
+u_int32_t
+pciesvc_ports_valid(void)
+{
+    u_int32_t mask = 0;
+    int port;
+
+    for (port = 0; port < PCIEHW_NPORTS; port++) {
+        if (lparams[port].valid) mask |= 1 << port;
+    }
+    return mask;
+}
+
+u_int32_t
+pciesvc_poll_round(const u_int32_t mask, int *res)
+{
+    static int first;
+    u_int32_t busy = 0;
+    int i, port;
+
+    for (i = 0; i < PCIEHW_NPORTS; i++) {
+        port = (first + i) % PCIEHW_NPORTS;
+        if ((mask & (1 << port)) == 0) continue;
+
+        res[port] = pciesvc_poll(port);
+        if (res[port] > 0) busy |= 1 << port;
+    }
+    /* next round starts one port along so no port always goes first */
+    first = (first + 1) % PCIEHW_NPORTS;
+    return busy;
 }
 
 void
@@ -25,10 +25,11 @@ extern "C" {
 struct indirect_entry_s; typedef struct indirect_entry_s indirect_entry_t;
 struct notify_entry_s; typedef struct notify_entry_s notify_entry_t;
 
-void pciehw_cfgrd_indirect(const int port, indirect_entry_t *ientry);
+void pciehw_cfgrd_indirect(const int port, pciehw_port_t *p,
+                           indirect_entry_t *ientry);
 void pciehw_cfgwr_indirect(const int port, indirect_entry_t *ientry);
 void pciehw_barrd_indirect(const int port, indirect_entry_t *ientry);
-void pciehw_barwr_indirect(const int port, indirect_entry_t *ientry);
+int pciehw_barwr_indirect(const int port, indirect_entry_t *ientry);
 
 void pciehw_cfgrd_notify(const int port, notify_entry_t *nentry);
 void pciehw_cfgwr_notify(const int port, notify_entry_t *nentry);
@@ -37,12 +38,20 @@ void pciehw_barwr_notify(const int port, notify_entry_t *nentry);
 
 enum pciesvc_rsttype_e; typedef enum pciesvc_rsttype_e pciesvc_rsttype_t;
 void pciehw_cfg_reset(pciehwdev_t *phwdev, const pciesvc_rsttype_t rsttype);
+u_int16_t pciehw_cfg_reset_vf(pciehwdev_t *vfhwdev);
 
 u_int64_t pciehw_bar_getsize(pciehwbar_t *phwbar);
 void pciehw_bar_setaddr(pciehwbar_t *phwbar, const u_int64_t addr);
 void pciehw_bar_load(pciehwdev_t *phwdev, pciehwbar_t *phwbar);
+void pciehw_bar_unload(pciehwdev_t *phwdev, pciehwbar_t *phwbar);
 void pciehw_bar_enable(pciehwdev_t *phwdev, pciehwbar_t *phwbar, const int on);
 
+int pciehw_barprof_enable(const int on, const pciehwdevh_t hwdevh,
+                          const int clear);
+void pciehw_barprof_stats(u_int32_t *nents, u_int32_t *nslots,
+                          u_int64_t *full);
+int pciehw_barprof_read(const u_int32_t idx, pciesvc_barprof_ent_t *ent);
+
 u_int16_t pciehwdev_get_hostbdf(const pciehwdev_t *phwdev);
 
 #define CLEAN                   0
@@ -17,6 +17,7 @@
 #include <assert.h>
 #include <endian.h>
 #include <sys/param.h>
+#include <time.h>
 #include <linux/pci_regs.h>
 
 #include "platform/pal/include/pal.h"
@@ -38,6 +39,7 @@
 #define pciesvc_usleep          usleep
 #define pciesvc_ffs             ffs
 #define pciesvc_ffsll           ffsll
+#define pciesvc_prefetch        __builtin_prefetch
 #define pciesvc_snprintf        snprintf
 #define pciesvc_vsnprintf       vsnprintf
 
@@ -137,6 +139,18 @@ pciesvc_mem_wr(const uint64_t pa, const void *buf, const size_t sz)
     }
 }
 
+static inline void
+pciesvc_reg_wr32_table(const uint64_t pa, const uint32_t stride,
+                       const uint32_t *w, const uint32_t nw,
+                       const uint32_t n)
+{
+    uint32_t i;
+
+    for (i = 0; i < n; i++) {
+        pal_reg_wr32w(pa + i * stride, (uint32_t *)&w[i * nw], nw);
+    }
+}
+
 static inline int
 pciesvc_event_handler(const void *evdata, const size_t evsize)
 {
@@ -144,6 +158,15 @@ pciesvc_event_handler(const void *evdata, const size_t evsize)
     return 0;
 }
 
+static inline u_int64_t
+pciesvc_nsecs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u_int64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 static inline void
 pciesvc_debug_cmd(uint32_t *valp)
 {
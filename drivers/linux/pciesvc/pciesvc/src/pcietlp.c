@@ -14,18 +14,6 @@ typedef struct pcietlp_info_s {
 
 static pcietlp_info_t pcietlp_info;
 
-static inline int
-bitcount(u_int32_t n)
-{
-    int count = 0;
-
-    while (n) {
-	count++;
-        n &= ~(-n); /* clear low order 1 bit */
-    }
-    return count;
-}
-
 static int pcietlp_set_error(const char *fmt, ...)
     __attribute__((format (printf, 1, 2)));
 static int pcietlp_set_error(const char *fmt, ...)
@@ -236,13 +224,23 @@ encode_cmn_hdr(const pcie_stlp_t *stlp, const u_int8_t type, void *rtlp)
     hdr->lbe = stlp_lbe(stlp);
 }
 
+/*
+ * Byte enable nibble to number of bytes enabled, and to the
+ * byte offset of the first enabled byte.
+ */
+static const u_int8_t be_nbytes[16] = {
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+};
+static const u_int8_t be_offset[16] = {
+    0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+};
+
 static void
 decode_cmn_hdr(pcie_stlp_t *stlp, const void *rtlp)
 {
     const pcie_tlp_common_hdr_t *hdr = rtlp;
     const u_int8_t be_dw = (hdr->fbe > 0) + (hdr->lbe > 0);
-    const u_int8_t be_bits = bitcount(hdr->fbe) + bitcount(hdr->lbe);
-    const u_int8_t ffbe = pciesvc_ffs(hdr->fbe);
+    const u_int8_t be_bits = be_nbytes[hdr->fbe] + be_nbytes[hdr->lbe];
     u_int16_t ndw = (hdr->len_hi << 8) | hdr->len_lo;
 
     /* ndw=0 indicates max 0x400 */
@@ -256,7 +254,7 @@ decode_cmn_hdr(pcie_stlp_t *stlp, const void *rtlp)
     }
 
     /* addr start depends on first First Byte Enable bit position.*/
-    stlp->addr = ffbe ? ffbe - 1 : 0;
+    stlp->addr = be_offset[hdr->fbe];
 
     stlp->reqid = pciesvc_be16toh(hdr->reqid);
     stlp->tag = (hdr->t9 << 9) | (hdr->t8 << 8) | hdr->tag;
@@ -275,16 +273,6 @@ encode_cfg_hdr(const pcie_stlp_t *stlp, const u_int8_t type, void *rtlp)
     cfg->extreg = stlp->addr >> 8;
 }
 
-static void
-decode_cfg_hdr(pcie_stlp_t *stlp, const void *rtlp)
-{
-    const pcie_tlp_cfg_t *cfg = rtlp;
-
-    decode_cmn_hdr(stlp, cfg);
-    stlp->bdf = pciesvc_be16toh(cfg->bdf);
-    stlp->addr += (cfg->extreg << 8) | cfg->reg;
-}
-
 /******************************************************************/
 
 static void
@@ -296,15 +284,6 @@ encode_mem32_hdr(const pcie_stlp_t *stlp, const u_int8_t type, void *rtlp)
     encode_addr32(stlp, &mem->addr);
 }
 
-static void
-decode_mem32_hdr(pcie_stlp_t *stlp, const void *rtlp)
-{
-    const pcie_tlp_mem32_t *mem = rtlp;
-
-    decode_cmn_hdr(stlp, mem);
-    decode_addr32(stlp, mem->addr);
-}
-
 /******************************************************************/
 
 static void
@@ -316,15 +295,6 @@ encode_mem64_hdr(const pcie_stlp_t *stlp, const u_int8_t type, void *rtlp)
     encode_addr64(stlp, &mem->addr_hi);
 }
 
-static void
-decode_mem64_hdr(pcie_stlp_t *stlp, const void *rtlp)
-{
-    const pcie_tlp_mem64_t *mem = rtlp;
-
-    decode_cmn_hdr(stlp, mem);
-    decode_addr64(stlp, &mem->addr_hi);
-}
-
 /******************************************************************
  * CFG
  */
@@ -346,20 +316,6 @@ encode_cfgrd(const pcie_stlp_t *stlp, void *rtlp, const size_t rtlpsz)
     return tlpsz;
 }
 
-static int
-decode_cfgrd(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
-{
-    const int tlpsz = 12;
-
-    if (rtlpsz < tlpsz) {
-        return pcietlp_set_error("cfgrd: rtlpsz want %d got %ld",
-                                 tlpsz, rtlpsz);
-    }
-
-    decode_cfg_hdr(stlp, rtlp);
-    return tlpsz;
-}
-
 /******************************************************************/
 
 static int
@@ -377,21 +333,6 @@ encode_cfgwr(const pcie_stlp_t *stlp, void *rtlp, const size_t rtlpsz)
     return tlpsz;
 }
 
-static int
-decode_cfgwr(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
-{
-    const int tlpsz = 16;
-
-    if (rtlpsz < tlpsz) {
-        return pcietlp_set_error("cfgwr: rtlpsz want %d got %ld",
-                                 tlpsz, rtlpsz);
-    }
-
-    decode_cfg_hdr(stlp, rtlp);
-    decode_data32(stlp, rtlp + 12);
-    return tlpsz;
-}
-
 /******************************************************************
  * MEM
  */
@@ -411,20 +352,6 @@ encode_memrd(const pcie_stlp_t *stlp, void *rtlp, const size_t rtlpsz)
     return tlpsz;
 }
 
-static int
-decode_memrd(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
-{
-    const int tlpsz = 12;
-
-    if (rtlpsz < tlpsz) {
-        return pcietlp_set_error("memrd: rtlpsz want %d got %ld",
-                                 tlpsz, rtlpsz);
-    }
-
-    decode_mem32_hdr(stlp, rtlp);
-    return tlpsz;
-}
-
 /******************************************************************/
 
 static int
@@ -446,27 +373,6 @@ encode_memwr(const pcie_stlp_t *stlp, void *rtlp, const size_t rtlpsz)
     return tlpsz;
 }
 
-static int
-decode_memwr(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
-{
-    const int tlpsz = 12;
-
-    if (rtlpsz < tlpsz) {
-        return pcietlp_set_error("memwr: rtlpsz want %d got %ld",
-                                 tlpsz, rtlpsz);
-    }
-
-    decode_mem32_hdr(stlp, rtlp);
-
-    if (rtlpsz < tlpsz + stlp->size) {
-        return pcietlp_set_error("memwr: rtlpsz want %d got %ld",
-                                 tlpsz + stlp->size, rtlpsz);
-    }
-
-    decode_data(stlp, rtlp + 12);
-    return tlpsz + stlp->size;
-}
-
 /******************************************************************
  * MEM 64
  */
@@ -485,20 +391,6 @@ encode_memrd64(const pcie_stlp_t *stlp, void *rtlp, const size_t rtlpsz)
     return tlpsz;
 }
 
-static int
-decode_memrd64(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
-{
-    const int tlpsz = 16;
-
-    if (rtlpsz < tlpsz) {
-        return pcietlp_set_error("memrd64: rtlpsz want %d got %ld",
-                                 tlpsz, rtlpsz);
-    }
-
-    decode_mem64_hdr(stlp, rtlp);
-    return tlpsz;
-}
-
 /******************************************************************/
 
 static int
@@ -520,27 +412,6 @@ encode_memwr64(const pcie_stlp_t *stlp, void *rtlp, const size_t rtlpsz)
     return tlpsz;
 }
 
-static int
-decode_memwr64(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
-{
-    const int tlpsz = 16;
-
-    if (rtlpsz < tlpsz) {
-        return pcietlp_set_error("memwr64: rtlpsz want %d got %ld",
-                                 tlpsz, rtlpsz);
-    }
-
-    decode_mem64_hdr(stlp, rtlp);
-
-    if (rtlpsz < tlpsz + stlp->size) {
-        return pcietlp_set_error("memwr64: rtlpsz want %d got %ld",
-                                 tlpsz + stlp->size, rtlpsz);
-    }
-
-    decode_data(stlp, rtlp + 16);
-    return tlpsz + stlp->size;
-}
-
 /******************************************************************
  * IO
  */
@@ -562,20 +433,6 @@ encode_iord(const pcie_stlp_t *stlp, void *rtlp, const size_t rtlpsz)
     return tlpsz;
 }
 
-static int
-decode_iord(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
-{
-    const int tlpsz = 12;
-
-    if (rtlpsz < tlpsz) {
-        return pcietlp_set_error("iord: rtlpsz want %d got %ld",
-                                 tlpsz, rtlpsz);
-    }
-
-    decode_mem32_hdr(stlp, rtlp);
-    return tlpsz;
-}
-
 /******************************************************************/
 
 static int
@@ -596,21 +453,6 @@ encode_iowr(const pcie_stlp_t *stlp, void *rtlp, const size_t rtlpsz)
     return tlpsz;
 }
 
-static int
-decode_iowr(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
-{
-    const int tlpsz = 16;
-
-    if (rtlpsz < tlpsz) {
-        return pcietlp_set_error("iowr: rtlpsz want %d got %ld",
-                                 tlpsz, rtlpsz);
-    }
-
-    decode_mem32_hdr(stlp, rtlp);
-    decode_data(stlp, rtlp + 12);
-    return tlpsz;
-}
-
 /******************************************************************/
 
 int
@@ -653,60 +495,130 @@ pcietlp_encode(const pcie_stlp_t *stlp, void *rtlp, const size_t rtlpsz)
     return pcietlp_is_error() ? -1 : n;
 }
 
+/*
+ * Decode description for each tlp type we handle, indexed by the
+ * raw header type byte (fmt<<5 | type).  Types with fmt >= 4 are
+ * prefixes and never handled, so 128 entries cover the space.
+ * Unhandled types are left zero (PCIE_STLP_MALFORMED).
+ *
+ * The table holds no pointers so it needs no relocation when
+ * we run from the kexec'd copy of the code.
+ */
+enum {
+    DEC_ADDR_CFG,               /* bdf and reg from cfg hdr */
+    DEC_ADDR_32,                /* 32-bit address */
+    DEC_ADDR_64,                /* 64-bit address */
+};
+
+enum {
+    DEC_DATA_NONE,              /* no payload */
+    DEC_DATA_DW,                /* single dword payload */
+    DEC_DATA_FIXED,             /* payload, fixed tlp size */
+    DEC_DATA_PAYLOAD,           /* payload, tlp size includes payload */
+};
+
+typedef struct pcietlp_dec_s {
+    u_int8_t stlp_type;         /* PCIE_STLP_* */
+    u_int8_t hdrsz;             /* header size, payload starts here */
+    u_int8_t tlpsz;             /* min tlp size (excluding payload) */
+    u_int8_t addr:4;            /* DEC_ADDR_* */
+    u_int8_t data:4;            /* DEC_DATA_* */
+    char name[8];               /* for error messages */
+} pcietlp_dec_t;
+
+#define DEC(t, st, hsz, tsz, a, d, nm) \
+    [PCIE_TLP_TYPE_##t] = { PCIE_STLP_##st, hsz, tsz, \
+                            DEC_ADDR_##a, DEC_DATA_##d, nm }
+
+static const pcietlp_dec_t pcietlp_dec[128] = {
+    DEC(MEMRD,   MEMRD,   12, 12, 32,  NONE,    "memrd"),
+    DEC(MEMRD64, MEMRD64, 16, 16, 64,  NONE,    "memrd64"),
+    DEC(MEMWR,   MEMWR,   12, 12, 32,  PAYLOAD, "memwr"),
+    DEC(MEMWR64, MEMWR64, 16, 16, 64,  PAYLOAD, "memwr64"),
+    DEC(IORD,    IORD,    12, 12, 32,  NONE,    "iord"),
+    DEC(IOWR,    IOWR,    12, 16, 32,  FIXED,   "iowr"),
+    DEC(CFGRD0,  CFGRD,   12, 12, CFG, NONE,    "cfgrd"),
+    DEC(CFGWR0,  CFGWR,   12, 16, CFG, DW,      "cfgwr"),
+    DEC(CFGRD1,  CFGRD1,  12, 12, CFG, NONE,    "cfgrd"),
+    DEC(CFGWR1,  CFGWR1,  12, 16, CFG, DW,      "cfgwr"),
+};
+
 int
 pcietlp_decode(pcie_stlp_t *stlp, const void *rtlp, const size_t rtlpsz)
 {
     const pcie_tlp_common_hdr_t *hdr = rtlp;
+    const pcietlp_dec_t *dec;
     int n;
 
     pcietlp_clr_error();
-    switch (hdr->type) {
-    case PCIE_TLP_TYPE_MEMRD:
-        stlp->type = PCIE_STLP_MEMRD;
-        n = decode_memrd(stlp, rtlp, rtlpsz);
-        break;
-    case PCIE_TLP_TYPE_MEMRD64:
-        stlp->type = PCIE_STLP_MEMRD64;
-        n = decode_memrd64(stlp, rtlp, rtlpsz);
-        break;
-    case PCIE_TLP_TYPE_MEMWR:
-        stlp->type = PCIE_STLP_MEMWR;
-        n = decode_memwr(stlp, rtlp, rtlpsz);
-        break;
-    case PCIE_TLP_TYPE_MEMWR64:
-        stlp->type = PCIE_STLP_MEMWR64;
-        n = decode_memwr64(stlp, rtlp, rtlpsz);
-        break;
-    case PCIE_TLP_TYPE_IORD:
-        stlp->type = PCIE_STLP_IORD;
-        n = decode_iord(stlp, rtlp, rtlpsz);
+    dec = &pcietlp_dec[hdr->type & 0x7f];
+    if (hdr->type >= 0x80 || dec->stlp_type == PCIE_STLP_MALFORMED) {
+        return pcietlp_set_error("decode: unhandled type 0x%x\n", hdr->type);
+    }
+
+    stlp->type = dec->stlp_type;
+    n = dec->tlpsz;
+    if (rtlpsz < n) {
+        return pcietlp_set_error("%s: rtlpsz want %d got %ld",
+                                 dec->name, n, rtlpsz);
+    }
+
+    decode_cmn_hdr(stlp, hdr);
+    switch (dec->addr) {
+    case DEC_ADDR_CFG: {
+        const pcie_tlp_cfg_t *cfg = rtlp;
+
+        stlp->bdf = pciesvc_be16toh(cfg->bdf);
+        stlp->addr += (cfg->extreg << 8) | cfg->reg;
         break;
-    case PCIE_TLP_TYPE_IOWR:
-        stlp->type = PCIE_STLP_IOWR;
-        n = decode_iowr(stlp, rtlp, rtlpsz);
+    }
+    case DEC_ADDR_32:
+        decode_addr32(stlp, ((const pcie_tlp_mem32_t *)rtlp)->addr);
         break;
-    case PCIE_TLP_TYPE_CFGRD0:
-        stlp->type = PCIE_STLP_CFGRD;
-        n = decode_cfgrd(stlp, rtlp, rtlpsz);
+    case DEC_ADDR_64:
+        decode_addr64(stlp, &((const pcie_tlp_mem64_t *)rtlp)->addr_hi);
         break;
-    case PCIE_TLP_TYPE_CFGWR0:
-        stlp->type = PCIE_STLP_CFGWR;
-        n = decode_cfgwr(stlp, rtlp, rtlpsz);
+    }
+
+    switch (dec->data) {
+    case DEC_DATA_NONE:
         break;
-    case PCIE_TLP_TYPE_CFGRD1:
-        stlp->type = PCIE_STLP_CFGRD1;
-        n = decode_cfgrd(stlp, rtlp, rtlpsz);
+    case DEC_DATA_DW:
+        decode_data32(stlp, rtlp + dec->hdrsz);
         break;
-    case PCIE_TLP_TYPE_CFGWR1:
-        stlp->type = PCIE_STLP_CFGWR1;
-        n = decode_cfgwr(stlp, rtlp, rtlpsz);
+    case DEC_DATA_FIXED:
+        decode_data(stlp, rtlp + dec->hdrsz);
         break;
-    default:
-        pcietlp_set_error("decode: unhandled type 0x%x\n", hdr->type);
-        n = -1;
+    case DEC_DATA_PAYLOAD:
+        n += stlp->size;
+        if (rtlpsz < n) {
+            return pcietlp_set_error("%s: rtlpsz want %d got %ld",
+                                     dec->name, n, rtlpsz);
+        }
+        decode_data(stlp, rtlp + dec->hdrsz);
         break;
     }
-    return pcietlp_is_error() ? -1 : n;
+    return n;
+}
+
+/*
+ * Payload of a write of up to a dword, without the full decode.
+ * For callers that already have the target pa and size from the
+ * tlp aux info, pa gives the byte lane.
+ */
+u_int32_t
+pcietlp_wrdata32(const void *rtlp, const u_int64_t pa, const u_int32_t size)
+{
+    const pcie_tlp_common_hdr_t *hdr = rtlp;
+    const pcietlp_dec_t *dec = &pcietlp_dec[hdr->type & 0x7f];
+    u_int32_t v;
+
+    pciesvc_memcpy(&v, rtlp + dec->hdrsz, sizeof(v));
+    v = pciesvc_le32toh(v) >> ((pa & 0x3) * 8);
+    if (size < 4) {
+        v &= (1 << size * 8) - 1;
+    }
+    return v;
 }
 
 /******************************************************************/
@@ -50,11 +50,175 @@ pmr_addr(const int pmti)
     return PMR_BASE + (pmti * PMR_STRIDE);
 }
 
+/*
+ * PMT free lists
+ *
+ * freepmt_high and freepmt_low are linked through spmt->next and kept
+ * sorted by index.  That lets a multi-entry request be met from any
+ * run of adjacent freed entries instead of only from the sequential
+ * region, and lets freed entries that border the sequential region
+ * be handed back to it.  Code that only pops the list head for a
+ * single entry works on a sorted list just the same.
+ */
+static u_int16_t
+pmt_next(const int pmti)
+{
+    pciehw_spmt_t *spmt = pciesvc_spmt_get(pmti);
+    const u_int16_t next = spmt->next;
+
+    pciesvc_spmt_put(spmt, CLEAN);
+    return next;
+}
+
+static void
+pmt_set_next(const int pmti, const u_int16_t next)
+{
+    pciehw_spmt_t *spmt = pciesvc_spmt_get(pmti);
+
+    spmt->next = next;
+    pciesvc_spmt_put(spmt, DIRTY);
+}
+
+/*
+ * Find the first run of n adjacent entries on the free list,
+ * unlink it and return its base, or -1 if there is none.
+ */
+static int
+pmt_freelist_take(u_int32_t *headp, const int n)
+{
+    u_int32_t pmti, next, prev, runprev, runb;
+    int runc, i;
+
+    prev = runprev = runb = PMT_INVALID;
+    runc = 0;
+    for (pmti = *headp; pmti != PMT_INVALID; pmti = next) {
+        next = pmt_next(pmti);
+        if (runc && pmti == runb + runc) {
+            runc++;
+        } else {
+            runb = pmti;
+            runc = 1;
+            runprev = prev;
+        }
+        if (runc == n) {
+            if (runprev == PMT_INVALID) {
+                *headp = next;
+            } else {
+                pmt_set_next(runprev, next);
+            }
+            for (i = 0; i < n; i++) {
+                pmt_set_next(runb + i, PMT_INVALID);
+            }
+            return runb;
+        }
+        prev = pmti;
+    }
+    return -1;
+}
+
+/*
+ * Insert [pmtb, pmtb + pmtc) into the free list in index order.
+ */
+static void
+pmt_freelist_put(u_int32_t *headp, const int pmtb, const int pmtc)
+{
+    u_int32_t pmti, prev, next;
+    int i;
+
+    prev = PMT_INVALID;
+    for (pmti = *headp; pmti != PMT_INVALID && pmti < pmtb; pmti = next) {
+        next = pmt_next(pmti);
+        prev = pmti;
+    }
+
+    for (i = 0; i < pmtc - 1; i++) {
+        pmt_set_next(pmtb + i, pmtb + i + 1);
+    }
+    pmt_set_next(pmtb + pmtc - 1, pmti);
+    if (prev == PMT_INVALID) {
+        *headp = pmtb;
+    } else {
+        pmt_set_next(prev, pmtb);
+    }
+}
+
+/*
+ * Unlink the run of free entries that ends at "end" (exclusive),
+ * if there is one at the tail of the list, and return its base.
+ */
+static u_int32_t
+pmt_freelist_trim_tail(u_int32_t *headp, const u_int32_t end)
+{
+    u_int32_t pmti, next, prev, runprev, runb;
+
+    prev = runprev = runb = PMT_INVALID;
+    for (pmti = *headp; pmti != PMT_INVALID; pmti = next) {
+        next = pmt_next(pmti);
+        if (runb == PMT_INVALID || pmti != prev + 1) {
+            runb = pmti;
+            runprev = prev;
+        }
+        prev = pmti;
+    }
+    if (prev == PMT_INVALID || prev + 1 != end) {
+        return end;
+    }
+    if (runprev == PMT_INVALID) {
+        *headp = PMT_INVALID;
+    } else {
+        pmt_set_next(runprev, PMT_INVALID);
+    }
+    return runb;
+}
+
+/*
+ * Unlink the run of free entries starting at "base", if there
+ * is one at the head of the list, and return the index just past it.
+ */
+static u_int32_t
+pmt_freelist_trim_head(u_int32_t *headp, u_int32_t base)
+{
+    while (*headp == base) {
+        *headp = pmt_next(base);
+        pmt_set_next(base, PMT_INVALID);
+        base++;
+    }
+    return base;
+}
+
+/*
+ * PMTs are shared by all ports, account for them in port 0's stats.
+ * dfree is how many entries this alloc or free moved onto (+) or
+ * off (-) the free lists, so the free list size is kept up to date
+ * without walking the lists.  The count itself lives outside the
+ * stats, which can be cleared, and the pmt_inuse/pmt_freelist gauges
+ * are set from it rather than adjusted.
+ */
+static void
+pmt_stats_update(const int pmti, const int n, const int reused,
+                 const int dfree)
+{
+    pciehw_shmem_t *pshmem = pciesvc_shmem_get();
+    pciehw_port_t *p = PSHMEM_ADDR_FIELD(pshmem, port[0]);
+    pciemgr_stats_t *s = &p->stats;
+
+    if (pmti < 0) {
+        s->pmt_allocfail++;
+    } else if (reused && n > 1) {
+        s->pmt_reuse++;
+    }
+
+    p->pmt_nfree += dfree;
+    s->pmt_freelist = p->pmt_nfree;
+    s->pmt_inuse = (PSHMEM_DATA_FIELD(pshmem, allocpmt_high) +
+                    pmt_count() - PSHMEM_DATA_FIELD(pshmem, allocpmt_low) -
+                    p->pmt_nfree);
+}
+
 static int
 pmt_alloc_high(const int n)
 {
     pciehw_shmem_t *pshmem = pciesvc_shmem_get();
-    pciehw_spmt_t *spmt;
     int pmti = -1;
     u_int32_t freepmt_high_l, allocpmt_high_l, allocpmt_low_l;
 
@@ -62,18 +226,19 @@ pmt_alloc_high(const int n)
     allocpmt_high_l = PSHMEM_DATA_FIELD(pshmem, allocpmt_high);
     allocpmt_low_l = PSHMEM_DATA_FIELD(pshmem, allocpmt_low);
 
-    if (n == 1 && freepmt_high_l != PMT_INVALID) {
-        /* alloc a single entry from free list */
-        pmti = freepmt_high_l;
-        spmt = pciesvc_spmt_get(pmti);
-        PSHMEM_ASGN_FIELD(pshmem, freepmt_high, spmt->next);
-        spmt->next = PMT_INVALID;
-        pciesvc_spmt_put(spmt, DIRTY);
-    } else if (allocpmt_high_l + n <= allocpmt_low_l) {
+    /* alloc from a run of freed entries if we can */
+    pmti = pmt_freelist_take(&freepmt_high_l, n);
+    if (pmti >= 0) {
+        PSHMEM_ASGN_FIELD(pshmem, freepmt_high, freepmt_high_l);
+        pmt_stats_update(pmti, n, 1, -n);
+        return pmti;
+    }
+    if (allocpmt_high_l + n <= allocpmt_low_l) {
         /* alloc multiple entries from sequential block */
         pmti = allocpmt_high_l;
         PSHMEM_ASGN_FIELD(pshmem, allocpmt_high, allocpmt_high_l + n);
     }
+    pmt_stats_update(pmti, n, 0, 0);
     return pmti;
 }
 
@@ -81,7 +246,6 @@ static int
 pmt_alloc_low(const int n)
 {
     pciehw_shmem_t *pshmem = pciesvc_shmem_get();
-    pciehw_spmt_t *spmt;
     int pmti = -1;
     u_int32_t freepmt_low_l, allocpmt_high_l, allocpmt_low_l;
 
@@ -89,18 +253,19 @@ pmt_alloc_low(const int n)
     allocpmt_high_l = PSHMEM_DATA_FIELD(pshmem, allocpmt_high);
     allocpmt_low_l = PSHMEM_DATA_FIELD(pshmem, allocpmt_low);
 
-    if (n == 1 && freepmt_low_l != PMT_INVALID) {
-        /* alloc a single entry from free list */
-        pmti = freepmt_low_l;
-        spmt = pciesvc_spmt_get(pmti);
-        PSHMEM_ASGN_FIELD(pshmem, freepmt_low, spmt->next);
-        spmt->next = PMT_INVALID;
-        pciesvc_spmt_put(spmt, DIRTY);
-    } else if (allocpmt_low_l - n >= allocpmt_high_l) {
+    /* alloc from a run of freed entries if we can */
+    pmti = pmt_freelist_take(&freepmt_low_l, n);
+    if (pmti >= 0) {
+        PSHMEM_ASGN_FIELD(pshmem, freepmt_low, freepmt_low_l);
+        pmt_stats_update(pmti, n, 1, -n);
+        return pmti;
+    }
+    if (allocpmt_low_l - n >= allocpmt_high_l) {
         /* alloc multiple entries from sequential block */
         PSHMEM_ASGN_FIELD(pshmem, allocpmt_low, allocpmt_low_l - n);
         pmti = PSHMEM_DATA_FIELD(pshmem, allocpmt_low);
     }
+    pmt_stats_update(pmti, n, 0, 0);
     return pmti;
 }
 
@@ -238,8 +403,7 @@ void
 pmt_free(const int pmtb, const int pmtc)
 {
     pciehw_shmem_t *pshmem = pciesvc_shmem_get();
-    pciehw_spmt_t *spmt;
-    int pmti, pmtpri;
+    int pmtpri, trimmed;
     u_int32_t allocpmt_high_l, freepmt_high_l, allocpmt_low_l, freepmt_low_l;
 
     assert_pmts_in_range(pmtb, pmtc);
@@ -250,29 +414,23 @@ pmt_free(const int pmtb, const int pmtc)
     freepmt_low_l = PSHMEM_DATA_FIELD(pshmem, freepmt_low);
     pmtpri = pmt_to_pri(pmtb, pmtc);
     if (pmtpri == PMTPRI_HIGH) {
-        /* free high pri */
-        if (allocpmt_high_l == (pmtb + pmtc)) {
-            PSHMEM_ASGN_FIELD(pshmem, allocpmt_high, allocpmt_high_l - pmtc);
-            return;
-        }
-        for (pmti = pmtb; pmti < pmtb + pmtc; pmti++) {
-            spmt = pciesvc_spmt_get(pmti);
-            spmt->next = freepmt_high_l;
-            pciesvc_spmt_put(spmt, DIRTY);
-            PSHMEM_ASGN_FIELD(pshmem, freepmt_high, pmti);
-        }
+        /* free high pri, give back any free run at the top */
+        pmt_freelist_put(&freepmt_high_l, pmtb, pmtc);
+        trimmed = allocpmt_high_l;
+        allocpmt_high_l = pmt_freelist_trim_tail(&freepmt_high_l,
+                                                 allocpmt_high_l);
+        trimmed -= allocpmt_high_l;
+        PSHMEM_ASGN_FIELD(pshmem, freepmt_high, freepmt_high_l);
+        PSHMEM_ASGN_FIELD(pshmem, allocpmt_high, allocpmt_high_l);
     } else if (pmtpri == PMTPRI_LOW) {
-        /* free low pri */
-        if (allocpmt_low_l == pmtb) {
-            PSHMEM_ASGN_FIELD(pshmem, allocpmt_low, allocpmt_low_l + pmtc);
-            return;
-        }
-        for (pmti = pmtb; pmti < pmtb + pmtc; pmti++) {
-            spmt = pciesvc_spmt_get(pmti);
-            spmt->next = freepmt_low_l;
-            pciesvc_spmt_put(spmt, DIRTY);
-            PSHMEM_ASGN_FIELD(pshmem, freepmt_low, pmti);
-        }
+        /* free low pri, give back any free run at the bottom */
+        pmt_freelist_put(&freepmt_low_l, pmtb, pmtc);
+        trimmed = allocpmt_low_l;
+        allocpmt_low_l = pmt_freelist_trim_head(&freepmt_low_l,
+                                                allocpmt_low_l);
+        trimmed = allocpmt_low_l - trimmed;
+        PSHMEM_ASGN_FIELD(pshmem, freepmt_low, freepmt_low_l);
+        PSHMEM_ASGN_FIELD(pshmem, allocpmt_low, allocpmt_low_l);
     } else {
         /* outside of both alloc ranges? */
         pciesvc_logerror("pmt_free: leak pmt %d (%d), "
@@ -280,7 +438,9 @@ pmt_free(const int pmtb, const int pmtc)
                          pmtb, pmtc,
                          allocpmt_low_l,
                          allocpmt_high_l);
+        return;
     }
+    pmt_stats_update(pmtb, pmtc, 0, pmtc - trimmed);
 }
 
 static void
@@ -549,21 +709,164 @@ pciehw_bar_foreach_pmt(pciehwbar_t *phwbar,
     }
 }
 
+/*
+ * PMT batches
+ *
+ * Enabling a few hundred vfs one bar at a time interleaves the prt,
+ * pmr and tcam writes of every entry of every vf, all while the host
+ * is waiting on the NumVFs config write.  While a batch is open
+ * pmt_load() and pmt_unload() only stage the entry images here, and
+ * pmt_batch_flush() writes them out a table at a time, each run of
+ * adjacent entries with one pciesvc_reg_wr32_table().  The ordering
+ * pmt_load() gives a single entry still holds for the batch: all the
+ * prts, then all the pmrs, then all the tcams, so a tcam search can
+ * only hit once its pmr and prts are valid.  Unloads clear the tcams
+ * before releasing the prts.
+ */
+#define PMT_BULK        32
+
+typedef struct pmt_batch_s {
+    int active;
+    int n;
+    u_int16_t pmti[PMT_BULK];
+    u_int8_t load[PMT_BULK];
+    u_int16_t prtb[PMT_BULK];
+    u_int16_t prtc[PMT_BULK];
+    u_int32_t pmr[PMT_BULK][PMR_NWORDS];
+    u_int32_t tcam[PMT_BULK][PMT_NWORDS];
+} pmt_batch_t;
+
+static pmt_batch_t pmt_batch;
+
 static void
-pmt_load(const int pmti, pciehw_spmt_t *spmt, const u_int16_t bdf)
+pmr_set_table(const int pmti, const u_int32_t w[][PMR_NWORDS], const int n)
 {
-    /*
-     * Load PRT first, then load PMT so PMT tcam search hit
-     * will find valid PRT entries.
-     */
-    pciehw_prt_load(spmt->pmt.pmre.bar.prtb, spmt->pmt.pmre.bar.prtc);
+    assert_pmts_in_range(pmti, n);
+    pciesvc_reg_wr32_table(pmr_addr(pmti), PMR_STRIDE, w[0], PMR_NWORDS, n);
+}
 
+static void
+pmt_set_table(const int pmti, const u_int32_t w[][PMT_NWORDS], const int n)
+{
+    assert_pmts_in_range(pmti, n);
+    pciesvc_reg_wr32_table(pmt_addr(pmti), PMT_STRIDE, w[0], PMT_NWORDS, n);
+}
+
+/* end of the run of adjacent pmt entries starting at i */
+static int
+pmt_batch_run(const pmt_batch_t *b, const int i)
+{
+    int j;
+
+    for (j = i + 1; j < b->n; j++) {
+        if (b->pmti[j] != b->pmti[j - 1] + 1 || b->load[j] != b->load[i])
+            break;
+    }
+    return j;
+}
+
+/* end of the run of adjacent prt ranges starting at i */
+static int
+pmt_batch_prt_run(const pmt_batch_t *b, const int i, int *prtc)
+{
+    int j;
+
+    *prtc = b->prtc[i];
+    for (j = i + 1; j < b->n; j++) {
+        if (b->prtb[j] != b->prtb[i] + *prtc || b->load[j] != b->load[i])
+            break;
+        *prtc += b->prtc[j];
+    }
+    return j;
+}
+
+static void
+pmt_batch_flush(pmt_batch_t *b)
+{
+    int i, j, prtc;
+
+    for (i = 0; i < b->n; i = j) {
+        j = pmt_batch_prt_run(b, i, &prtc);
+        if (b->load[i]) {
+            pciehw_prt_load(b->prtb[i], prtc);
+        }
+    }
+    for (i = 0; i < b->n; i = j) {
+        j = pmt_batch_run(b, i);
+        if (b->load[i]) {
+            pmr_set_table(b->pmti[i], &b->pmr[i], j - i);
+        }
+    }
+    for (i = 0; i < b->n; i = j) {
+        j = pmt_batch_run(b, i);
+        pmt_set_table(b->pmti[i], &b->tcam[i], j - i);
+    }
+    for (i = 0; i < b->n; i = j) {
+        j = pmt_batch_prt_run(b, i, &prtc);
+        if (!b->load[i]) {
+            pciehw_prt_unload(b->prtb[i], prtc);
+        }
+    }
+    b->n = 0;
+}
+
+static void
+pmt_batch_add(pmt_batch_t *b, const int pmti, const pmt_t *pmt, const int load)
+{
+    const int i = b->n;
+
+    if (i == PMT_BULK) {
+        pmt_batch_flush(b);
+        pmt_batch_add(b, pmti, pmt, load);
+        return;
+    }
+    b->pmti[i] = pmti;
+    b->load[i] = load;
+    b->prtb[i] = pmt->pmre.bar.prtb;
+    b->prtc[i] = pmt->pmre.bar.prtc;
+    if (load) {
+        pciesvc_memcpy(b->pmr[i], pmt->pmre.w, sizeof(b->pmr[i]));
+        pciesvc_memcpy(b->tcam[i], pmt->pmte.w, sizeof(b->tcam[i]));
+    } else {
+        pciesvc_memset(b->tcam[i], 0, sizeof(b->tcam[i]));
+    }
+    b->n++;
+}
+
+static void
+pmt_batch_begin(void)
+{
+    pciesvc_assert(!pmt_batch.active);
+    pmt_batch.n = 0;
+    pmt_batch.active = 1;
+}
+
+static void
+pmt_batch_end(void)
+{
+    pmt_batch_flush(&pmt_batch);
+    pmt_batch.active = 0;
+}
+
+static void
+pmt_load(const int pmti, pciehw_spmt_t *spmt, const u_int16_t bdf)
+{
     /* vf0 bdf was adjusted already in adjust_vf0 */
     if (!spmt->vf0) {
         /* place bus-adjusted bdf in pmt, then load in hw */
         pmt_bar_set_bdf(&spmt->pmt, bdf);
     }
-    pmt_set(pmti, &spmt->pmt);
+
+    if (pmt_batch.active) {
+        pmt_batch_add(&pmt_batch, pmti, &spmt->pmt, 1);
+    } else {
+        /*
+         * Load PRT first, then load PMT so PMT tcam search hit
+         * will find valid PRT entries.
+         */
+        pciehw_prt_load(spmt->pmt.pmre.bar.prtb, spmt->pmt.pmre.bar.prtc);
+        pmt_set(pmti, &spmt->pmt);
+    }
 
     if (!spmt->loaded) {
         spmt->loaded = 1;
@@ -595,9 +898,13 @@ pmt_unload(const int pmti, pciehw_spmt_t *spmt)
      * and PRT is unreferenced.  Then safe to unload PRT.
      */
     if (spmt->loaded) {
-        pmt_clr(pmti);
-        pciehw_prt_unload(spmt->pmt.pmre.bar.prtb,
-                          spmt->pmt.pmre.bar.prtc);
+        if (pmt_batch.active) {
+            pmt_batch_add(&pmt_batch, pmti, &spmt->pmt, 0);
+        } else {
+            pmt_clr(pmti);
+            pciehw_prt_unload(spmt->pmt.pmre.bar.prtb,
+                              spmt->pmt.pmre.bar.prtc);
+        }
         spmt->loaded = 0;
     }
 }
@@ -615,6 +922,41 @@ pciehw_bar_unload_pmts(pciehwbar_t *phwbar)
     pciehw_bar_foreach_pmt(phwbar, pmt_unload_cb, NULL);
 }
 
+/*
+ * Local address of the resource a bar offset maps to through the
+ * bar's base pmts and their prts, 0 if the offset doesn't land in
+ * a resource prt.
+ */
+u_int64_t
+pciehw_bar_localpa(const pciehwbar_t *phwbar, const u_int64_t baroff)
+{
+    const pmr_bar_entry_t *pmr;
+    const pciehw_spmt_t *spmt;
+    const pciehw_sprt_t *sprt;
+    u_int64_t pa, off, prtsz;
+    u_int32_t pmti;
+
+    pa = 0;
+    for (pmti = phwbar->pmtb; pmti < phwbar->pmtb + phwbar->pmtc; pmti++) {
+        spmt = pciesvc_spmt_get(pmti);
+        pmr = &spmt->pmt.pmre.bar;
+        prtsz = 1ULL << pmr->prtsize;
+        off = baroff - spmt->baroff;
+        if (baroff >= spmt->baroff && off < pmr->prtc * prtsz) {
+            sprt = pciesvc_sprt_get(pmr->prtb + off / prtsz);
+            if (prt_is_valid(&sprt->prt) &&
+                prt_type(&sprt->prt) == PRT_TYPE_RES) {
+                pa = ((u_int64_t)sprt->prt.res.addrdw << 2) +
+                    (off & (prtsz - 1));
+            }
+            pciesvc_sprt_put(sprt, CLEAN);
+        }
+        pciesvc_spmt_put(spmt, CLEAN);
+        if (pa) break;
+    }
+    return pa;
+}
+
 void
 pciehw_bar_load_ovrds(pciehwbar_t *phwbar)
 {
@@ -649,6 +991,49 @@ pciehw_bar_unload_ovrds(pciehwbar_t *phwbar)
     }
 }
 
+/*
+ * Load or unload the bars of vfs [vfb, vfb + vfc) through the usual
+ * pciehw_bar_load()/pciehw_bar_unload(), so per-bar work like the
+ * virtio notify setup is done for vfs too, with a pmt batch open so
+ * the hardware tables are written in bulk.
+ * VFs have no i/o bars so every valid bar is a memory bar.
+ */
+static void
+pciehw_vfs_bars(pciehwdev_t *phwdev, const int vfb, const int vfc,
+                const int load)
+{
+    pciehwdev_t *vfhwdev;
+    pciehwbar_t *phwbar;
+    int vfidx, i;
+
+    pmt_batch_begin();
+    for (vfidx = vfb; vfidx < vfb + vfc; vfidx++) {
+        vfhwdev = pciehwdev_vfdev_get(phwdev, vfidx);
+        for (phwbar = vfhwdev->bar, i = 0; i < PCIEHW_NBAR; i++, phwbar++) {
+            if (!phwbar->valid) continue;
+            if (load) {
+                pciehw_bar_load(vfhwdev, phwbar);
+            } else {
+                pciehw_bar_unload(vfhwdev, phwbar);
+            }
+        }
+        pciehwdev_vfdev_put(vfhwdev, DIRTY); /* bdf, loaded, vnotify */
+    }
+    pmt_batch_end();
+}
+
+void
+pciehw_vfs_load_bars(pciehwdev_t *phwdev, const int vfb, const int vfc)
+{
+    pciehw_vfs_bars(phwdev, vfb, vfc, 1);
+}
+
+void
+pciehw_vfs_unload_bars(pciehwdev_t *phwdev, const int vfb, const int vfc)
+{
+    pciehw_vfs_bars(phwdev, vfb, vfc, 0);
+}
+
 static int
 spmt_dup_prts(const pciehw_spmt_t *ospmt, pciehw_spmt_t *nspmt)
 {
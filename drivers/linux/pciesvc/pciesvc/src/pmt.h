@@ -25,8 +25,12 @@ typedef union pciehwbar_u pciehwbar_t;
 void pciehw_pmt_setaddr(pciehwbar_t *phwbar, u_int64_t addr);
 void pciehw_bar_load_pmts(pciehwbar_t *phwbar);
 void pciehw_bar_unload_pmts(pciehwbar_t *phwbar);
+u_int64_t pciehw_bar_localpa(const pciehwbar_t *phwbar,
+                             const u_int64_t baroff);
 void pciehw_bar_load_ovrds(pciehwbar_t *phwbar);
 void pciehw_bar_unload_ovrds(pciehwbar_t *phwbar);
+void pciehw_vfs_load_bars(pciehwdev_t *phwdev, const int vfb, const int vfc);
+void pciehw_vfs_unload_bars(pciehwdev_t *phwdev, const int vfb, const int vfc);
 void pciehw_pmt_load_cfg(pciehwdev_t *phwdev);
 void pciehw_pmt_unload_cfg(pciehwdev_t *phwdev);
 int pciehw_pmt_adjust_vf0(pciehw_spmt_t *spmt,
@@ -101,6 +101,20 @@ prt_set(const int prti, const prt_t *prt)
     pciesvc_reg_wr32w(prt_addr(prti), prt->w, PRT_NWORDS);
 }
 
+/*
+ * Ranges of prt entries are staged PRT_BULK at a time in a local
+ * buffer and pushed with one table write per buffer.
+ */
+#define PRT_BULK        32
+
+static void
+prt_set_table(const int prti, const u_int32_t buf[][PRT_NWORDS], const int n)
+{
+    assert_prts_in_range(prti, n);
+    pciesvc_reg_wr32_table(prt_addr(prti), PRT_STRIDE,
+                           buf[0], PRT_NWORDS, n);
+}
+
 /******************************************************************
  * apis
  */
@@ -109,15 +123,23 @@ int
 pciehw_prt_load(const int prtbase, const int prtcount)
 {
     const int prtend = prtbase + prtcount;
+    u_int32_t buf[PRT_BULK][PRT_NWORDS];
     pciehw_sprt_t *sprt;
-    int prti;
+    int prti, n;
 
     assert_prts_in_range(prtbase, prtcount);
 
-    for (prti = prtbase; prti < prtend; prti++) {
+    for (prti = prtbase, n = 0; prti < prtend; prti++) {
         sprt = pciesvc_sprt_get(prti);
-        prt_set(prti, &sprt->prt);
+        pciesvc_memcpy(buf[n], sprt->prt.w, sizeof(buf[n]));
         pciesvc_sprt_put(sprt, CLEAN);
+        if (++n == PRT_BULK) {
+            prt_set_table(prti - n + 1, buf, n);
+            n = 0;
+        }
+    }
+    if (n) {
+        prt_set_table(prtend - n, buf, n);
     }
     return 0;
 }
@@ -126,12 +148,14 @@ void
 pciehw_prt_unload(const int prtbase, const int prtcount)
 {
     const int prtend = prtbase + prtcount;
-    const prt_t prt0 = {{ 0 }};
-    int prti;
+    u_int32_t buf[PRT_BULK][PRT_NWORDS];
+    int prti, n;
 
     assert_prts_in_range(prtbase, prtcount);
 
-    for (prti = prtbase; prti < prtend; prti++) {
-        prt_set(prti, &prt0);
+    pciesvc_memset(buf, 0, sizeof(buf));
+    for (prti = prtbase; prti < prtend; prti += n) {
+        n = prtend - prti < PRT_BULK ? prtend - prti : PRT_BULK;
+        prt_set_table(prti, buf, n);
     }
 }
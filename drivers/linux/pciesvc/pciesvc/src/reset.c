@@ -6,6 +6,7 @@
 #include "pciesvc_impl.h"
 #include "intrutils.h"
 #include "serial.h"
+#include "hdrt.h"
 #include "reset.h"
 
 static void
@@ -125,24 +126,109 @@ pciehw_reset_flr(pciehwdev_t *phwdev)
     pciehw_reset_device(phwdev, PCIESVC_RSTTYPE_FLR);
 }
 
+/*
+ * VFs of a PF are a contiguous block of devices and are usually
+ * given contiguous intr and lif ranges too.  When resetting a block
+ * of VFs we collect those ranges into spans so each span is reset
+ * with one intr_reset_pci() or pciehw_hdrt_unload() call instead of
+ * one call per VF.
+ */
+typedef struct rstspan_s {
+    u_int32_t b;                        /* span base */
+    u_int32_t c;                        /* span count */
+    int dmask;                          /* intr drvcfg.mask reset value */
+} rstspan_t;
+
+static int
+rstspan_extend(rstspan_t *span,
+               const u_int32_t b, const u_int32_t c, const int dmask)
+{
+    if (span->c && span->b + span->c == b && span->dmask == dmask) {
+        span->c += c;
+        return 1;
+    }
+    return 0;
+}
+
+static void
+rstspan_start(rstspan_t *span,
+              const u_int32_t b, const u_int32_t c, const int dmask)
+{
+    span->b = b;
+    span->c = c;
+    span->dmask = dmask;
+}
+
+static void
+pciehw_reset_intr_span(rstspan_t *span)
+{
+    if (span->c) {
+        intr_reset_pci(span->b, span->c, span->dmask);
+        span->c = 0;
+    }
+}
+
+static void
+pciehw_reset_lif_span(rstspan_t *span)
+{
+    if (span->c) {
+        pciehw_hdrt_unload(span->b, span->c);
+        span->c = 0;
+    }
+}
+
+static void
+pciehw_reset_vf(pciehwdev_t *vfhwdev, rstspan_t *intrs, rstspan_t *lifs)
+{
+    u_int16_t cmd;
+
+    /* override intrs are scattered, reset those in place */
+    if (vfhwdev->novrdintr) {
+        pciehw_reset_device_intrs(vfhwdev, PCIESVC_RSTTYPE_NONE);
+    } else if (!rstspan_extend(intrs, vfhwdev->intrb, vfhwdev->intrc,
+                               vfhwdev->intrdmask)) {
+        pciehw_reset_intr_span(intrs);
+        rstspan_start(intrs, vfhwdev->intrb, vfhwdev->intrc,
+                      vfhwdev->intrdmask);
+    }
+
+    cmd = pciehw_cfg_reset_vf(vfhwdev);
+
+    /* busmaster enable needs our bdf, only busmaster disable spans */
+    if (cmd & PCI_COMMAND_MASTER) {
+        pciehw_hdrt_load(vfhwdev->lifb, vfhwdev->lifc, vfhwdev->bdf);
+    } else if (!rstspan_extend(lifs, vfhwdev->lifb, vfhwdev->lifc, 0)) {
+        pciehw_reset_lif_span(lifs);
+        rstspan_start(lifs, vfhwdev->lifb, vfhwdev->lifc, 0);
+    }
+
+    if (vfhwdev->type == PCIEHDEVICE_SERIAL) {
+        serial_reset(vfhwdev, PCIESVC_RSTTYPE_NONE);
+    }
+}
+
 /*
  * A PF controls enabling of VFs.  If some enabled VFs get disabled
  * by the PF then we want to reset the VFs.
  *
  * In order to reduce the number of msgs generated for this reset event
  * we compress all the VF reset msgs into a single reset msg spanning
- * all the lifs that were affected.
+ * all the lifs that were affected.  The intr and hdrt resets are
+ * compressed the same way, see pciehw_reset_vf().
  */
 void
 pciehw_reset_vfs(pciehwdev_t *phwdev, const int vfb, const int vfc)
 {
     pciehwdev_t *vfhwdev;
+    rstspan_t intrs, lifs;
     int vfidx, vflifb, vflifc;
 
     pciesvc_loginfo("%s: vfs reset %d-%d\n",
                     pciehwdev_get_name(phwdev), vfb, vfb + vfc - 1);
     vflifb = 0;
     vflifc = 0;
+    rstspan_start(&intrs, 0, 0, 0);
+    rstspan_start(&lifs, 0, 0, 0);
     for (vfidx = vfb; vfidx < vfb + vfc; vfidx++) {
         vfhwdev = pciehwdev_vfdev_get(phwdev, vfidx);
         if (vfidx == vfb) {
@@ -150,8 +236,10 @@ pciehw_reset_vfs(pciehwdev_t *phwdev, const int vfb, const int vfc)
             vflifb = vfhwdev->lifb;
             vflifc = vfhwdev->lifc;
         }
-        pciehw_reset_device(vfhwdev, PCIESVC_RSTTYPE_NONE);
+        pciehw_reset_vf(vfhwdev, &intrs, &lifs);
         pciehwdev_vfdev_put(vfhwdev, DIRTY);
     }
+    pciehw_reset_intr_span(&intrs);
+    pciehw_reset_lif_span(&lifs);
     pciehw_reset_lifs_event(phwdev, vflifb, vflifc * vfc, PCIESVC_RSTTYPE_VF);
 }
@@ -15,6 +15,7 @@ typedef struct serial {
     uart_state_t *uart;         /* uart state */
     memq_t *txq;                /* txq transfer from device to memq */
     memq_t *rxq;                /* rxq transfer from memq to device */
+    bulkq_t *bulktxq;           /* txq instead when bulk_en */
 } serial_t;
 
 static void serial_update_msl(serial_t *s);
@@ -45,14 +46,82 @@ memq_getc(volatile memq_t *q, u_int8_t *cp)
     return 1;
 }
 
+static unsigned int
+memq_space(volatile memq_t *q)
+{
+    return (q->cidx - q->pidx - 1) % MEMQ_BUFSZ;
+}
+
+static unsigned int
+bulkq_space(volatile bulkq_t *q)
+{
+    return (q->cidx - q->pidx - 1) % BULKQ_BUFSZ;
+}
+
 static int
-memq_full(volatile memq_t *q)
+bulkq_put(volatile bulkq_t *q, const u_int8_t *buf, const int n)
 {
-    const unsigned int pidx = q->pidx;
-    const unsigned int cidx = q->cidx;
-    const unsigned int newpidx = (pidx + 1) % MEMQ_BUFSZ;
+    unsigned int pidx = q->pidx;
+    int i;
+
+    /* all or nothing, pidx moves once for the batch */
+    if (n > bulkq_space(q)) return 0;
+
+    for (i = 0; i < n; i++) {
+        q->buf[pidx] = buf[i];
+        pidx = (pidx + 1) % BULKQ_BUFSZ;
+    }
+    q->pidx = pidx;
+    return n;
+}
+
+static int
+serial_bulk_en(serial_t *s)
+{
+    volatile serial_state_t *st = s->state;
+
+    return st->bulk_en;
+}
+
+static unsigned int
+serial_txq_space(serial_t *s)
+{
+    if (serial_bulk_en(s)) {
+        return bulkq_space(s->bulktxq);
+    }
+    return memq_space(s->txq);
+}
+
+static int
+serial_txq_full(serial_t *s)
+{
+    return serial_txq_space(s) == 0;
+}
+
+/**
+ * serial_txq_put:
+ * @s: serial struct
+ * @buf: bytes to transmit
+ * @n: number of bytes
+ *
+ * Queue all @n bytes to the active tx queue, or none if they don't fit.
+ *
+ * Returns: number of bytes queued.
+ */
+static int
+serial_txq_put(serial_t *s, const u_int8_t *buf, const int n)
+{
+    int i;
+
+    if (serial_bulk_en(s)) {
+        return bulkq_put(s->bulktxq, buf, n);
+    }
+    if (n > memq_space(s->txq)) return 0;
 
-    return newpidx == cidx;
+    for (i = 0; i < n; i++) {
+        memq_putc(s->txq, buf[i]);
+    }
+    return n;
 }
 
 static u_int8_t
@@ -69,8 +138,8 @@ serial_rd_rbr(serial_t *s)
 static int
 serial_wr_thr(serial_t *s, const u_int8_t c)
 {
-    if (!memq_putc(s->txq, c)) {
-        pciesvc_logerror("wr_thr: memq_putc failed\n");
+    if (!serial_txq_put(s, &c, 1)) {
+        pciesvc_logerror("wr_thr: txq put failed\n");
         return 0;
     }
     return 1;
@@ -285,11 +354,14 @@ serial_update_msl(serial_t *s)
  * @st: serial struct
  *
  * Transmit bytes to memq
+ *
+ * Returns: number of bytes queued for seriald.
  */
-static void
+static int
 uart_xmit(serial_t *s)
 {
     uart_state_t *uart = s->uart;
+    int n = 0;
 
     if (uart->mcr & UART_MCR_LOOP) {
         /* Loopback mode, copy holding reg thr to receive reg rbr */
@@ -301,8 +373,8 @@ uart_xmit(serial_t *s)
         memq_putc(s->rxq, uart->thr);
         uart_update_irq(s);
     } else {
-        if (!memq_full(s->txq)) {
-            serial_wr_thr(s, uart->thr);
+        if (!serial_txq_full(s)) {
+            n = serial_wr_thr(s, uart->thr);
         }
     }
 
@@ -313,6 +385,35 @@ uart_xmit(serial_t *s)
 
     uart->lsr |= UART_LSR_TEMT;
     uart->thr_ipending = 0;
+    return n;
+}
+
+/**
+ * serial_bulk_tx:
+ * @s: serial struct
+ * @size: write size, 1-8 bytes
+ * @val: bytes to transmit, first byte in the low order bits
+ *
+ * Queue the bytes of a SERIAL_BULK_TX write.
+ *
+ * Returns: number of bytes queued for seriald.
+ */
+static int
+serial_bulk_tx(serial_t *s, const size_t size, const u_int64_t val)
+{
+    u_int8_t buf[8];
+    int i;
+
+    if (size == 0 || size > sizeof(buf)) return 0;
+
+    for (i = 0; i < size; i++) {
+        buf[i] = val >> (i * 8);
+    }
+    if (!serial_txq_put(s, buf, size)) {
+        pciesvc_logerror("bulk_tx: txq full, %d bytes dropped\n", (int)size);
+        return 0;
+    }
+    return size;
 }
 
 /**
@@ -394,6 +495,7 @@ serial_get(pciehwdev_t *phwdev)
         serial.uart = &su->uart_state;
         serial.txq = &st->txq;
         serial.rxq = &st->rxq;
+        serial.bulktxq = &st->bulktxq;
 
         if (st->gen == 0) {
             st->intrb = phwdev->intrb;
@@ -408,6 +510,20 @@ serial_get(pciehwdev_t *phwdev)
     return &serial;
 }
 
+/*
+ * Count serial tlps and the bytes they sent in the port stats.
+ */
+static void
+serial_stats(const pciehwdev_t *phwdev,
+             const u_int32_t tlps, const u_int32_t txbytes)
+{
+    pciehw_port_t *p = pciesvc_port_get(phwdev->port);
+
+    p->stats.serial_tlps += tlps;
+    p->stats.serial_txbytes += txbytes;
+    pciesvc_port_put(p, DIRTY);
+}
+
 uint64_t
 serial_barrd(pciehwdev_t *phwdev,
              const u_int64_t baroff, const size_t size)
@@ -416,6 +532,14 @@ serial_barrd(pciehwdev_t *phwdev,
     uart_state_t *uart = s->uart;
     uint32_t r;
 
+    serial_stats(phwdev, 1, 0);
+
+    if (baroff == SERIAL_BULK_STATUS && size == 4) {
+        r = serial_txq_space(s);
+        if (serial_bulk_en(s)) r |= SERIAL_BULK_STATUS_EN;
+        return r;
+    }
+
     /* only byte access */
     if (size != 1) return 0;
     if (baroff >= 8) return 0;
@@ -482,7 +606,7 @@ serial_barrd(pciehwdev_t *phwdev,
         if (!serial_rxq_empty(s)) {
             uart->lsr |= UART_LSR_DR;
         }
-        if (memq_full(s->txq)) {
+        if (serial_txq_full(s)) {
             uart->lsr &= ~UART_LSR_THRE;   /* clear thr empty */
             uart->lsr &= ~UART_LSR_TEMT;   /* clear transmitter empty */
         } else {
@@ -532,6 +656,13 @@ serial_barwr(pciehwdev_t *phwdev,
     uint8_t changed;
     uint8_t temp;
 
+    if (baroff == SERIAL_BULK_TX) {
+        serial_stats(phwdev, 1, serial_bulk_tx(s, size, val));
+        return;
+    }
+
+    serial_stats(phwdev, 1, 0);
+
     /* only byte access */
     if (size != 1) return;
     if (baroff >= 8) return;
@@ -548,7 +679,7 @@ serial_barwr(pciehwdev_t *phwdev,
             uart->lsr &= ~UART_LSR_THRE;    /* clear thr empty */
             uart->lsr &= ~UART_LSR_TEMT;    /* clear transmitter empty */
             uart_update_irq(s);
-            uart_xmit(s);
+            serial_stats(phwdev, 0, uart_xmit(s));
         }
         break;
     case UART_INTERRUPT_ENABLE:
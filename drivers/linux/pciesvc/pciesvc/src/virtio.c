@@ -5,6 +5,7 @@
 
 #include "pciesvc_impl.h"
 #include "virtio.h"
+#include "pmt.h"
 
 #include "virtio_spec.h"
 
@@ -724,3 +725,40 @@ virtio_barwr(pciehwdev_t *phwdev, u_int64_t addr,
     VIRTIO_DEV_REG_NOTIFY(cmn_cfg.queue_cfg.queue_enable);
     }
 }
+
+/*
+ * Queue notify fast path
+ *
+ * A legacy queue_notify write is the guest's virtqueue doorbell
+ * and the hottest register sw emulates on a virtio bar.  When the
+ * bar's pmts have been installed, resolve the local pa the
+ * register maps to through them, then pciehw_barwr_indirect()
+ * matches the tlp's pa and size against the device and completes
+ * it without the tlp decode or the virtio_barwr() register switch.
+ * Every queue index is handled alike, as the full path latches
+ * whatever is written.  A pa we couldn't resolve leaves the fast
+ * path off and all writes take the full path as before.
+ */
+void
+virtio_notify_load(pciehwdev_t *phwdev, const pciehwbar_t *phwbar)
+{
+    const u_int64_t baroff = VIRTIO_DEV_REG_OFF(legacy_cfg.queue_notify);
+    const u_int64_t pa = pciehw_bar_localpa(phwbar, baroff);
+
+    phwdev->vnotify_pa = pa;
+    phwdev->vnotify_cfgidx = phwbar->cfgidx;
+}
+
+void
+virtio_notify_unload(pciehwdev_t *phwdev, const pciehwbar_t *phwbar)
+{
+    if (phwdev->vnotify_pa && phwdev->vnotify_cfgidx == phwbar->cfgidx) {
+        phwdev->vnotify_pa = 0;
+    }
+}
+
+u_int64_t
+virtio_notify_baroff(void)
+{
+    return VIRTIO_DEV_REG_OFF(legacy_cfg.queue_notify);
+}
@@ -16,4 +16,13 @@ virtio_barwr(pciehwdev_t *phwdev, u_int64_t addr,
              const u_int64_t baroff, const size_t size, const u_int64_t val,
              u_int8_t *do_notify);
 
+void
+virtio_notify_load(pciehwdev_t *phwdev, const pciehwbar_t *phwbar);
+
+void
+virtio_notify_unload(pciehwdev_t *phwdev, const pciehwbar_t *phwbar);
+
+u_int64_t
+virtio_notify_baroff(void);
+
 #endif /* __VIRTIO_H__ */
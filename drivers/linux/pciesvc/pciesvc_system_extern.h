@@ -20,6 +20,7 @@
 #include <endian.h>
 #include <sys/param.h>
 #include <stdarg.h>
+#include <linux/types.h>
 #endif
 
 #include "kpcimgr_api.h"
@@ -165,6 +166,7 @@ static inline kstate_t *get_kstate(void)
 #define pciesvc_usleep          kp_udelay
 #define pciesvc_ffs             ffs
 #define pciesvc_ffsll           __builtin_ffsl
+#define pciesvc_prefetch        __builtin_prefetch
 
 
 #define CLEAN                   0
@@ -189,6 +191,10 @@ void
 pciesvc_pciepreg_rd32(const uint64_t pa, uint32_t *dest);
 void
 pciesvc_reg_wr32(const uint64_t pa, const uint32_t val);
+void
+pciesvc_reg_wr32_table(const uint64_t pa, const uint32_t stride,
+                       const uint32_t *w, const uint32_t nw,
+                       const uint32_t n);
 #define pciesvc_pciepreg_wr32   pciesvc_reg_wr32
 
 int
@@ -208,6 +214,9 @@ pciesvc_memcpy_toio(void *dsthw, const void *src, size_t n);
 void
 pciesvc_log(const char *msg);
 
+u64
+pciesvc_nsecs(void);
+
 int
 pciesvc_event_handler(pciesvc_eventdata_t *evdata, const size_t evsize);
 